@@ -0,0 +1,41 @@
+//
+//  TLCompressionUtils.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Helper functions for compressing request payloads.
+ */
+@interface TLCompressionUtils : NSObject
+
+/**
+ * Compresses the given data into the gzip format (RFC 1952), suitable for
+ * sending with a 'Content-Encoding: gzip' header.
+ * @param data  The data to compress.
+ * @param level The zlib compression level (0-9, or Z_DEFAULT_COMPRESSION).
+ * @return The gzip-compressed data; nil if compression failed.
+ */
++ (NSData *)gzipData:(NSData *)data level:(int)level;
+
+@end
@@ -0,0 +1,52 @@
+//
+//  TLCompressionUtils.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLCompressionUtils.h"
+#import <zlib.h>
+
+@implementation TLCompressionUtils
+
++ (NSData *)gzipData:(NSData *)data level:(int)level {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // 15 window bits, plus 16 to have zlib write a gzip header and trailer
+  if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return nil;
+  }
+  NSMutableData *compressed =
+    [NSMutableData dataWithLength:deflateBound(&stream, (uLong)[data length])];
+  stream.next_in = (Bytef *)[data bytes];
+  stream.avail_in = (uInt)[data length];
+  stream.next_out = [compressed mutableBytes];
+  stream.avail_out = (uInt)[compressed length];
+  int result = deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    return nil;
+  }
+  [compressed setLength:stream.total_out];
+  return compressed;
+}
+
+@end
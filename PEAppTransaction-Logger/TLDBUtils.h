@@ -25,6 +25,7 @@
 #import <FMDB/FMDatabase.h>
 #import "TLTypedefs.h"
 #import "TLTransaction.h"
+#import "TLTransactionLog.h"
 
 /**
  * A Collection of helper functions for simplifying interacting with the local
@@ -33,7 +34,8 @@
 @interface TLDBUtils : NSObject
 
 /**
- * Inserts txn into the local database.
+ * Inserts txn into the local database.  The transaction's user agent is stored
+ * by reference to its user agent row (see userAgentLocalId).
  * @param txn      The transaction instance to insert.
  * @param db       Database instance.
  * @param errorBlk Error handling block.
@@ -42,6 +44,48 @@
                        db:(FMDatabase *)db
                     error:(TLDaoErrorBlk)errorBlk;
 
+/**
+ * Returns the local identifier of the user agent row with the given fields,
+ * inserting the row if it does not yet exist.
+ * @param deviceMake      The device make/model.
+ * @param deviceOS        The device operating system name.
+ * @param deviceOSVersion The device operating system version.
+ * @param db              Database instance.
+ * @param errorBlk        Error handling block.
+ * @return The local identifier of the user agent row; nil on error.
+ */
++ (NSNumber *)userAgentIdForDeviceMake:(NSString *)deviceMake
+                              deviceOS:(NSString *)deviceOS
+                       deviceOSVersion:(NSString *)deviceOSVersion
+                                    db:(FMDatabase *)db
+                                 error:(TLDaoErrorBlk)errorBlk;
+
+/**
+ * Inserts txnLog into the local database as a child of txn.  The parent
+ * transaction is assumed to already be persisted.
+ * @param txnLog   The transaction log instance to insert.
+ * @param txn      The parent transaction instance.
+ * @param db       Database instance.
+ * @param errorBlk Error handling block.
+ * @return Whether the log was inserted.
+ */
++ (BOOL)insertTransactionLog:(TLTransactionLog *)txnLog
+              forTransaction:(TLTransaction *)txn
+                          db:(FMDatabase *)db
+                       error:(TLDaoErrorBlk)errorBlk;
+
+/**
+ * Inserts txn into the local database if a row for its GUID no longer exists
+ * (e.g., because it was pruned by a flush).  If txn is known to have been
+ * persisted at its store's current epoch, no query is issued at all.
+ * @param txn      The transaction instance to insert, if necessary.
+ * @param db       Database instance.
+ * @param errorBlk Error handling block.
+ */
++ (void)insertTransactionIfAbsent:(TLTransaction *)txn
+                               db:(FMDatabase *)db
+                            error:(TLDaoErrorBlk)errorBlk;
+
 /**
  * Executes the given insert SQL statement against the given database instance.
  * @param stmt       The insert SQL statement to execute.
@@ -94,6 +138,19 @@
                       db:(FMDatabase *)db
                    error:(TLDaoErrorBlk)errorBlk;
 
+/**
+ * Executes the given pragma statement (e.g., @"journal_mode = WAL") against the
+ * given database instance.
+ * @param pragma   The pragma, without the leading 'PRAGMA'.
+ * @param db       Database instance.
+ * @param errorBlk Error handling block.
+ * @return The value the pragma reports (for pragmas that report one), as a
+ * string.
+ */
++ (NSString *)doPragma:(NSString *)pragma
+                    db:(FMDatabase *)db
+                 error:(TLDaoErrorBlk)errorBlk;
+
 /**
  * Deletes from table based on the provided where conditions.
  * @param table The table to delete from.
@@ -23,38 +23,177 @@
 
 #import "TLDBUtils.h"
 #import "TLDDLUtils.h"
+#import "TLStoreEpoch.h"
 #import <FMDB/FMDatabase.h>
 #import <FMDB/FMResultSet.h>
 
 @implementation TLDBUtils
 
+#pragma mark - Precomputed SQL
+
+/*
+ The SQL of the statements issued on the logging path is built once; besides
+ saving the formatting work, the (identical) string instances make for cheap
+ lookups in FMDB's statement cache.
+ */
+
++ (NSString *)insertTransactionSQL {
+  static NSString *sql;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    sql = [NSString stringWithFormat:@"INSERT INTO %@(%@, %@, %@, %@) VALUES(?, ?, ?, ?)",
+           TBL_TXN,
+           COL_TXN_GUID,
+           COL_TXN_USECASE,
+           COL_TXN_USER_AGENT_ID,
+           COL_TXN_SAMPLE_RATE];
+  });
+  return sql;
+}
+
++ (NSString *)insertTransactionLogSQL {
+  static NSString *sql;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    sql = [NSString stringWithFormat:@"INSERT INTO %@(%@, %@, %@, %@, %@) VALUES(?, ?, ?, ?, ?)",
+           TBL_TXN_LOG,
+           COL_TXNLOG_PARENT_TXN_ID,
+           COL_TXNLOG_TIMESTAMP,
+           COL_TXNLOG_USECASE_EVENT,
+           COL_TXNLOG_IN_CTX_ERR_CODE,
+           COL_TXNLOG_IN_CTX_ERR_DESC];
+  });
+  return sql;
+}
+
++ (NSString *)transactionIdByGuidSQL {
+  static NSString *sql;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    sql = [NSString stringWithFormat:@"SELECT %@ FROM %@ WHERE %@ = ?",
+           COL_TXN_ID, TBL_TXN, COL_TXN_GUID];
+  });
+  return sql;
+}
+
++ (NSString *)userAgentIdSQL {
+  static NSString *sql;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    // 'IS' (rather than '=') so that null fields match
+    sql = [NSString stringWithFormat:@"SELECT %@ FROM %@ WHERE %@ IS ? AND %@ IS ? AND %@ IS ?",
+           COL_USERAGENT_ID,
+           TBL_USER_AGENT,
+           COL_USERAGENT_DEVICE_MAKE,
+           COL_USERAGENT_DEVICE_OS,
+           COL_USERAGENT_DEVICE_OS_VERSION];
+  });
+  return sql;
+}
+
++ (NSString *)insertUserAgentSQL {
+  static NSString *sql;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    sql = [NSString stringWithFormat:@"INSERT INTO %@(%@, %@, %@) VALUES(?, ?, ?)",
+           TBL_USER_AGENT,
+           COL_USERAGENT_DEVICE_MAKE,
+           COL_USERAGENT_DEVICE_OS,
+           COL_USERAGENT_DEVICE_OS_VERSION];
+  });
+  return sql;
+}
+
+#pragma mark - Inserts
+
 + (void)insertTransaction:(TLTransaction *)txn
                        db:(FMDatabase *)db
                     error:(TLDaoErrorBlk)errorBlk {
-  TLIDAssigner idAssigner = ^(TLTransaction *txn, NSNumber *newId) {
-    [txn setLocalId:newId];
-  };
-  NSString *stmt = [NSString stringWithFormat:@"INSERT INTO %@(%@, %@, %@, %@, %@) \
-                    VALUES(?, ?, ?, ?, ?)",
-                    TBL_TXN,
-                    COL_TXN_GUID,
-                    COL_TXN_USECASE,
-                    COL_TXN_USERAGENT_DEVICE_MAKE,
-                    COL_TXN_USERAGENT_DEVICE_OS,
-                    COL_TXN_USERAGENT_DEVICE_OS_VERSION];
-  NSArray *args = @[[txn guid],
-                    [txn usecase],
-                    [txn userAgentDeviceMake],
-                    [txn userAgentDeviceOS],
-                    [txn userAgentDeviceOSVersion]];
-  [TLDBUtils doInsert:stmt
-            argsArray:args
-               entity:txn
-           idAssigner:idAssigner
-                   db:db
-                error:errorBlk];
+  NSNumber *userAgentId = [txn userAgentLocalId];
+  if (!userAgentId) {
+    userAgentId = [TLDBUtils userAgentIdForDeviceMake:[txn userAgentDeviceMake]
+                                             deviceOS:[txn userAgentDeviceOS]
+                                      deviceOSVersion:[txn userAgentDeviceOSVersion]
+                                                   db:db
+                                                error:errorBlk];
+    [txn setUserAgentLocalId:userAgentId];
+  }
+  // a sample rate of 1 (the norm) is stored as null
+  NSNumber *sampleRate = [txn sampleRate] < 1.0 ? @([txn sampleRate]) : nil;
+  // The variadic form binds the values directly (nil binds NULL), sparing the
+  // arguments array.
+  if ([db executeUpdate:[TLDBUtils insertTransactionSQL], [txn guidBytes], [txn usecase], userAgentId, sampleRate]) {
+    [txn setLocalId:[NSNumber numberWithLongLong:[db lastInsertRowId]]];
+    [txn setPersistedEpoch:[[txn storeEpoch] value]];
+  } else {
+    [self invokeError:errorBlk db:db];
+  }
 }
 
++ (NSNumber *)userAgentIdForDeviceMake:(NSString *)deviceMake
+                              deviceOS:(NSString *)deviceOS
+                       deviceOSVersion:(NSString *)deviceOSVersion
+                                    db:(FMDatabase *)db
+                                 error:(TLDaoErrorBlk)errorBlk {
+  FMResultSet *rs = [db executeQuery:[TLDBUtils userAgentIdSQL], deviceMake, deviceOS, deviceOSVersion];
+  if (!rs) {
+    [self invokeError:errorBlk db:db];
+    return nil;
+  }
+  if ([rs next]) {
+    NSNumber *userAgentId = @([rs longLongIntForColumnIndex:0]);
+    [rs close];
+    return userAgentId;
+  }
+  if ([db executeUpdate:[TLDBUtils insertUserAgentSQL], deviceMake, deviceOS, deviceOSVersion]) {
+    return [NSNumber numberWithLongLong:[db lastInsertRowId]];
+  }
+  [self invokeError:errorBlk db:db];
+  return nil;
+}
+
++ (BOOL)insertTransactionLog:(TLTransactionLog *)txnLog
+              forTransaction:(TLTransaction *)txn
+                          db:(FMDatabase *)db
+                       error:(TLDaoErrorBlk)errorBlk {
+  if (![db executeUpdate:[TLDBUtils insertTransactionLogSQL],
+        [txn localId],
+        [txnLog timestamp],
+        [txnLog usecaseEvent],
+        [txnLog inContextErrCode],
+        [txnLog inContextLocalizedErrDesc]]) {
+    [self invokeError:errorBlk db:db];
+    return NO;
+  }
+  return YES;
+}
+
++ (void)insertTransactionIfAbsent:(TLTransaction *)txn
+                               db:(FMDatabase *)db
+                            error:(TLDaoErrorBlk)errorBlk {
+  TLStoreEpoch *storeEpoch = [txn storeEpoch];
+  if (storeEpoch && [txn persistedEpoch] == [storeEpoch value]) {
+    // no rows have been deleted since txn was known to be persisted
+    return;
+  }
+  FMResultSet *rs = [db executeQuery:[TLDBUtils transactionIdByGuidSQL], [txn guidBytes]];
+  if (!rs) {
+    [self invokeError:errorBlk db:db];
+    return;
+  }
+  BOOL present = [rs next];
+  [rs close];
+  if (present) {
+    [txn setPersistedEpoch:[storeEpoch value]];
+  } else {
+    // The transaction is not in the database (it must have been synced/pruned).  So
+    // we have to re-insert it.
+    [TLDBUtils insertTransaction:txn db:db error:errorBlk];
+  }
+}
+
+#pragma mark - Generic helpers
+
 + (void)invokeError:(TLDaoErrorBlk)errorBlk db:(FMDatabase *)db {
   errorBlk([db lastError], [db lastErrorCode], [db lastErrorMessage]);
 }
@@ -119,6 +258,22 @@
   return rs;
 }
 
++ (NSString *)doPragma:(NSString *)pragma
+                    db:(FMDatabase *)db
+                 error:(TLDaoErrorBlk)errorBlk {
+  // (issued as a query, since some pragmas report a row)
+  FMResultSet *rs = [self doQuery:[NSString stringWithFormat:@"PRAGMA %@", pragma]
+                        argsArray:@[]
+                               db:db
+                            error:errorBlk];
+  NSString *value = nil;
+  if ([rs next]) {
+    value = [rs stringForColumnIndex:0];
+  }
+  [rs close];
+  return value;
+}
+
 + (NSNumber *)numberFromTable:(NSString *)table
                  selectColumn:(NSString *)selectColumn
                   whereColumn:(NSString *)whereColumn
@@ -142,8 +297,8 @@
                   db:(FMDatabase *)db
                error:(TLDaoErrorBlk)errorBlk {
   id value = nil;
-  FMResultSet *rs = [db executeQuery:[NSString stringWithFormat:@"SELECT %@ FROM %@ WHERE %@ = ?", selectColumn, table, whereColumn]
-                withArgumentsInArray:@[whereValue]];
+  NSString *qry = [NSString stringWithFormat:@"SELECT %@ FROM %@ WHERE %@ = ?", selectColumn, table, whereColumn];
+  FMResultSet *rs = [db executeQuery:qry withArgumentsInArray:@[whereValue]];
   while ([rs next]) {
     value = rsExtractor(rs, selectColumn);
   }
@@ -35,6 +35,12 @@ FOUNDATION_EXPORT NSString * const COL_TXN_USECASE;
 FOUNDATION_EXPORT NSString * const COL_TXN_USERAGENT_DEVICE_MAKE;
 FOUNDATION_EXPORT NSString * const COL_TXN_USERAGENT_DEVICE_OS;
 FOUNDATION_EXPORT NSString * const COL_TXN_USERAGENT_DEVICE_OS_VERSION;
+FOUNDATION_EXPORT NSString * const COL_TXN_USER_AGENT_ID;
+FOUNDATION_EXPORT NSString * const COL_TXN_SAMPLE_RATE;
+FOUNDATION_EXPORT NSString * const COL_TXN_FLUSH_BATCH_ID;
+// ----Indexes------------------------------------------------------------------
+FOUNDATION_EXPORT NSString * const IDX_TXN_GUID;
+FOUNDATION_EXPORT NSString * const IDX_TXN_FLUSH_BATCH_ID;
 
 //##############################################################################
 // Transaction Log entity
@@ -48,6 +54,58 @@ FOUNDATION_EXPORT NSString * const COL_TXNLOG_TIMESTAMP;
 FOUNDATION_EXPORT NSString * const COL_TXNLOG_USECASE_EVENT;
 FOUNDATION_EXPORT NSString * const COL_TXNLOG_IN_CTX_ERR_CODE;
 FOUNDATION_EXPORT NSString * const COL_TXNLOG_IN_CTX_ERR_DESC;
+// ----Indexes------------------------------------------------------------------
+FOUNDATION_EXPORT NSString * const IDX_TXNLOG_PARENT_TXN_ID;
+// ----Rebuild table name (see cascadingTransactionLogDDLWithTable:)------------
+FOUNDATION_EXPORT NSString * const TBL_TXN_LOG_REBUILD;
+
+//##############################################################################
+// User Agent entity
+//##############################################################################
+// ----Table name---------------------------------------------------------------
+FOUNDATION_EXPORT NSString * const TBL_USER_AGENT;
+// ----Columns------------------------------------------------------------------
+FOUNDATION_EXPORT NSString * const COL_USERAGENT_ID;
+FOUNDATION_EXPORT NSString * const COL_USERAGENT_DEVICE_MAKE;
+FOUNDATION_EXPORT NSString * const COL_USERAGENT_DEVICE_OS;
+FOUNDATION_EXPORT NSString * const COL_USERAGENT_DEVICE_OS_VERSION;
+
+//##############################################################################
+// Flush Batch entity
+//##############################################################################
+// ----Table name---------------------------------------------------------------
+FOUNDATION_EXPORT NSString * const TBL_FLUSH_BATCH;
+// ----Columns------------------------------------------------------------------
+FOUNDATION_EXPORT NSString * const COL_FLUSHBATCH_ID;
+FOUNDATION_EXPORT NSString * const COL_FLUSHBATCH_IDEMPOTENCY_KEY;
+FOUNDATION_EXPORT NSString * const COL_FLUSHBATCH_LOG_WATERMARK;
+FOUNDATION_EXPORT NSString * const COL_FLUSHBATCH_STATE;
+FOUNDATION_EXPORT NSString * const COL_FLUSHBATCH_CREATED_AT;
+
+//##############################################################################
+// Transaction Id staging (temporary; per connection)
+//##############################################################################
+// ----Table name---------------------------------------------------------------
+FOUNDATION_EXPORT NSString * const TBL_TEMP_TXN_ID;
+// ----Columns------------------------------------------------------------------
+FOUNDATION_EXPORT NSString * const COL_TEMPTXNID_ID;
+
+//##############################################################################
+// Transaction Rollup entity
+//##############################################################################
+// ----Table name---------------------------------------------------------------
+FOUNDATION_EXPORT NSString * const TBL_TXN_ROLLUP;
+// ----Columns------------------------------------------------------------------
+FOUNDATION_EXPORT NSString * const COL_TXNROLLUP_ID;
+FOUNDATION_EXPORT NSString * const COL_TXNROLLUP_USECASE;
+FOUNDATION_EXPORT NSString * const COL_TXNROLLUP_WINDOW_START;
+FOUNDATION_EXPORT NSString * const COL_TXNROLLUP_WINDOW_DURATION;
+FOUNDATION_EXPORT NSString * const COL_TXNROLLUP_NUM_TXNS;
+FOUNDATION_EXPORT NSString * const COL_TXNROLLUP_NUM_EVENTS;
+FOUNDATION_EXPORT NSString * const COL_TXNROLLUP_EVENT_COUNTS;
+FOUNDATION_EXPORT NSString * const COL_TXNROLLUP_ERR_CODE_COUNTS;
+FOUNDATION_EXPORT NSString * const COL_TXNROLLUP_DURATION_HISTOGRAM;
+FOUNDATION_EXPORT NSString * const COL_TXNROLLUP_FLUSH_KEY;
 
 /**
  * Functions that produce the DDL for the tables used by PEAppTransaction-Logger.
@@ -64,4 +122,75 @@ FOUNDATION_EXPORT NSString * const COL_TXNLOG_IN_CTX_ERR_DESC;
  */
 + (NSString *)transactionLogDDL;
 
+/**
+ * @return The DDL of the user agent table.
+ */
++ (NSString *)userAgentDDL;
+
+/**
+ * @return The DDL that adds the user agent reference column to the transaction
+ * table.
+ */
++ (NSString *)transactionUserAgentIdColumnDDL;
+
+/**
+ * @return The DDL that adds the sample rate column to the transaction table
+ * (null meaning a rate of 1).
+ */
++ (NSString *)transactionSampleRateColumnDDL;
+
+/**
+ * @return The DDL of the flush batch table.
+ */
++ (NSString *)flushBatchDDL;
+
+/**
+ * @return The DDL that adds the flush batch reference column to the
+ * transaction table (null meaning the transaction is not leased to a batch).
+ */
++ (NSString *)transactionFlushBatchIdColumnDDL;
+
+/**
+ * @return The DDL of the index on the flush batch column of the transaction
+ * table.
+ */
++ (NSString *)transactionFlushBatchIdIndexDDL;
+
+/**
+ * @return The DDL of the index on the GUID column of the transaction table.
+ */
++ (NSString *)transactionGuidIndexDDL;
+
+/**
+ * @return The DDL of the index on the parent-transaction column of the
+ * transaction log table.
+ */
++ (NSString *)transactionLogParentTxnIdIndexDDL;
+
+/**
+ * @param table The name of the table to create.
+ * @return The DDL of the transaction log table whose rows are deleted along
+ * with their parent transaction (ON DELETE CASCADE).
+ */
++ (NSString *)cascadingTransactionLogDDLWithTable:(NSString *)table;
+
+/**
+ * @return The DDL of the temporary table in which the ids of transactions to
+ * be deleted are staged.
+ */
++ (NSString *)tempTransactionIdDDL;
+
+/**
+ * @return The DDL of the transaction rollup table.  The count columns hold
+ * JSON arrays of [key, count] pairs; a non-null flush key means the rollup is
+ * leased to an in-flight flush.
+ */
++ (NSString *)transactionRollupDDL;
+
+/**
+ * @return The DDL of the index on the use case and window start columns of
+ * the transaction rollup table.
+ */
++ (NSString *)transactionRollupWindowIndexDDL;
+
 @end
\ No newline at end of file
@@ -35,6 +35,12 @@ NSString * const COL_TXN_USECASE                     = @"usecase";
 NSString * const COL_TXN_USERAGENT_DEVICE_MAKE       = @"useragent_device_make";
 NSString * const COL_TXN_USERAGENT_DEVICE_OS         = @"useragent_device_os";
 NSString * const COL_TXN_USERAGENT_DEVICE_OS_VERSION = @"useragent_device_os_version";
+NSString * const COL_TXN_USER_AGENT_ID               = @"user_agent_id";
+NSString * const COL_TXN_SAMPLE_RATE                 = @"sample_rate";
+NSString * const COL_TXN_FLUSH_BATCH_ID              = @"flush_batch_id";
+// ----Indexes------------------------------------------------------------------
+NSString * const IDX_TXN_GUID           = @"idx_txn_guid";
+NSString * const IDX_TXN_FLUSH_BATCH_ID = @"idx_txn_flush_batch_id";
 
 //##############################################################################
 // Transaction Log entity
@@ -48,6 +54,60 @@ NSString * const COL_TXNLOG_TIMESTAMP       = @"timestamp";
 NSString * const COL_TXNLOG_USECASE_EVENT   = @"usecase_event";
 NSString * const COL_TXNLOG_IN_CTX_ERR_CODE = @"in_ctx_err_code";
 NSString * const COL_TXNLOG_IN_CTX_ERR_DESC = @"in_ctx_err_desc";
+// ----Indexes------------------------------------------------------------------
+NSString * const IDX_TXNLOG_PARENT_TXN_ID = @"idx_txn_log_txn_id";
+// ----Rebuild table name (see cascadingTransactionLogDDLWithTable:)------------
+NSString * const TBL_TXN_LOG_REBUILD = @"txn_log_rebuild";
+
+//##############################################################################
+// User Agent entity
+//##############################################################################
+// ----Table name---------------------------------------------------------------
+NSString * const TBL_USER_AGENT = @"user_agent";
+// ----Columns------------------------------------------------------------------
+NSString * const COL_USERAGENT_ID                = @"id";
+NSString * const COL_USERAGENT_DEVICE_MAKE       = @"device_make";
+NSString * const COL_USERAGENT_DEVICE_OS         = @"device_os";
+NSString * const COL_USERAGENT_DEVICE_OS_VERSION = @"device_os_version";
+
+//##############################################################################
+// Flush Batch entity
+//##############################################################################
+// ----Table name---------------------------------------------------------------
+NSString * const TBL_FLUSH_BATCH = @"flush_batch";
+// ----Columns------------------------------------------------------------------
+NSString * const COL_FLUSHBATCH_ID              = @"id";
+NSString * const COL_FLUSHBATCH_IDEMPOTENCY_KEY = @"idempotency_key";
+NSString * const COL_FLUSHBATCH_LOG_WATERMARK   = @"log_watermark";
+NSString * const COL_FLUSHBATCH_STATE           = @"state";
+NSString * const COL_FLUSHBATCH_CREATED_AT      = @"created_at";
+
+//##############################################################################
+// Transaction Id staging (temporary; per connection)
+//##############################################################################
+// ----Table name---------------------------------------------------------------
+NSString * const TBL_TEMP_TXN_ID = @"temp_txn_id";
+// ----Columns------------------------------------------------------------------
+NSString * const COL_TEMPTXNID_ID = @"id";
+
+//##############################################################################
+// Transaction Rollup entity
+//##############################################################################
+// ----Table name---------------------------------------------------------------
+NSString * const TBL_TXN_ROLLUP = @"txn_rollup";
+// ----Columns------------------------------------------------------------------
+NSString * const COL_TXNROLLUP_ID                 = @"id";
+NSString * const COL_TXNROLLUP_USECASE            = @"usecase";
+NSString * const COL_TXNROLLUP_WINDOW_START       = @"window_start";
+NSString * const COL_TXNROLLUP_WINDOW_DURATION    = @"window_duration";
+NSString * const COL_TXNROLLUP_NUM_TXNS           = @"num_txns";
+NSString * const COL_TXNROLLUP_NUM_EVENTS         = @"num_events";
+NSString * const COL_TXNROLLUP_EVENT_COUNTS       = @"event_counts";
+NSString * const COL_TXNROLLUP_ERR_CODE_COUNTS    = @"err_code_counts";
+NSString * const COL_TXNROLLUP_DURATION_HISTOGRAM = @"duration_histogram";
+NSString * const COL_TXNROLLUP_FLUSH_KEY          = @"flush_key";
+// ----Indexes------------------------------------------------------------------
+NSString * const IDX_TXNROLLUP_WINDOW = @"idx_txn_rollup_window";
 
 @implementation TLDDLUtils
 
@@ -87,4 +147,128 @@ NSString * const COL_TXNLOG_IN_CTX_ERR_DESC = @"in_ctx_err_desc";
           COL_TXN_ID];                // fk1, tbl-ref col1
 }
 
++ (NSString *)userAgentDDL {
+  return [NSString stringWithFormat:@"CREATE TABLE IF NOT EXISTS %@ ( \
+          %@ INTEGER PRIMARY KEY, \
+          %@ TEXT, \
+          %@ TEXT, \
+          %@ TEXT, \
+          UNIQUE (%@, %@, %@))", TBL_USER_AGENT,
+          COL_USERAGENT_ID,                 // col1
+          COL_USERAGENT_DEVICE_MAKE,        // col2
+          COL_USERAGENT_DEVICE_OS,          // col3
+          COL_USERAGENT_DEVICE_OS_VERSION,  // col4
+          COL_USERAGENT_DEVICE_MAKE,        // uq1, col1
+          COL_USERAGENT_DEVICE_OS,          // uq1, col2
+          COL_USERAGENT_DEVICE_OS_VERSION]; // uq1, col3
+}
+
++ (NSString *)transactionUserAgentIdColumnDDL {
+  return [NSString stringWithFormat:@"ALTER TABLE %@ ADD COLUMN %@ INTEGER \
+          REFERENCES %@(%@)",
+          TBL_TXN,
+          COL_TXN_USER_AGENT_ID,
+          TBL_USER_AGENT,
+          COL_USERAGENT_ID];
+}
+
++ (NSString *)transactionSampleRateColumnDDL {
+  return [NSString stringWithFormat:@"ALTER TABLE %@ ADD COLUMN %@ REAL",
+          TBL_TXN, COL_TXN_SAMPLE_RATE];
+}
+
++ (NSString *)flushBatchDDL {
+  return [NSString stringWithFormat:@"CREATE TABLE IF NOT EXISTS %@ ( \
+          %@ INTEGER PRIMARY KEY, \
+          %@ TEXT NOT NULL UNIQUE, \
+          %@ INTEGER, \
+          %@ INTEGER, \
+          %@ REAL)", TBL_FLUSH_BATCH,
+          COL_FLUSHBATCH_ID,              // col1
+          COL_FLUSHBATCH_IDEMPOTENCY_KEY, // col2
+          COL_FLUSHBATCH_LOG_WATERMARK,   // col3
+          COL_FLUSHBATCH_STATE,           // col4
+          COL_FLUSHBATCH_CREATED_AT];     // col5
+}
+
++ (NSString *)transactionFlushBatchIdColumnDDL {
+  return [NSString stringWithFormat:@"ALTER TABLE %@ ADD COLUMN %@ INTEGER \
+          REFERENCES %@(%@)",
+          TBL_TXN,
+          COL_TXN_FLUSH_BATCH_ID,
+          TBL_FLUSH_BATCH,
+          COL_FLUSHBATCH_ID];
+}
+
++ (NSString *)transactionFlushBatchIdIndexDDL {
+  return [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS %@ ON %@(%@)",
+          IDX_TXN_FLUSH_BATCH_ID, TBL_TXN, COL_TXN_FLUSH_BATCH_ID];
+}
+
++ (NSString *)transactionGuidIndexDDL {
+  return [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS %@ ON %@(%@)",
+          IDX_TXN_GUID, TBL_TXN, COL_TXN_GUID];
+}
+
++ (NSString *)transactionLogParentTxnIdIndexDDL {
+  return [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS %@ ON %@(%@)",
+          IDX_TXNLOG_PARENT_TXN_ID, TBL_TXN_LOG, COL_TXNLOG_PARENT_TXN_ID];
+}
+
++ (NSString *)cascadingTransactionLogDDLWithTable:(NSString *)table {
+  return [NSString stringWithFormat:@"CREATE TABLE IF NOT EXISTS %@ ( \
+          %@ INTEGER PRIMARY KEY, \
+          %@ INTEGER, \
+          %@ REAL, \
+          %@ INTEGER, \
+          %@ TEXT, \
+          %@ TEXT, \
+          FOREIGN KEY (%@) REFERENCES %@(%@) ON DELETE CASCADE)", table,
+          COL_TXNLOG_ID,              // col1
+          COL_TXNLOG_PARENT_TXN_ID,   // col2
+          COL_TXNLOG_TIMESTAMP,       // col3
+          COL_TXNLOG_USECASE_EVENT,   // col4
+          COL_TXNLOG_IN_CTX_ERR_CODE, // col5
+          COL_TXNLOG_IN_CTX_ERR_DESC, // col6
+          COL_TXNLOG_PARENT_TXN_ID,   // fk1, col1
+          TBL_TXN,                    // fk1, tbl-ref
+          COL_TXN_ID];                // fk1, tbl-ref col1
+}
+
++ (NSString *)tempTransactionIdDDL {
+  return [NSString stringWithFormat:@"CREATE TEMP TABLE IF NOT EXISTS %@ ( \
+          %@ INTEGER PRIMARY KEY)", TBL_TEMP_TXN_ID,
+          COL_TEMPTXNID_ID]; // col1
+}
+
++ (NSString *)transactionRollupDDL {
+  return [NSString stringWithFormat:@"CREATE TABLE IF NOT EXISTS %@ ( \
+          %@ INTEGER PRIMARY KEY, \
+          %@ INTEGER, \
+          %@ REAL, \
+          %@ REAL, \
+          %@ INTEGER, \
+          %@ INTEGER, \
+          %@ TEXT, \
+          %@ TEXT, \
+          %@ TEXT, \
+          %@ TEXT)", TBL_TXN_ROLLUP,
+          COL_TXNROLLUP_ID,                  // col1
+          COL_TXNROLLUP_USECASE,             // col2
+          COL_TXNROLLUP_WINDOW_START,        // col3
+          COL_TXNROLLUP_WINDOW_DURATION,     // col4
+          COL_TXNROLLUP_NUM_TXNS,            // col5
+          COL_TXNROLLUP_NUM_EVENTS,          // col6
+          COL_TXNROLLUP_EVENT_COUNTS,        // col7
+          COL_TXNROLLUP_ERR_CODE_COUNTS,     // col8
+          COL_TXNROLLUP_DURATION_HISTOGRAM,  // col9
+          COL_TXNROLLUP_FLUSH_KEY];          // col10
+}
+
++ (NSString *)transactionRollupWindowIndexDDL {
+  return [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS %@ ON %@(%@, %@)",
+          IDX_TXNROLLUP_WINDOW, TBL_TXN_ROLLUP, COL_TXNROLLUP_USECASE,
+          COL_TXNROLLUP_WINDOW_START];
+}
+
 @end
\ No newline at end of file
@@ -0,0 +1,117 @@
+//
+//  TLEventStore.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "TLTypedefs.h"
+
+@class TLTransaction;
+
+/**
+ * A batch of stored transactions leased to a flush (see TLEventStore).
+ */
+@interface TLEventStoreBatch : NSObject
+
+/**
+ * The key identifying the batch to the remote store; the same each time the
+ * batch is leased, including after a restart.
+ */
+@property (nonatomic) NSString *idempotencyKey;
+
+/** The transactions of the batch, with their logs. */
+@property (nonatomic) NSArray *transactions;
+
+/** The total number of logs of the batch's transactions. */
+@property (nonatomic) NSUInteger numLogs;
+
+/** The store's own reference to the batch. */
+@property (nonatomic) id storeRef;
+
+@end
+
+/**
+ * A local store of transaction logs.  Logs are appended, then leased to flushes
+ * in batches, and removed once their batch is acknowledged by the remote
+ * store.  A batch that is leased but never acknowledged (e.g., because the app
+ * was killed mid-flush) is leased again, under the same idempotency key, by the
+ * first flush after a restart.  Implementations are thread-safe.
+ *
+ * Experimental: stores are standalone for now; TLTransactionManager keeps its
+ * logs in its own local database, which is not a TLEventStore.
+ */
+@protocol TLEventStore <NSObject>
+
+/**
+ * Appends the given logs of the given transaction, along with the transaction
+ * itself if it isn't already stored.
+ * @param txnLogs  The TLTransactionLog instances to append.
+ * @param txn      Their parent transaction.
+ * @param errorBlk Error block invoked if the logs cannot be stored.
+ * @return Whether the logs were stored.
+ */
+- (BOOL)appendLogs:(NSArray *)txnLogs
+    forTransaction:(TLTransaction *)txn
+             error:(TLDaoErrorBlk)errorBlk;
+
+/**
+ * Leases the next batch of stored logs: a batch released (or left over from
+ * before a restart) if there is one, otherwise a new batch of logs not yet
+ * leased.
+ * @param errorBlk Error block invoked if the store cannot be read.
+ * @return The batch, or nil if there are no logs to lease.
+ */
+- (TLEventStoreBatch *)leaseNextBatchWithError:(TLDaoErrorBlk)errorBlk;
+
+/**
+ * Removes the logs of the given (leased) batch from the store.
+ * @param batch    The batch the remote store has acknowledged.
+ * @param errorBlk Error block invoked if the logs cannot be removed.
+ */
+- (void)acknowledgeBatch:(TLEventStoreBatch *)batch
+                   error:(TLDaoErrorBlk)errorBlk;
+
+/**
+ * Gives up the lease of the given batch (e.g., because its flush failed), so
+ * that it is the next batch leased.
+ * @param batch The batch.
+ */
+- (void)releaseBatch:(TLEventStoreBatch *)batch;
+
+/**
+ * Reports the backlog of the store.
+ * @param numLogs            Set to the number of stored logs.
+ * @param oldestLogTimestamp Set to the timestamp of the oldest stored log (nil
+ * if none).
+ * @param errorBlk           Error block invoked if the store cannot be read.
+ */
+- (void)backlogNumLogs:(NSUInteger *)numLogs
+    oldestLogTimestamp:(NSDate **)oldestLogTimestamp
+                 error:(TLDaoErrorBlk)errorBlk;
+
+/**
+ * Removes all logs (and transactions) from the store.
+ * @param errorBlk Error block invoked if the store cannot be emptied.
+ */
+- (void)removeAllWithError:(TLDaoErrorBlk)errorBlk;
+
+@end
@@ -0,0 +1,134 @@
+//
+//  TLFlushScheduler.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import "TLClock.h"
+#import "TLTypedefs.h"
+
+/**
+ * Block type invoked by a flush scheduler to learn the size of the backlog of
+ * the local store.
+ * @param NSUInteger* Out-param receiving the number of stored transaction logs.
+ * @param NSDate**    Out-param receiving the timestamp of the oldest stored log
+ * (nil if none).
+ */
+typedef void (^TLFlushBacklogBlk)(NSUInteger *, NSDate **);
+
+/**
+ * Block type invoked by a flush scheduler to flush the local store.  The block
+ * is invoked on the scheduler's work queue, and returns once the flush is done.
+ * @param NSDate** Out-param receiving the 'Retry-After' date of a 503 response.
+ * @return The outcome of the flush.
+ */
+typedef TLFlushOutcome (^TLFlushBlk)(NSDate **);
+
+/**
+ * Decides when to flush the local store.  While started, the scheduler
+ * periodically (every checkInterval seconds) inspects the backlog, and flushes
+ * when at least backlogThreshold logs are stored, or when the oldest stored log
+ * is maxBacklogAge seconds old.
+ *
+ * Failed flushes are retried with exponential backoff (with jitter), starting
+ * at initialBackoff and capped at maxBackoff; a 503 response's 'Retry-After'
+ * date is honored if later.  A flush requested while another is running is
+ * coalesced into a single follow-up flush.
+ *
+ * Timing is driven by a dispatch timer source, with all time arithmetic done
+ * against an injectable clock; evaluate can be invoked directly to step the
+ * scheduler in tests.
+ */
+@interface TLFlushScheduler : NSObject
+
+#pragma mark - Initializers
+
+/**
+ * Initializes a new (stopped) instance.
+ * @param workQueue  Queue the flush block is invoked on.
+ * @param clock      Clock used for all time arithmetic.
+ * @param backlogBlk Block reporting the backlog of the local store.
+ * @param flushBlk   Block performing a flush.
+ * @return The initialized instance.
+ */
+- (id)initWithWorkQueue:(dispatch_queue_t)workQueue
+                  clock:(id<TLClock>)clock
+             backlogBlk:(TLFlushBacklogBlk)backlogBlk
+               flushBlk:(TLFlushBlk)flushBlk;
+
+#pragma mark - Scheduling
+
+/** Starts periodic evaluation of the backlog. */
+- (void)start;
+
+/** Stops periodic evaluation of the backlog (a running flush is unaffected). */
+- (void)stop;
+
+/**
+ * Requests a flush now, regardless of the backlog thresholds.  If a flush is
+ * running, a single follow-up flush is run once it completes; if a backoff
+ * period is in effect, the flush is run when it ends.
+ */
+- (void)requestFlush;
+
+/**
+ * Makes one scheduling decision: flushes if one is due (and no backoff period
+ * is in effect), and re-arms the timer (if started).  Invoked by the timer.
+ */
+- (void)evaluate;
+
+#pragma mark - Properties
+
+/** Seconds between backlog inspections.  Defaults to 30. */
+@property (nonatomic) NSTimeInterval checkInterval;
+
+/** Number of stored logs that triggers a flush.  Defaults to 100. */
+@property (nonatomic) NSUInteger backlogThreshold;
+
+/** Age, in seconds, of the oldest stored log that triggers a flush.  Defaults to 300. */
+@property (nonatomic) NSTimeInterval maxBacklogAge;
+
+/** Backoff, in seconds, after the first failed flush.  Defaults to 5. */
+@property (nonatomic) NSTimeInterval initialBackoff;
+
+/** Upper bound, in seconds, of the backoff.  Defaults to 1800. */
+@property (nonatomic) NSTimeInterval maxBackoff;
+
+/** Factor the backoff grows by with each consecutive failure.  Defaults to 2. */
+@property (nonatomic) double backoffMultiplier;
+
+/**
+ * Fraction (0 to 1) of each backoff period that is randomized, so a fleet of
+ * devices doesn't retry in lockstep; a backoff of b is drawn from
+ * [b * (1 - jitter), b].  Defaults to 0.5.
+ */
+@property (nonatomic) double jitter;
+
+/** The number of consecutive failed flushes. */
+@property (nonatomic, readonly) NSUInteger consecutiveFailureCount;
+
+/** The time before which no flush is started (nil if no backoff is in effect). */
+@property (nonatomic, readonly) NSDate *backoffUntil;
+
+/** Whether a flush is running. */
+@property (nonatomic, readonly, getter=isFlushing) BOOL flushing;
+
+@end
@@ -0,0 +1,220 @@
+//
+//  TLFlushScheduler.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "TLFlushScheduler.h"
+#import "TLLogging.h"
+
+@implementation TLFlushScheduler {
+  dispatch_queue_t _workQueue;
+  dispatch_queue_t _stateQueue;
+  dispatch_source_t _timer;
+  id<TLClock> _clock;
+  TLFlushBacklogBlk _backlogBlk;
+  TLFlushBlk _flushBlk;
+  BOOL _flushRequested;
+}
+
+#pragma mark - Initializers
+
+- (id)initWithWorkQueue:(dispatch_queue_t)workQueue
+                  clock:(id<TLClock>)clock
+             backlogBlk:(TLFlushBacklogBlk)backlogBlk
+               flushBlk:(TLFlushBlk)flushBlk {
+  self = [super init];
+  if (self) {
+    _workQueue = workQueue;
+    _stateQueue = dispatch_queue_create("PEAppTransaction-Logger.apptxnlogging.flushscheduler",
+                                        DISPATCH_QUEUE_SERIAL);
+    _clock = clock;
+    _backlogBlk = [backlogBlk copy];
+    _flushBlk = [flushBlk copy];
+    _checkInterval = 30.0;
+    _backlogThreshold = 100;
+    _maxBacklogAge = 300.0;
+    _initialBackoff = 5.0;
+    _maxBackoff = 1800.0;
+    _backoffMultiplier = 2.0;
+    _jitter = 0.5;
+  }
+  return self;
+}
+
+- (void)dealloc {
+  if (_timer) {
+    dispatch_source_cancel(_timer);
+  }
+}
+
+#pragma mark - Scheduling
+
+- (void)start {
+  dispatch_async(_stateQueue, ^{
+    if (_timer) {
+      return;
+    }
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _stateQueue);
+    __weak TLFlushScheduler *weakSelf = self;
+    dispatch_source_set_event_handler(_timer, ^{
+      [weakSelf evaluateOnStateQueue];
+    });
+    dispatch_resume(_timer);
+    [self armTimer];
+  });
+}
+
+- (void)stop {
+  dispatch_async(_stateQueue, ^{
+    if (_timer) {
+      dispatch_source_cancel(_timer);
+      _timer = nil;
+    }
+  });
+}
+
+- (void)requestFlush {
+  dispatch_async(_stateQueue, ^{
+    _flushRequested = YES;
+    [self evaluateOnStateQueue];
+  });
+}
+
+- (void)evaluate {
+  dispatch_sync(_stateQueue, ^{
+    [self evaluateOnStateQueue];
+  });
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)consecutiveFailureCount {
+  __block NSUInteger count;
+  dispatch_sync(_stateQueue, ^{ count = _consecutiveFailureCount; });
+  return count;
+}
+
+- (NSDate *)backoffUntil {
+  __block NSDate *backoffUntil;
+  dispatch_sync(_stateQueue, ^{ backoffUntil = _backoffUntil; });
+  return backoffUntil;
+}
+
+- (BOOL)isFlushing {
+  __block BOOL flushing;
+  dispatch_sync(_stateQueue, ^{ flushing = _flushing; });
+  return flushing;
+}
+
+#pragma mark - Helpers (invoked on the state queue)
+
+- (void)armTimer {
+  if (!_timer || _flushing) {
+    // (the completion of the running flush re-arms the timer)
+    return;
+  }
+  NSTimeInterval delay = _checkInterval;
+  if (_backoffUntil) {
+    delay = MAX(0.0, [_backoffUntil timeIntervalSinceDate:[_clock now]]);
+  }
+  dispatch_source_set_timer(_timer,
+                            dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                            DISPATCH_TIME_FOREVER,
+                            NSEC_PER_SEC);
+}
+
+- (void)evaluateOnStateQueue {
+  if (_flushing) {
+    return;
+  }
+  NSDate *now = [_clock now];
+  if (_backoffUntil) {
+    if ([now compare:_backoffUntil] == NSOrderedAscending) {
+      [self armTimer];
+      return;
+    }
+    _backoffUntil = nil;
+  }
+  BOOL due = _flushRequested;
+  if (!due) {
+    NSUInteger numLogs = 0;
+    NSDate *oldestLogTimestamp = nil;
+    _backlogBlk(&numLogs, &oldestLogTimestamp);
+    due = (numLogs > 0 && numLogs >= _backlogThreshold) ||
+      (oldestLogTimestamp && [now timeIntervalSinceDate:oldestLogTimestamp] >= _maxBacklogAge);
+  }
+  if (due) {
+    [self startFlush];
+  } else {
+    [self armTimer];
+  }
+}
+
+- (void)startFlush {
+  _flushing = YES;
+  _flushRequested = NO;
+  dispatch_async(_workQueue, ^{
+    NSDate *retryAfter = nil;
+    TLFlushOutcome outcome = _flushBlk(&retryAfter);
+    dispatch_async(_stateQueue, ^{
+      [self flushDidCompleteWithOutcome:outcome retryAfter:retryAfter];
+    });
+  });
+}
+
+- (NSTimeInterval)backoffForFailureCount:(NSUInteger)failureCount {
+  double backoff = _initialBackoff * pow(_backoffMultiplier, failureCount - 1);
+  backoff = MIN(backoff, _maxBackoff);
+  double random = (double)arc4random() / UINT32_MAX;
+  return backoff * (1.0 - _jitter * random);
+}
+
+- (void)flushDidCompleteWithOutcome:(TLFlushOutcome)outcome
+                         retryAfter:(NSDate *)retryAfter {
+  _flushing = NO;
+  switch (outcome) {
+    case TLFlushOutcomeRemoteStoreBusy:
+    case TLFlushOutcomeFailed: {
+      _consecutiveFailureCount++;
+      NSTimeInterval backoff = [self backoffForFailureCount:_consecutiveFailureCount];
+      NSDate *backoffUntil = [[_clock now] dateByAddingTimeInterval:backoff];
+      if (retryAfter) {
+        backoffUntil = [backoffUntil laterDate:retryAfter];
+      }
+      _backoffUntil = backoffUntil;
+      DDLogDebug(@"Flush failed ([%lu] consecutive failures); backing off until [%@].",
+                 (unsigned long)_consecutiveFailureCount, _backoffUntil);
+      break;
+    }
+    default:
+      _consecutiveFailureCount = 0;
+      _backoffUntil = nil;
+      break;
+  }
+  if (_flushRequested && !_backoffUntil) {
+    // a flush requested while this one was running
+    [self startFlush];
+  } else {
+    [self armTimer];
+  }
+}
+
+@end
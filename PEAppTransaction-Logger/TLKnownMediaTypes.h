@@ -23,6 +23,7 @@
 
 #import <Foundation/Foundation.h>
 #import <PEHateoas-Client/HCMediaType.h>
+#import "TLTypedefs.h"
 
 @interface TLKnownMediaTypes : NSObject
 
@@ -36,4 +37,18 @@ media type.
 + (HCMediaType *)txnSetMediaTypeWithVersion:(NSString *)version
                          mediaSubTypePrefix:(NSString *)subtypePrefix;
 
+/**
+ *  @param version The version to accompany the returned 'app transaction log'
+media type instance.
+ *  @param subtypePrefix Prefix string to prepend to the sub-type part of the
+media type.
+ *  @param format The wire format, which determines the suffix of the sub-type
+part of the media type.
+ *  @return A 'app transaction log' media type instance for the given version and
+format.
+ */
++ (HCMediaType *)txnSetMediaTypeWithVersion:(NSString *)version
+                         mediaSubTypePrefix:(NSString *)subtypePrefix
+                                     format:(TLTransactionSetFormat)format;
+
 @end
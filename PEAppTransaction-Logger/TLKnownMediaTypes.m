@@ -26,16 +26,27 @@
 NSString * const applicationType = @"application/";
 NSString * const subtype = @"apptxnset";
 NSString * const jsonSubtypePostfix = @"+json";
+NSString * const msgPackSubtypePostfix = @"+msgpack";
 
-NSString * (^mtBuilder)(NSString *, NSString *, NSString *) = ^NSString *(NSString *mtId, NSString *subtypePrefix, NSString *version) {
-    return [NSString stringWithFormat:@"%@%@%@-v%@%@", applicationType, subtypePrefix, mtId, version, jsonSubtypePostfix];
+NSString * (^mtBuilder)(NSString *, NSString *, NSString *, NSString *) = ^NSString *(NSString *mtId, NSString *subtypePrefix, NSString *version, NSString *subtypePostfix) {
+    return [NSString stringWithFormat:@"%@%@%@-v%@%@", applicationType, subtypePrefix, mtId, version, subtypePostfix];
 };
 
 @implementation TLKnownMediaTypes
 
 + (HCMediaType *)txnSetMediaTypeWithVersion:(NSString *)version
                          mediaSubTypePrefix:(NSString *)subtypePrefix {
-  return [HCMediaType MediaTypeFromString:mtBuilder(subtype, subtypePrefix, version)];
+  return [self txnSetMediaTypeWithVersion:version
+                       mediaSubTypePrefix:subtypePrefix
+                                   format:TLTransactionSetFormatJSON];
+}
+
++ (HCMediaType *)txnSetMediaTypeWithVersion:(NSString *)version
+                         mediaSubTypePrefix:(NSString *)subtypePrefix
+                                     format:(TLTransactionSetFormat)format {
+  NSString *subtypePostfix =
+    (format == TLTransactionSetFormatMessagePack) ? msgPackSubtypePostfix : jsonSubtypePostfix;
+  return [HCMediaType MediaTypeFromString:mtBuilder(subtype, subtypePrefix, version, subtypePostfix)];
 }
 
 @end
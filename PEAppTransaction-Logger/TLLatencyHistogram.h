@@ -0,0 +1,85 @@
+//
+//  TLLatencyHistogram.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+
+/** The number of buckets of a TLLatencyHistogram. */
+#define TL_LATENCY_HISTOGRAM_NUM_BUCKETS 40
+
+/**
+ * @return The current time of the monotonic clock used to time the durations
+ * recorded by latency histograms, in nanoseconds.
+ */
+FOUNDATION_EXPORT uint64_t TLLatencyClockNow(void);
+
+/**
+ * An immutable copy of the contents of a TLLatencyHistogram.
+ */
+@interface TLLatencyHistogramSnapshot : NSObject
+
+/**
+ * @return The (approximate) duration, in seconds, that the given fraction of
+ * the recorded durations did not exceed; e.g., 0.99 for the 99th percentile.
+ * The value is the upper bound of the histogram bucket the percentile falls in
+ * (so it overstates by less than a factor of 2), and is 0 if nothing was
+ * recorded.
+ */
+- (NSTimeInterval)durationAtPercentile:(double)percentile;
+
+/** The number of durations recorded. */
+@property (nonatomic, readonly) uint64_t count;
+
+/** The mean of the durations recorded, in seconds (0 if none were). */
+@property (nonatomic, readonly) NSTimeInterval meanDuration;
+
+/** The longest duration recorded, in seconds. */
+@property (nonatomic, readonly) NSTimeInterval maxDuration;
+
+@end
+
+/**
+ * A histogram of durations with power-of-two (in nanoseconds) buckets.
+ * Recording is lock-free: it updates a few counters with relaxed atomic
+ * operations, so any number of threads can record into a histogram without
+ * waiting on each other.  A snapshot taken while durations are being recorded
+ * may be off by the durations in the midst of being recorded.
+ */
+@interface TLLatencyHistogram : NSObject
+
+/**
+ * Records the duration from the given start time until now.
+ * @param startTime A time obtained from TLLatencyClockNow().
+ */
+- (void)recordDurationSince:(uint64_t)startTime;
+
+/**
+ * Records the given duration.
+ * @param nanoseconds The duration, in nanoseconds.
+ */
+- (void)recordNanoseconds:(uint64_t)nanoseconds;
+
+/** @return A snapshot of the durations recorded so far. */
+- (TLLatencyHistogramSnapshot *)snapshot;
+
+@end
@@ -0,0 +1,119 @@
+//
+//  TLLatencyHistogram.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLLatencyHistogram.h"
+#import <mach/mach_time.h>
+#import <stdatomic.h>
+
+uint64_t TLLatencyClockNow(void) {
+  static mach_timebase_info_data_t timebase;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    mach_timebase_info(&timebase);
+  });
+  return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+@implementation TLLatencyHistogramSnapshot {
+  uint64_t _bucketCounts[TL_LATENCY_HISTOGRAM_NUM_BUCKETS];
+}
+
+#pragma mark - Initializers
+
+- (id)initWithBucketCounts:(const uint64_t *)bucketCounts
+          totalNanoseconds:(uint64_t)totalNanoseconds
+            maxNanoseconds:(uint64_t)maxNanoseconds {
+  self = [super init];
+  if (self) {
+    memcpy(_bucketCounts, bucketCounts, sizeof(_bucketCounts));
+    for (NSUInteger i = 0; i < TL_LATENCY_HISTOGRAM_NUM_BUCKETS; i++) {
+      _count += _bucketCounts[i];
+    }
+    _meanDuration = (_count > 0) ? (totalNanoseconds / (double)_count) / NSEC_PER_SEC : 0.0;
+    _maxDuration = maxNanoseconds / (double)NSEC_PER_SEC;
+  }
+  return self;
+}
+
+#pragma mark - Percentiles
+
+- (NSTimeInterval)durationAtPercentile:(double)percentile {
+  if (_count == 0) {
+    return 0.0;
+  }
+  uint64_t rank = (uint64_t)ceil(MIN(MAX(percentile, 0.0), 1.0) * _count);
+  uint64_t seen = 0;
+  for (NSUInteger i = 0; i < TL_LATENCY_HISTOGRAM_NUM_BUCKETS; i++) {
+    seen += _bucketCounts[i];
+    if (seen >= MAX(rank, 1)) {
+      // bucket i holds durations below 2^(i+1) ns
+      return MIN(ldexp(1.0, (int)i + 1) / NSEC_PER_SEC, _maxDuration);
+    }
+  }
+  return _maxDuration;
+}
+
+@end
+
+@implementation TLLatencyHistogram {
+  _Atomic(uint64_t) _bucketCounts[TL_LATENCY_HISTOGRAM_NUM_BUCKETS];
+  _Atomic(uint64_t) _totalNanoseconds;
+  _Atomic(uint64_t) _maxNanoseconds;
+}
+
+#pragma mark - Recording
+
+- (void)recordDurationSince:(uint64_t)startTime {
+  uint64_t now = TLLatencyClockNow();
+  [self recordNanoseconds:(now > startTime) ? now - startTime : 0];
+}
+
+- (void)recordNanoseconds:(uint64_t)nanoseconds {
+  // bucket i holds durations in [2^i, 2^(i+1)) ns (bucket 0 also holds 0)
+  NSUInteger bucket = (nanoseconds > 1) ? (NSUInteger)(63 - __builtin_clzll(nanoseconds)) : 0;
+  bucket = MIN(bucket, TL_LATENCY_HISTOGRAM_NUM_BUCKETS - 1);
+  atomic_fetch_add_explicit(&_bucketCounts[bucket], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&_totalNanoseconds, nanoseconds, memory_order_relaxed);
+  uint64_t max = atomic_load_explicit(&_maxNanoseconds, memory_order_relaxed);
+  while (nanoseconds > max &&
+         !atomic_compare_exchange_weak_explicit(&_maxNanoseconds, &max, nanoseconds,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+    // max now holds the latest value; retry while ours is still larger
+  }
+}
+
+#pragma mark - Snapshots
+
+- (TLLatencyHistogramSnapshot *)snapshot {
+  uint64_t bucketCounts[TL_LATENCY_HISTOGRAM_NUM_BUCKETS];
+  for (NSUInteger i = 0; i < TL_LATENCY_HISTOGRAM_NUM_BUCKETS; i++) {
+    bucketCounts[i] = atomic_load_explicit(&_bucketCounts[i], memory_order_relaxed);
+  }
+  return [[TLLatencyHistogramSnapshot alloc]
+           initWithBucketCounts:bucketCounts
+               totalNanoseconds:atomic_load_explicit(&_totalNanoseconds, memory_order_relaxed)
+                 maxNanoseconds:atomic_load_explicit(&_maxNanoseconds, memory_order_relaxed)];
+}
+
+@end
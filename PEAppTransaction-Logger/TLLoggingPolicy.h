@@ -0,0 +1,115 @@
+//
+//  TLLoggingPolicy.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Decides which new transactions are recorded.  A policy can sample the
+ * transactions of a use case (record a random fraction of them), rate-limit
+ * them (with a token bucket), or both; use cases without a rule of their own
+ * are sampled at defaultSampleRate.
+ *
+ * A transaction that is not admitted costs next to nothing: it is given no
+ * GUID, and neither it nor its logs are written to the local store.  However,
+ * if alwaysKeepsErrors is YES and such a transaction logs an error (a log with
+ * an in-context error code), the transaction is recorded from that log on, with
+ * a sample rate of 1.
+ *
+ * The sample rate of each recorded transaction is sent with it to the remote
+ * store, so the server can re-weight counts.  For a rate-limited use case, it
+ * is the use case's sample rate scaled by the fraction of sampled transactions
+ * the limit has lately admitted (counted over its interval), so transactions
+ * dropped by the limit are accounted for too.
+ *
+ * A use case can instead be rolled up: none of its transactions are recorded,
+ * but every one of them, and every event they log, is counted into per-window
+ * statistics (see TLTransactionRollup), which are flushed in place of the raw
+ * logs.  Rolled-up use cases are neither sampled nor rate-limited.
+ *
+ * A policy is configured before being installed on a transaction manager, and
+ * must not be reconfigured afterwards; to change the policy at runtime, install
+ * a new instance (see TLTransactionManager's loggingPolicy).  Admission
+ * decisions are thread-safe.
+ */
+@interface TLLoggingPolicy : NSObject
+
+#pragma mark - Configuration
+
+/**
+ * Samples the transactions of the given use case at the given rate.
+ * @param sampleRate The fraction (0 to 1) of transactions to record.
+ * @param usecase    The use case.
+ */
+- (void)setSampleRate:(double)sampleRate
+           forUsecase:(NSNumber *)usecase;
+
+/**
+ * Limits the number of (sampled) transactions of the given use case that are
+ * recorded to maxTransactions per interval, allowing bursts of up to
+ * maxTransactions.
+ * @param maxTransactions The size of the token bucket.
+ * @param interval        The time, in seconds, for an empty bucket to refill.
+ * @param usecase         The use case.
+ */
+- (void)setRateLimitOfTransactions:(NSUInteger)maxTransactions
+                       perInterval:(NSTimeInterval)interval
+                        forUsecase:(NSNumber *)usecase;
+
+/**
+ * Rolls up (or stops rolling up) the transactions of the given use case.
+ * @param rollsUp Whether the use case is rolled up.
+ * @param usecase The use case.
+ */
+- (void)setRollsUp:(BOOL)rollsUp
+        forUsecase:(NSNumber *)usecase;
+
+/**
+ * The sample rate of use cases without a sample rate of their own.  Defaults
+ * to 1.
+ */
+@property (nonatomic) double defaultSampleRate;
+
+/**
+ * Whether transactions that were not admitted are recorded once they log an
+ * error.  Defaults to YES.
+ */
+@property (nonatomic) BOOL alwaysKeepsErrors;
+
+#pragma mark - Admission
+
+/**
+ * @return Whether the transactions of the given use case are rolled up rather
+ * than recorded.
+ */
+- (BOOL)rollsUpUsecase:(NSNumber *)usecase;
+
+/**
+ * Decides whether a new transaction of the given use case is recorded.
+ * @param usecase The use case of the new transaction.
+ * @return The rate at which the transaction is recorded (its sample rate,
+ * scaled by the recent admission rate of its rate limit, if any), or 0 if it
+ * is not to be recorded.
+ */
+- (double)admitTransactionWithUsecase:(NSNumber *)usecase;
+
+@end
@@ -0,0 +1,144 @@
+//
+//  TLLoggingPolicy.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "TLLoggingPolicy.h"
+#import <pthread.h>
+#import <math.h>
+
+/** Token bucket state of a rate-limited use case. */
+@interface TLTokenBucket : NSObject
+@property (nonatomic) double capacity;
+@property (nonatomic) double tokensPerSecond;
+@property (nonatomic) double tokens;
+@property (nonatomic) CFAbsoluteTime lastRefill;
+@property (nonatomic) NSTimeInterval interval;
+// (decayed counts of the sampled transactions offered to the bucket, and of
+// those it admitted)
+@property (nonatomic) double numOffered;
+@property (nonatomic) double numAdmitted;
+@end
+
+@implementation TLTokenBucket
+@end
+
+@implementation TLLoggingPolicy {
+  NSMutableDictionary *_sampleRates;
+  NSMutableDictionary *_tokenBuckets;
+  NSMutableSet *_rolledUpUsecases;
+  pthread_mutex_t _bucketsLock;
+}
+
+#pragma mark - Initializers
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _sampleRates = [NSMutableDictionary dictionary];
+    _tokenBuckets = [NSMutableDictionary dictionary];
+    _rolledUpUsecases = [NSMutableSet set];
+    pthread_mutex_init(&_bucketsLock, NULL);
+    _defaultSampleRate = 1.0;
+    _alwaysKeepsErrors = YES;
+  }
+  return self;
+}
+
+- (void)dealloc {
+  pthread_mutex_destroy(&_bucketsLock);
+}
+
+#pragma mark - Configuration
+
+- (void)setSampleRate:(double)sampleRate
+           forUsecase:(NSNumber *)usecase {
+  [_sampleRates setObject:@(MAX(0.0, MIN(sampleRate, 1.0))) forKey:usecase];
+}
+
+- (void)setRateLimitOfTransactions:(NSUInteger)maxTransactions
+                       perInterval:(NSTimeInterval)interval
+                        forUsecase:(NSNumber *)usecase {
+  TLTokenBucket *bucket = [[TLTokenBucket alloc] init];
+  [bucket setCapacity:maxTransactions];
+  [bucket setTokensPerSecond:(interval > 0 ? maxTransactions / interval : 0)];
+  [bucket setTokens:maxTransactions];
+  [bucket setLastRefill:CFAbsoluteTimeGetCurrent()];
+  [bucket setInterval:interval];
+  [_tokenBuckets setObject:bucket forKey:usecase];
+}
+
+- (void)setRollsUp:(BOOL)rollsUp
+        forUsecase:(NSNumber *)usecase {
+  if (rollsUp) {
+    [_rolledUpUsecases addObject:usecase];
+  } else {
+    [_rolledUpUsecases removeObject:usecase];
+  }
+}
+
+#pragma mark - Admission
+
+- (BOOL)rollsUpUsecase:(NSNumber *)usecase {
+  return [_rolledUpUsecases containsObject:usecase];
+}
+
+- (double)admitTransactionWithUsecase:(NSNumber *)usecase {
+  NSNumber *sampleRateNum = [_sampleRates objectForKey:usecase];
+  double sampleRate = sampleRateNum ? [sampleRateNum doubleValue] : _defaultSampleRate;
+  if (sampleRate <= 0.0) {
+    return 0.0;
+  }
+  if (sampleRate < 1.0 && arc4random() >= sampleRate * UINT32_MAX) {
+    return 0.0;
+  }
+  TLTokenBucket *bucket = [_tokenBuckets objectForKey:usecase];
+  if (bucket) {
+    BOOL admitted = NO;
+    double admissionRate = 0.0;
+    pthread_mutex_lock(&_bucketsLock);
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    double elapsed = now - [bucket lastRefill];
+    double tokens = [bucket tokens] + elapsed * [bucket tokensPerSecond];
+    tokens = MIN(tokens, [bucket capacity]);
+    if (tokens >= 1.0) {
+      tokens -= 1.0;
+      admitted = YES;
+    }
+    [bucket setTokens:tokens];
+    [bucket setLastRefill:now];
+    // The fraction of sampled transactions the bucket has admitted lately
+    // (counts decaying over the bucket's interval) scales the sample rate, so
+    // that the recorded rate accounts for the transactions the limit drops.
+    double decay = [bucket interval] > 0 ? exp(-elapsed / [bucket interval]) : 0.0;
+    [bucket setNumOffered:[bucket numOffered] * decay + 1.0];
+    [bucket setNumAdmitted:[bucket numAdmitted] * decay + (admitted ? 1.0 : 0.0)];
+    admissionRate = [bucket numAdmitted] / [bucket numOffered];
+    pthread_mutex_unlock(&_bucketsLock);
+    if (!admitted) {
+      return 0.0;
+    }
+    return sampleRate * admissionRate;
+  }
+  return sampleRate;
+}
+
+@end
@@ -0,0 +1,161 @@
+//
+//  TLMetrics.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "TLLatencyHistogram.h"
+
+/**
+ * A point-in-time copy of a transaction manager's metrics (see TLMetrics).
+ */
+@interface TLMetricsSnapshot : NSObject
+
+/** When the snapshot was taken. */
+@property (nonatomic) NSDate *timestamp;
+
+#pragma mark - Latencies
+
+/** Latencies of TLTransactionManager's transactionWithUsecase:error:. */
+@property (nonatomic) TLLatencyHistogramSnapshot *transactionCreationLatency;
+
+/**
+ * Latencies of TLTransaction's logWithUsecaseEvent:... methods (and of the bulk
+ * logging methods, one sample per call).
+ */
+@property (nonatomic) TLLatencyHistogramSnapshot *eventLoggingLatency;
+
+/**
+ * Times spent waiting for the local database queue by writes on the logging
+ * path (and by the writes of the write-behind buffer).
+ */
+@property (nonatomic) TLLatencyHistogramSnapshot *databaseQueueWaitLatency;
+
+/** Times spent reading and encoding the body of each flush batch. */
+@property (nonatomic) TLLatencyHistogramSnapshot *serializationLatency;
+
+/** Round-trip times of flush POSTs. */
+@property (nonatomic) TLLatencyHistogramSnapshot *httpRoundTripLatency;
+
+/**
+ * Times spent deleting the rows of each flushed (or evicted) batch of
+ * transactions from the local store.
+ */
+@property (nonatomic) TLLatencyHistogramSnapshot *cleanupLatency;
+
+#pragma mark - Counters
+
+/** The number of events (transaction logs) written to the local store. */
+@property (nonatomic) uint64_t numEventsLogged;
+
+/** The number of events deleted from the local store once flushed. */
+@property (nonatomic) uint64_t numEventsFlushed;
+
+/** The number of events evicted from the local store (see the storage quota). */
+@property (nonatomic) uint64_t numEventsEvicted;
+
+/** The number of events that could not be written to the local store. */
+@property (nonatomic) uint64_t numEventsFailed;
+
+/** The number of flush batches that were not acknowledged. */
+@property (nonatomic) uint64_t numFlushBatchesFailed;
+
+#pragma mark - Gauges
+
+/** The number of events in the local store. */
+@property (nonatomic) int64_t numBacklogEvents;
+
+/** The size of the local store's data file, in bytes. */
+@property (nonatomic) unsigned long long dataFileBytes;
+
+@end
+
+/**
+ * The self-instrumentation of a transaction manager: latency histograms of its
+ * logging and flush paths, counters, and a gauge of the local store's backlog.
+ * All recording is lock-free (relaxed atomic operations), so instrumenting the
+ * logging path adds no contention to it; taking a snapshot reads a few hundred
+ * counters and is cheap enough to do every second.
+ */
+@interface TLMetrics : NSObject
+
+#pragma mark - Recording
+
+/**
+ * Counts the given number of events written to the local store (which adds
+ * them to the backlog).
+ */
+- (void)addEventsLogged:(NSUInteger)numEvents;
+
+/**
+ * Counts the given number of flushed events deleted from the local store
+ * (which removes them from the backlog).
+ */
+- (void)addEventsFlushed:(NSUInteger)numEvents;
+
+/**
+ * Counts the given number of events evicted from the local store (which
+ * removes them from the backlog).
+ */
+- (void)addEventsEvicted:(NSUInteger)numEvents;
+
+/** Counts the given number of events that could not be written. */
+- (void)addEventsFailed:(NSUInteger)numEvents;
+
+/** Counts a flush batch that was not acknowledged. */
+- (void)addFlushBatchFailed;
+
+/**
+ * Sets the backlog gauge (e.g., after events were deleted other than by a
+ * flush or eviction).
+ */
+- (void)setNumBacklogEvents:(int64_t)numEvents;
+
+#pragma mark - Snapshots
+
+/**
+ * @return A snapshot of the metrics recorded so far.
+ * @param dataFileBytes The current size of the local store's data file.
+ */
+- (TLMetricsSnapshot *)snapshotWithDataFileBytes:(unsigned long long)dataFileBytes;
+
+#pragma mark - Properties
+
+/** See TLMetricsSnapshot. */
+@property (nonatomic, readonly) TLLatencyHistogram *transactionCreationLatency;
+
+/** See TLMetricsSnapshot. */
+@property (nonatomic, readonly) TLLatencyHistogram *eventLoggingLatency;
+
+/** See TLMetricsSnapshot. */
+@property (nonatomic, readonly) TLLatencyHistogram *databaseQueueWaitLatency;
+
+/** See TLMetricsSnapshot. */
+@property (nonatomic, readonly) TLLatencyHistogram *serializationLatency;
+
+/** See TLMetricsSnapshot. */
+@property (nonatomic, readonly) TLLatencyHistogram *httpRoundTripLatency;
+
+/** See TLMetricsSnapshot. */
+@property (nonatomic, readonly) TLLatencyHistogram *cleanupLatency;
+
+@end
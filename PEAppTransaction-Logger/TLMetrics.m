@@ -0,0 +1,105 @@
+//
+//  TLMetrics.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLMetrics.h"
+#import <stdatomic.h>
+
+@implementation TLMetricsSnapshot
+@end
+
+@implementation TLMetrics {
+  _Atomic(uint64_t) _numEventsLogged;
+  _Atomic(uint64_t) _numEventsFlushed;
+  _Atomic(uint64_t) _numEventsEvicted;
+  _Atomic(uint64_t) _numEventsFailed;
+  _Atomic(uint64_t) _numFlushBatchesFailed;
+  _Atomic(int64_t) _numBacklogEvents;
+}
+
+#pragma mark - Initializers
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _transactionCreationLatency = [[TLLatencyHistogram alloc] init];
+    _eventLoggingLatency = [[TLLatencyHistogram alloc] init];
+    _databaseQueueWaitLatency = [[TLLatencyHistogram alloc] init];
+    _serializationLatency = [[TLLatencyHistogram alloc] init];
+    _httpRoundTripLatency = [[TLLatencyHistogram alloc] init];
+    _cleanupLatency = [[TLLatencyHistogram alloc] init];
+  }
+  return self;
+}
+
+#pragma mark - Recording
+
+- (void)addEventsLogged:(NSUInteger)numEvents {
+  atomic_fetch_add_explicit(&_numEventsLogged, numEvents, memory_order_relaxed);
+  atomic_fetch_add_explicit(&_numBacklogEvents, (int64_t)numEvents, memory_order_relaxed);
+}
+
+- (void)addEventsFlushed:(NSUInteger)numEvents {
+  atomic_fetch_add_explicit(&_numEventsFlushed, numEvents, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&_numBacklogEvents, (int64_t)numEvents, memory_order_relaxed);
+}
+
+- (void)addEventsEvicted:(NSUInteger)numEvents {
+  atomic_fetch_add_explicit(&_numEventsEvicted, numEvents, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&_numBacklogEvents, (int64_t)numEvents, memory_order_relaxed);
+}
+
+- (void)addEventsFailed:(NSUInteger)numEvents {
+  atomic_fetch_add_explicit(&_numEventsFailed, numEvents, memory_order_relaxed);
+}
+
+- (void)addFlushBatchFailed {
+  atomic_fetch_add_explicit(&_numFlushBatchesFailed, 1, memory_order_relaxed);
+}
+
+- (void)setNumBacklogEvents:(int64_t)numEvents {
+  atomic_store_explicit(&_numBacklogEvents, numEvents, memory_order_relaxed);
+}
+
+#pragma mark - Snapshots
+
+- (TLMetricsSnapshot *)snapshotWithDataFileBytes:(unsigned long long)dataFileBytes {
+  TLMetricsSnapshot *snapshot = [[TLMetricsSnapshot alloc] init];
+  [snapshot setTimestamp:[NSDate date]];
+  [snapshot setTransactionCreationLatency:[_transactionCreationLatency snapshot]];
+  [snapshot setEventLoggingLatency:[_eventLoggingLatency snapshot]];
+  [snapshot setDatabaseQueueWaitLatency:[_databaseQueueWaitLatency snapshot]];
+  [snapshot setSerializationLatency:[_serializationLatency snapshot]];
+  [snapshot setHttpRoundTripLatency:[_httpRoundTripLatency snapshot]];
+  [snapshot setCleanupLatency:[_cleanupLatency snapshot]];
+  [snapshot setNumEventsLogged:atomic_load_explicit(&_numEventsLogged, memory_order_relaxed)];
+  [snapshot setNumEventsFlushed:atomic_load_explicit(&_numEventsFlushed, memory_order_relaxed)];
+  [snapshot setNumEventsEvicted:atomic_load_explicit(&_numEventsEvicted, memory_order_relaxed)];
+  [snapshot setNumEventsFailed:atomic_load_explicit(&_numEventsFailed, memory_order_relaxed)];
+  [snapshot setNumFlushBatchesFailed:atomic_load_explicit(&_numFlushBatchesFailed, memory_order_relaxed)];
+  [snapshot setNumBacklogEvents:atomic_load_explicit(&_numBacklogEvents, memory_order_relaxed)];
+  [snapshot setDataFileBytes:dataFileBytes];
+  return snapshot;
+}
+
+@end
@@ -26,6 +26,11 @@
 // Notification Names
 FOUNDATION_EXPORT NSString * const TLTransactionSetFlushedSuccessfullyNotification;
 FOUNDATION_EXPORT NSString * const TLTransactionSetFlushServerBusyNotification;
+FOUNDATION_EXPORT NSString * const TLTransactionsEvictedNotification;
 
 // User info dictionary keys
 FOUNDATION_EXPORT NSString * const TLNumTransactionsFlushedKey;
+FOUNDATION_EXPORT NSString * const TLTotalNumTransactionsFlushedKey;
+FOUNDATION_EXPORT NSString * const TLFlushBatchNumberKey;
+FOUNDATION_EXPORT NSString * const TLNumTransactionsEvictedKey;
+FOUNDATION_EXPORT NSString * const TLNumTransactionLogsEvictedKey;
@@ -26,6 +26,9 @@
 // Notification names
 NSString * const TLTransactionSetFlushedSuccessfullyNotification = @"PEAppTransaction-Logger-TransactionSetFlushedSuccessfullyNotification";
 NSString * const TLTransactionSetFlushServerBusyNotification = @"PEAppTransaction-Logger-TransactionSetFlushServerBusyNotification";
+NSString * const TLTransactionsEvictedNotification = @"PEAppTransaction-Logger-TransactionsEvictedNotification";
 
 // User info dictionary keys
-NSString * const TLNumTransactionsFlushedKey = @"PEAppTransaction-Logger-NumTransactionsFlushedKey";
\ No newline at end of file
+NSString * const TLNumTransactionsFlushedKey = @"PEAppTransaction-Logger-NumTransactionsFlushedKey";
+NSString * const TLTotalNumTransactionsFlushedKey = @"PEAppTransaction-Logger-TotalNumTransactionsFlushedKey";
+NSString * const TLFlushBatchNumberKey = @"PEAppTransaction-Logger-FlushBatchNumberKey";
\ No newline at end of file
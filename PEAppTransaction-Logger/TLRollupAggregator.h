@@ -0,0 +1,80 @@
+//
+//  TLRollupAggregator.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "TLTransactionRollup.h"
+
+/**
+ * The in-memory rollups (see TLTransactionRollup) of the use cases a logging
+ * policy rolls up.  Each transaction and event is folded into the rollup of
+ * its use case and of the window its time falls in; windows are aligned to
+ * multiples of windowDuration since the Unix epoch.  The rollups are drained
+ * (by the transaction manager, into the local store) when the manager syncs,
+ * when the app enters the background and before each flush.  Thread-safe.
+ */
+@interface TLRollupAggregator : NSObject
+
+#pragma mark - Recording
+
+/**
+ * Counts a new transaction of the given use case, at the current time.
+ * @param usecase The use case.
+ */
+- (void)addTransactionWithUsecase:(NSNumber *)usecase;
+
+/**
+ * Counts an event of a transaction of the given use case.
+ * @param usecase            The use case.
+ * @param usecaseEvent       The use case event.
+ * @param inContextErrCode   The in-context error code of the event (may be
+ * nil).
+ * @param timestamp          The time of the event.
+ * @param sincePreviousEvent The time, in seconds, since the previous event of
+ * the same transaction; negative if the event is its transaction's first.
+ */
+- (void)addEventWithUsecase:(NSNumber *)usecase
+               usecaseEvent:(NSNumber *)usecaseEvent
+           inContextErrCode:(NSNumber *)inContextErrCode
+                  timestamp:(NSDate *)timestamp
+         sincePreviousEvent:(NSTimeInterval)sincePreviousEvent;
+
+#pragma mark - Draining
+
+/**
+ * Removes and returns all the in-memory rollups.  A use case may have several
+ * rollups of the same window (e.g., for events logged out of time order); they
+ * are merged when stored.
+ * @return The TLTransactionRollup instances.
+ */
+- (NSArray *)drainRollups;
+
+#pragma mark - Properties
+
+/**
+ * The length, in seconds, of the rollup windows.  Changing it affects rollups
+ * begun from then on.  Defaults to 300.
+ */
+@property (atomic) NSTimeInterval windowDuration;
+
+@end
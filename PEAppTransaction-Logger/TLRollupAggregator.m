@@ -0,0 +1,127 @@
+//
+//  TLRollupAggregator.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLRollupAggregator.h"
+#import <pthread.h>
+
+@implementation TLRollupAggregator {
+  // the rollup of each use case's most recent window
+  NSMutableDictionary *_currentRollups;
+  // rollups of earlier windows, awaiting the next drain
+  NSMutableArray *_pastRollups;
+  pthread_mutex_t _lock;
+}
+
+#pragma mark - Initializers
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _currentRollups = [NSMutableDictionary dictionary];
+    _pastRollups = [NSMutableArray array];
+    pthread_mutex_init(&_lock, NULL);
+    _windowDuration = 300;
+  }
+  return self;
+}
+
+- (void)dealloc {
+  pthread_mutex_destroy(&_lock);
+}
+
+#pragma mark - Helpers
+
+// Invoked with the lock held.
+- (TLTransactionRollup *)rollupOfUsecase:(NSNumber *)usecase
+                                  atTime:(NSTimeInterval)time {
+  NSTimeInterval windowDuration = MAX([self windowDuration], 1);
+  NSTimeInterval windowStart = floor(time / windowDuration) * windowDuration;
+  TLTransactionRollup *rollup = _currentRollups[usecase];
+  if (rollup &&
+      [[rollup windowStart] timeIntervalSince1970] == windowStart &&
+      [rollup windowDuration] == windowDuration) {
+    return rollup;
+  }
+  if (rollup && windowStart < [[rollup windowStart] timeIntervalSince1970]) {
+    // a straggler from an earlier window
+    for (TLTransactionRollup *pastRollup in [_pastRollups reverseObjectEnumerator]) {
+      if ([[pastRollup usecase] isEqualToNumber:usecase] &&
+          [[pastRollup windowStart] timeIntervalSince1970] == windowStart &&
+          [pastRollup windowDuration] == windowDuration) {
+        return pastRollup;
+      }
+    }
+  }
+  TLTransactionRollup *newRollup =
+    [[TLTransactionRollup alloc] initWithUsecase:usecase
+                                     windowStart:[NSDate dateWithTimeIntervalSince1970:windowStart]
+                                  windowDuration:windowDuration];
+  if (!rollup || windowStart > [[rollup windowStart] timeIntervalSince1970]) {
+    // the current window has moved on
+    if (rollup) {
+      [_pastRollups addObject:rollup];
+    }
+    _currentRollups[usecase] = newRollup;
+  } else {
+    // (merged with the stored rollup of its window, if any, when stored)
+    [_pastRollups addObject:newRollup];
+  }
+  return newRollup;
+}
+
+#pragma mark - Recording
+
+- (void)addTransactionWithUsecase:(NSNumber *)usecase {
+  NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+  pthread_mutex_lock(&_lock);
+  [[self rollupOfUsecase:usecase atTime:now] addTransaction];
+  pthread_mutex_unlock(&_lock);
+}
+
+- (void)addEventWithUsecase:(NSNumber *)usecase
+               usecaseEvent:(NSNumber *)usecaseEvent
+           inContextErrCode:(NSNumber *)inContextErrCode
+                  timestamp:(NSDate *)timestamp
+         sincePreviousEvent:(NSTimeInterval)sincePreviousEvent {
+  pthread_mutex_lock(&_lock);
+  [[self rollupOfUsecase:usecase atTime:[timestamp timeIntervalSince1970]]
+    addEventWithUsecaseEvent:usecaseEvent
+            inContextErrCode:inContextErrCode
+          sincePreviousEvent:sincePreviousEvent];
+  pthread_mutex_unlock(&_lock);
+}
+
+#pragma mark - Draining
+
+- (NSArray *)drainRollups {
+  pthread_mutex_lock(&_lock);
+  NSMutableArray *rollups = _pastRollups;
+  [rollups addObjectsFromArray:[_currentRollups allValues]];
+  _pastRollups = [NSMutableArray array];
+  [_currentRollups removeAllObjects];
+  pthread_mutex_unlock(&_lock);
+  return rollups;
+}
+
+@end
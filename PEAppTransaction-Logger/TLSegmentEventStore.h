@@ -0,0 +1,79 @@
+//
+//  TLSegmentEventStore.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "TLEventStore.h"
+
+/**
+ * A TLEventStore kept as a directory of append-only segment files.  Logs are
+ * appended, as CRC-checked frames, to the active segment, which is
+ * preallocated and memory-mapped so that an append is a copy into the mapping
+ * (no system call, no SQL).  When the active segment fills up (or a flush
+ * leases it) it is sealed: synced, unmapped and truncated to its used length.
+ * Each sealed segment is one batch, keyed by the store's identifier and the
+ * segment's sequence number, and is unlinked once acknowledged.
+ *
+ * Writes to the mapping survive the app being killed, but not the device
+ * losing power before the kernel writes them back; a segment torn that way
+ * is read up to its last intact frame.
+ *
+ * Segment files ("<sequence number>.tlseg") are a run of frames, each a 32-bit
+ * payload length, a 32-bit CRC-32 of the payload, then the payload; the rest of
+ * a segment that isn't sealed is zeros.  A payload is a type byte, then:
+ *
+ * - a transaction (1): its id within the segment, use case (64-bit integers),
+ *   sample rate (a double), 16-byte GUID, then its user agent device make, OS
+ *   and OS version (strings);
+ * - a log (2): its transaction's id within the segment (a 64-bit integer),
+ *   timestamp (a double, seconds since 1970), use case event and in-context
+ *   error code (64-bit integers), then in-context error description (a
+ *   string).
+ *
+ * All integers, and the bits of doubles, are little-endian.  A nil number is
+ * INT64_MIN.  A string is a 32-bit length followed by that many bytes of
+ * UTF-8; a nil string is the length UINT32_MAX alone.
+ *
+ * Experimental, as is the TLEventStore protocol.
+ */
+@interface TLSegmentEventStore : NSObject <TLEventStore>
+
+#pragma mark - Initializers
+
+/**
+ * Initializes a new instance over the given directory (created if need be),
+ * picking up the segments left in it.
+ * @param directoryPath The path of the directory holding the segment files.
+ * @return The initialized instance.
+ */
+- (id)initWithDirectoryPath:(NSString *)directoryPath;
+
+#pragma mark - Properties
+
+/**
+ * The size, in bytes, segments are preallocated with.  Defaults to 1 MiB.
+ * A single append larger than this gets a segment of its own.
+ */
+@property (nonatomic) NSUInteger segmentSize;
+
+@end
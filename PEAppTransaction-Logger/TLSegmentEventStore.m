@@ -0,0 +1,564 @@
+//
+//  TLSegmentEventStore.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLSegmentEventStore.h"
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <zlib.h>
+#import <libkern/OSByteOrder.h>
+#import "TLTransaction.h"
+#import "TLTransactionLog.h"
+
+// Frames are a 32-bit payload length and a 32-bit CRC of the payload,
+// followed by the payload (see TLSegmentEventStore.h); all integers, and the
+// bits of doubles, are little-endian.
+static const uint32_t TLSegmentFrameHeaderSize = 8;
+
+typedef NS_ENUM(uint8_t, TLSegmentFrameType) {
+  TLSegmentFrameTypeTransaction = 1,
+  TLSegmentFrameTypeLog = 2
+};
+
+// transaction GUIDs are stored in their 16-byte form
+enum { TLSegmentGuidSize = 16 };
+
+// stands in for a nil number
+static const int64_t TLSegmentNilNumber = INT64_MIN;
+
+// stands in for the length of a nil string
+static const uint32_t TLSegmentNilStringLength = UINT32_MAX;
+
+static NSString * const TLSegmentFileExtension = @"tlseg";
+
+static NSString * const TLSegmentStoreIdFileName = @"store-id";
+
+#pragma mark - Frame encoding
+
+static void TLSegmentAppendBytes(NSMutableData *data, const void *bytes, NSUInteger length) {
+  [data appendBytes:bytes length:length];
+}
+
+static void TLSegmentAppendUInt32(NSMutableData *data, uint32_t value) {
+  uint32_t littleEndianValue = OSSwapHostToLittleInt32(value);
+  TLSegmentAppendBytes(data, &littleEndianValue, sizeof(littleEndianValue));
+}
+
+static void TLSegmentAppendUInt64(NSMutableData *data, uint64_t value) {
+  uint64_t littleEndianValue = OSSwapHostToLittleInt64(value);
+  TLSegmentAppendBytes(data, &littleEndianValue, sizeof(littleEndianValue));
+}
+
+static void TLSegmentAppendDouble(NSMutableData *data, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  TLSegmentAppendUInt64(data, bits);
+}
+
+static void TLSegmentAppendNumber(NSMutableData *data, NSNumber *number) {
+  int64_t value = number ? [number longLongValue] : TLSegmentNilNumber;
+  TLSegmentAppendUInt64(data, (uint64_t)value);
+}
+
+static void TLSegmentAppendString(NSMutableData *data, NSString *string) {
+  NSData *utf8 = [string dataUsingEncoding:NSUTF8StringEncoding];
+  if (!utf8) {
+    TLSegmentAppendUInt32(data, TLSegmentNilStringLength);
+    return;
+  }
+  TLSegmentAppendUInt32(data, (uint32_t)[utf8 length]);
+  TLSegmentAppendBytes(data, [utf8 bytes], [utf8 length]);
+}
+
+static void TLSegmentAppendFrame(NSMutableData *data, NSData *payload) {
+  uint32_t length = (uint32_t)[payload length];
+  TLSegmentAppendUInt32(data, length);
+  TLSegmentAppendUInt32(data, (uint32_t)crc32(0L, [payload bytes], length));
+  [data appendData:payload];
+}
+
+#pragma mark - Frame decoding
+
+typedef struct {
+  const uint8_t *bytes;
+  NSUInteger length;
+  NSUInteger offset;
+  BOOL overrun;
+} TLSegmentReader;
+
+static void TLSegmentRead(TLSegmentReader *reader, void *value, NSUInteger length) {
+  if (reader->overrun || reader->offset + length > reader->length) {
+    reader->overrun = YES;
+    memset(value, 0, length);
+    return;
+  }
+  memcpy(value, reader->bytes + reader->offset, length);
+  reader->offset += length;
+}
+
+static uint32_t TLSegmentReadUInt32(TLSegmentReader *reader) {
+  uint32_t littleEndianValue;
+  TLSegmentRead(reader, &littleEndianValue, sizeof(littleEndianValue));
+  return OSSwapLittleToHostInt32(littleEndianValue);
+}
+
+static uint64_t TLSegmentReadUInt64(TLSegmentReader *reader) {
+  uint64_t littleEndianValue;
+  TLSegmentRead(reader, &littleEndianValue, sizeof(littleEndianValue));
+  return OSSwapLittleToHostInt64(littleEndianValue);
+}
+
+static double TLSegmentReadDouble(TLSegmentReader *reader) {
+  uint64_t bits = TLSegmentReadUInt64(reader);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static NSNumber * TLSegmentReadNumber(TLSegmentReader *reader) {
+  int64_t value = (int64_t)TLSegmentReadUInt64(reader);
+  return value == TLSegmentNilNumber ? nil : @(value);
+}
+
+static NSString * TLSegmentReadString(TLSegmentReader *reader) {
+  uint32_t length = TLSegmentReadUInt32(reader);
+  if (length == TLSegmentNilStringLength || reader->overrun) {
+    return nil;
+  }
+  if (length > reader->length - reader->offset) {
+    reader->overrun = YES;
+    return nil;
+  }
+  NSString *string = [[NSString alloc] initWithBytes:reader->bytes + reader->offset
+                                              length:length
+                                            encoding:NSUTF8StringEncoding];
+  reader->offset += length;
+  return string;
+}
+
+@implementation TLSegmentEventStore {
+  NSString *_directoryPath;
+  NSString *_storeId;
+  uint64_t _nextSegmentSeq;
+  // sealed segments, in sequence order, and those of them leased
+  NSMutableArray *_sealedSegmentSeqs;
+  NSMutableSet *_leasedSegmentSeqs;
+  NSMutableDictionary *_numLogsBySegmentSeq;
+  NSMutableDictionary *_oldestLogTimestampBySegmentSeq;
+  // the active segment (none until the first append after a seal)
+  BOOL _hasActiveSegment;
+  uint64_t _activeSegmentSeq;
+  int _activeSegmentFd;
+  uint8_t *_activeSegmentMap;
+  NSUInteger _activeSegmentCapacity;
+  NSUInteger _activeSegmentLength;
+  NSUInteger _activeSegmentNumLogs;
+  NSDate *_activeSegmentOldestLogTimestamp;
+  // segment-local ids of the transactions whose header frame has been written
+  // to the active segment, by GUID bytes
+  NSMutableDictionary *_txnIdsInActiveSegment;
+}
+
+#pragma mark - Initializers
+
+- (id)initWithDirectoryPath:(NSString *)directoryPath {
+  self = [super init];
+  if (self) {
+    _directoryPath = directoryPath;
+    _segmentSize = 1024 * 1024;
+    _sealedSegmentSeqs = [NSMutableArray array];
+    _leasedSegmentSeqs = [NSMutableSet set];
+    _numLogsBySegmentSeq = [NSMutableDictionary dictionary];
+    _oldestLogTimestampBySegmentSeq = [NSMutableDictionary dictionary];
+    _txnIdsInActiveSegment = [NSMutableDictionary dictionary];
+    _activeSegmentFd = -1;
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    [fileManager createDirectoryAtPath:directoryPath
+           withIntermediateDirectories:YES
+                            attributes:nil
+                                 error:nil];
+    NSString *storeIdPath = [directoryPath stringByAppendingPathComponent:TLSegmentStoreIdFileName];
+    _storeId = [NSString stringWithContentsOfFile:storeIdPath encoding:NSUTF8StringEncoding error:nil];
+    if (![_storeId length]) {
+      _storeId = [[NSUUID UUID] UUIDString];
+      [_storeId writeToFile:storeIdPath atomically:YES encoding:NSUTF8StringEncoding error:nil];
+    }
+    // Segments left over from before a restart (including the one that was
+    // active) are all sealed; their unused tails read as a zero length.
+    NSMutableArray *segmentSeqs = [NSMutableArray array];
+    for (NSString *fileName in [fileManager contentsOfDirectoryAtPath:directoryPath error:nil]) {
+      if ([[fileName pathExtension] isEqualToString:TLSegmentFileExtension]) {
+        [segmentSeqs addObject:@(strtoull([[fileName stringByDeletingPathExtension] UTF8String], NULL, 10))];
+      }
+    }
+    [segmentSeqs sortUsingSelector:@selector(compare:)];
+    _nextSegmentSeq = 1;
+    for (NSNumber *segmentSeq in segmentSeqs) {
+      NSUInteger numLogs = 0;
+      NSDate *oldestLogTimestamp = nil;
+      [self readSegment:[segmentSeq unsignedLongLongValue]
+                numLogs:&numLogs
+     oldestLogTimestamp:&oldestLogTimestamp];
+      [self addSealedSegment:[segmentSeq unsignedLongLongValue]
+                     numLogs:numLogs
+          oldestLogTimestamp:oldestLogTimestamp];
+      _nextSegmentSeq = [segmentSeq unsignedLongLongValue] + 1;
+    }
+  }
+  return self;
+}
+
+- (void)dealloc {
+  [self sealActiveSegment];
+}
+
+#pragma mark - Helpers
+
+- (NSString *)pathForSegment:(uint64_t)segmentSeq {
+  return [_directoryPath stringByAppendingPathComponent:
+          [NSString stringWithFormat:@"%016llu.%@", segmentSeq, TLSegmentFileExtension]];
+}
+
+- (void)invokeError:(TLDaoErrorBlk)errorBlk {
+  int errorCode = errno;
+  NSString *errorMessage = [NSString stringWithUTF8String:strerror(errorCode)];
+  if (errorBlk) {
+    errorBlk([NSError errorWithDomain:NSPOSIXErrorDomain
+                                 code:errorCode
+                             userInfo:@{NSLocalizedDescriptionKey : errorMessage}],
+             errorCode,
+             errorMessage);
+  }
+}
+
+- (void)addSealedSegment:(uint64_t)segmentSeq
+                 numLogs:(NSUInteger)numLogs
+      oldestLogTimestamp:(NSDate *)oldestLogTimestamp {
+  [_sealedSegmentSeqs addObject:@(segmentSeq)];
+  _numLogsBySegmentSeq[@(segmentSeq)] = @(numLogs);
+  if (oldestLogTimestamp) {
+    _oldestLogTimestampBySegmentSeq[@(segmentSeq)] = oldestLogTimestamp;
+  }
+}
+
+- (void)removeSegment:(uint64_t)segmentSeq {
+  unlink([[self pathForSegment:segmentSeq] fileSystemRepresentation]);
+  [_sealedSegmentSeqs removeObject:@(segmentSeq)];
+  [_leasedSegmentSeqs removeObject:@(segmentSeq)];
+  [_numLogsBySegmentSeq removeObjectForKey:@(segmentSeq)];
+  [_oldestLogTimestampBySegmentSeq removeObjectForKey:@(segmentSeq)];
+}
+
+#pragma mark - Active segment
+
+- (BOOL)openActiveSegmentWithCapacity:(NSUInteger)capacity error:(TLDaoErrorBlk)errorBlk {
+  uint64_t segmentSeq = _nextSegmentSeq;
+  const char *path = [[self pathForSegment:segmentSeq] fileSystemRepresentation];
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    [self invokeError:errorBlk];
+    return NO;
+  }
+  // preallocated (zero-filled), so that the mapping never has to grow
+  if (ftruncate(fd, (off_t)capacity) != 0) {
+    [self invokeError:errorBlk];
+    close(fd);
+    unlink(path);
+    return NO;
+  }
+  void *map = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    [self invokeError:errorBlk];
+    close(fd);
+    unlink(path);
+    return NO;
+  }
+  _nextSegmentSeq++;
+  _hasActiveSegment = YES;
+  _activeSegmentSeq = segmentSeq;
+  _activeSegmentFd = fd;
+  _activeSegmentMap = map;
+  _activeSegmentCapacity = capacity;
+  _activeSegmentLength = 0;
+  _activeSegmentNumLogs = 0;
+  _activeSegmentOldestLogTimestamp = nil;
+  [_txnIdsInActiveSegment removeAllObjects];
+  return YES;
+}
+
+- (void)sealActiveSegment {
+  if (!_hasActiveSegment) {
+    return;
+  }
+  msync(_activeSegmentMap, _activeSegmentCapacity, MS_SYNC);
+  munmap(_activeSegmentMap, _activeSegmentCapacity);
+  ftruncate(_activeSegmentFd, (off_t)_activeSegmentLength);
+  close(_activeSegmentFd);
+  _hasActiveSegment = NO;
+  _activeSegmentMap = NULL;
+  _activeSegmentFd = -1;
+  [_txnIdsInActiveSegment removeAllObjects];
+  if (_activeSegmentLength > 0) {
+    [self addSealedSegment:_activeSegmentSeq
+                   numLogs:_activeSegmentNumLogs
+        oldestLogTimestamp:_activeSegmentOldestLogTimestamp];
+  } else {
+    unlink([[self pathForSegment:_activeSegmentSeq] fileSystemRepresentation]);
+  }
+}
+
+- (NSData *)framesForLogs:(NSArray *)txnLogs ofTransaction:(TLTransaction *)txn {
+  NSMutableData *frames = [NSMutableData data];
+  NSNumber *txnId = _txnIdsInActiveSegment[[txn guidBytes]];
+  if (!txnId) {
+    txnId = @([_txnIdsInActiveSegment count] + 1);
+    NSMutableData *payload = [NSMutableData data];
+    uint8_t type = TLSegmentFrameTypeTransaction;
+    TLSegmentAppendBytes(payload, &type, sizeof(type));
+    TLSegmentAppendNumber(payload, txnId);
+    TLSegmentAppendNumber(payload, [txn usecase]);
+    TLSegmentAppendDouble(payload, [txn sampleRate]);
+    uint8_t guidBytes[TLSegmentGuidSize] = {0};
+    [[txn guidBytes] getBytes:guidBytes length:TLSegmentGuidSize];
+    TLSegmentAppendBytes(payload, guidBytes, TLSegmentGuidSize);
+    TLSegmentAppendString(payload, [txn userAgentDeviceMake]);
+    TLSegmentAppendString(payload, [txn userAgentDeviceOS]);
+    TLSegmentAppendString(payload, [txn userAgentDeviceOSVersion]);
+    TLSegmentAppendFrame(frames, payload);
+  }
+  for (TLTransactionLog *txnLog in txnLogs) {
+    NSMutableData *payload = [NSMutableData data];
+    uint8_t type = TLSegmentFrameTypeLog;
+    TLSegmentAppendBytes(payload, &type, sizeof(type));
+    TLSegmentAppendNumber(payload, txnId);
+    TLSegmentAppendDouble(payload, [[txnLog timestamp] timeIntervalSince1970]);
+    TLSegmentAppendNumber(payload, [txnLog usecaseEvent]);
+    TLSegmentAppendNumber(payload, [txnLog inContextErrCode]);
+    TLSegmentAppendString(payload, [txnLog inContextLocalizedErrDesc]);
+    TLSegmentAppendFrame(frames, payload);
+  }
+  return frames;
+}
+
+#pragma mark - Reading segments
+
+// Reads the given segment up to its last intact frame, returning its
+// transactions (with their logs), in order of their first log.
+- (NSArray *)readSegment:(uint64_t)segmentSeq
+                 numLogs:(NSUInteger *)numLogs
+      oldestLogTimestamp:(NSDate **)oldestLogTimestamp {
+  NSData *segment = [NSData dataWithContentsOfFile:[self pathForSegment:segmentSeq]
+                                           options:NSDataReadingMappedIfSafe
+                                             error:nil];
+  NSMutableArray *transactions = [NSMutableArray array];
+  NSMutableDictionary *txnsById = [NSMutableDictionary dictionary];
+  NSMutableDictionary *txnLogsById = [NSMutableDictionary dictionary];
+  NSUInteger numSegmentLogs = 0;
+  NSDate *oldestSegmentLogTimestamp = nil;
+  const uint8_t *bytes = [segment bytes];
+  NSUInteger segmentLength = [segment length];
+  NSUInteger offset = 0;
+  while (offset + TLSegmentFrameHeaderSize <= segmentLength) {
+    uint32_t payloadLength = OSReadLittleInt32(bytes, offset);
+    uint32_t crc = OSReadLittleInt32(bytes, offset + sizeof(payloadLength));
+    const uint8_t *payload = bytes + offset + TLSegmentFrameHeaderSize;
+    if (payloadLength == 0 ||
+        payloadLength > segmentLength - offset - TLSegmentFrameHeaderSize ||
+        (uint32_t)crc32(0L, payload, payloadLength) != crc) {
+      // the unused tail, or a torn frame
+      break;
+    }
+    offset += TLSegmentFrameHeaderSize + payloadLength;
+    TLSegmentReader reader = { payload, payloadLength, 0, NO };
+    uint8_t type;
+    TLSegmentRead(&reader, &type, sizeof(type));
+    if (type == TLSegmentFrameTypeTransaction) {
+      NSNumber *txnId = TLSegmentReadNumber(&reader);
+      NSNumber *usecase = TLSegmentReadNumber(&reader);
+      double sampleRate = TLSegmentReadDouble(&reader);
+      uint8_t guidBytes[TLSegmentGuidSize];
+      TLSegmentRead(&reader, guidBytes, TLSegmentGuidSize);
+      NSString *deviceMake = TLSegmentReadString(&reader);
+      NSString *deviceOS = TLSegmentReadString(&reader);
+      NSString *deviceOSVersion = TLSegmentReadString(&reader);
+      if (reader.overrun || !txnId) {
+        break;
+      }
+      TLTransaction *txn = [[TLTransaction alloc] initWithUsecase:usecase
+                                                          localId:txnId
+                                                             guid:nil
+                                              userAgentDeviceMake:deviceMake
+                                                userAgentDeviceOS:deviceOS
+                                         userAgentDeviceOSVersion:deviceOSVersion
+                                                    databaseQueue:nil];
+      [txn setGuidBytes:[NSData dataWithBytes:guidBytes length:TLSegmentGuidSize]];
+      [txn setSampleRate:sampleRate];
+      txnsById[txnId] = txn;
+    } else if (type == TLSegmentFrameTypeLog) {
+      NSNumber *txnId = TLSegmentReadNumber(&reader);
+      double timestamp = TLSegmentReadDouble(&reader);
+      NSNumber *usecaseEvent = TLSegmentReadNumber(&reader);
+      NSNumber *errCode = TLSegmentReadNumber(&reader);
+      NSString *errDesc = TLSegmentReadString(&reader);
+      if (reader.overrun || !txnId || !txnsById[txnId]) {
+        break;
+      }
+      NSDate *logTimestamp = [NSDate dateWithTimeIntervalSince1970:timestamp];
+      TLTransactionLog *txnLog = [[TLTransactionLog alloc] initWithUsecaseEvent:usecaseEvent
+                                                               inContextErrCode:errCode
+                                                        inContextErrDescription:errDesc
+                                                                      timestamp:logTimestamp];
+      NSMutableArray *txnLogs = txnLogsById[txnId];
+      if (!txnLogs) {
+        txnLogs = [NSMutableArray array];
+        txnLogsById[txnId] = txnLogs;
+        [transactions addObject:txnsById[txnId]];
+      }
+      [txnLogs addObject:txnLog];
+      numSegmentLogs++;
+      if (!oldestSegmentLogTimestamp || [logTimestamp compare:oldestSegmentLogTimestamp] == NSOrderedAscending) {
+        oldestSegmentLogTimestamp = logTimestamp;
+      }
+    } else {
+      break;
+    }
+  }
+  for (TLTransaction *txn in transactions) {
+    [txn setLogs:txnLogsById[[txn localId]]];
+  }
+  *numLogs = numSegmentLogs;
+  *oldestLogTimestamp = oldestSegmentLogTimestamp;
+  return transactions;
+}
+
+#pragma mark - TLEventStore
+
+- (BOOL)appendLogs:(NSArray *)txnLogs
+    forTransaction:(TLTransaction *)txn
+             error:(TLDaoErrorBlk)errorBlk {
+  if ([txnLogs count] == 0) {
+    return YES;
+  }
+  @synchronized(self) {
+    NSData *frames = _hasActiveSegment ? [self framesForLogs:txnLogs ofTransaction:txn] : nil;
+    if (!frames || _activeSegmentLength + [frames length] > _activeSegmentCapacity) {
+      // rotate (the transaction's header frame is re-written to the new segment)
+      [self sealActiveSegment];
+      frames = [self framesForLogs:txnLogs ofTransaction:txn];
+      if (![self openActiveSegmentWithCapacity:MAX(_segmentSize, [frames length]) error:errorBlk]) {
+        return NO;
+      }
+    }
+    memcpy(_activeSegmentMap + _activeSegmentLength, [frames bytes], [frames length]);
+    _activeSegmentLength += [frames length];
+    if (!_txnIdsInActiveSegment[[txn guidBytes]]) {
+      _txnIdsInActiveSegment[[txn guidBytes]] = @([_txnIdsInActiveSegment count] + 1);
+    }
+    _activeSegmentNumLogs += [txnLogs count];
+    for (TLTransactionLog *txnLog in txnLogs) {
+      if (!_activeSegmentOldestLogTimestamp ||
+          [[txnLog timestamp] compare:_activeSegmentOldestLogTimestamp] == NSOrderedAscending) {
+        _activeSegmentOldestLogTimestamp = [txnLog timestamp];
+      }
+    }
+  }
+  return YES;
+}
+
+- (TLEventStoreBatch *)leaseNextBatchWithError:(TLDaoErrorBlk)errorBlk {
+  @synchronized(self) {
+    // logs in the active segment are leased along with the rest
+    if (_hasActiveSegment && _activeSegmentLength > 0) {
+      [self sealActiveSegment];
+    }
+    for (NSNumber *segmentSeq in [_sealedSegmentSeqs copy]) {
+      if ([_leasedSegmentSeqs containsObject:segmentSeq]) {
+        continue;
+      }
+      NSUInteger numLogs = 0;
+      NSDate *oldestLogTimestamp = nil;
+      NSArray *transactions = [self readSegment:[segmentSeq unsignedLongLongValue]
+                                        numLogs:&numLogs
+                             oldestLogTimestamp:&oldestLogTimestamp];
+      if ([transactions count] == 0) {
+        // nothing intact to send
+        [self removeSegment:[segmentSeq unsignedLongLongValue]];
+        continue;
+      }
+      TLEventStoreBatch *batch = [[TLEventStoreBatch alloc] init];
+      [batch setIdempotencyKey:[NSString stringWithFormat:@"%@-%@", _storeId, segmentSeq]];
+      [batch setTransactions:transactions];
+      [batch setNumLogs:numLogs];
+      [batch setStoreRef:segmentSeq];
+      [_leasedSegmentSeqs addObject:segmentSeq];
+      return batch;
+    }
+  }
+  return nil;
+}
+
+- (void)acknowledgeBatch:(TLEventStoreBatch *)batch
+                   error:(TLDaoErrorBlk)errorBlk {
+  @synchronized(self) {
+    [self removeSegment:[[batch storeRef] unsignedLongLongValue]];
+  }
+}
+
+- (void)releaseBatch:(TLEventStoreBatch *)batch {
+  @synchronized(self) {
+    [_leasedSegmentSeqs removeObject:[batch storeRef]];
+  }
+}
+
+- (void)backlogNumLogs:(NSUInteger *)numLogs
+    oldestLogTimestamp:(NSDate **)oldestLogTimestamp
+                 error:(TLDaoErrorBlk)errorBlk {
+  @synchronized(self) {
+    NSUInteger numStoredLogs = _hasActiveSegment ? _activeSegmentNumLogs : 0;
+    NSDate *oldestStoredLogTimestamp = _hasActiveSegment ? _activeSegmentOldestLogTimestamp : nil;
+    for (NSNumber *segmentSeq in _sealedSegmentSeqs) {
+      numStoredLogs += [_numLogsBySegmentSeq[segmentSeq] unsignedIntegerValue];
+      NSDate *segmentOldestLogTimestamp = _oldestLogTimestampBySegmentSeq[segmentSeq];
+      if (segmentOldestLogTimestamp &&
+          (!oldestStoredLogTimestamp ||
+           [segmentOldestLogTimestamp compare:oldestStoredLogTimestamp] == NSOrderedAscending)) {
+        oldestStoredLogTimestamp = segmentOldestLogTimestamp;
+      }
+    }
+    *numLogs = numStoredLogs;
+    *oldestLogTimestamp = oldestStoredLogTimestamp;
+  }
+}
+
+- (void)removeAllWithError:(TLDaoErrorBlk)errorBlk {
+  @synchronized(self) {
+    [self sealActiveSegment];
+    for (NSNumber *segmentSeq in [_sealedSegmentSeqs copy]) {
+      [self removeSegment:[segmentSeq unsignedLongLongValue]];
+    }
+  }
+}
+
+@end
@@ -0,0 +1,46 @@
+//
+//  TLStoreEpoch.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+
+/**
+ * A generation counter for the rows of a local transaction store.  The counter
+ * is advanced whenever transaction rows are deleted (e.g., by a flush), so a
+ * transaction known to be persisted at the current epoch is known to still be
+ * persisted, without having to query for it.
+ *
+ * An epoch is advanced on the queue of the database it describes, but may be
+ * read from any thread; both are atomic.
+ */
+@interface TLStoreEpoch : NSObject
+
+/**
+ * Advances the epoch; to be invoked in the same database transaction that
+ * deletes transaction rows.
+ */
+- (void)advance;
+
+/** The current epoch; starts at 1 (0 stands for no epoch). */
+@property (nonatomic, readonly) uint64_t value;
+
+@end
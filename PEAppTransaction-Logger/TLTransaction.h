@@ -26,6 +26,12 @@
 #import "TLTransactionLog.h"
 #import "TLTypedefs.h"
 
+@class TLWriteBehindBuffer;
+@class TLStoreEpoch;
+@class TLMetrics;
+@class TLTransactionSpan;
+@class TLRollupAggregator;
+
 /**
  An abstraction for a transaction from with transaction logs can be created.
  */
@@ -55,6 +61,58 @@ transaction represents.
 userAgentDeviceOSVersion:(NSString *)userAgentDeviceOSVersion
         databaseQueue:(FMDatabaseQueue *)databaseQueue;
 
+/**
+ Initializes a new instance whose logs are recorded through the given
+ write-behind buffer while that buffer is enabled.
+ @param usecase Integer value representing the business use case this
+transaction represents.
+ @param localId A unique identifier for the transaction (for local storage).
+ @param guid A public, global identifier for this transaction.
+ @param userAgentDeviceMake The device make/model to be associated with the
+ transaction.
+ @param userAgentDeviceOS The device operating system name to be associated with
+ the transaction.
+ @param userAgentDeviceOSVersion The device operating system version to be
+ associated with the transaction.
+ @param databaseQueue Queue used to write logs when not buffering.
+ @param writeBehindBuffer Buffer used to record logs (may be nil).
+ @return The initialized instance.
+ */
+- (id)initWithUsecase:(NSNumber *)usecase
+              localId:(NSNumber *)localId
+                 guid:(NSString *)transactionId
+  userAgentDeviceMake:(NSString *)userAgentDeviceMake
+    userAgentDeviceOS:(NSString *)userAgentDeviceOS
+userAgentDeviceOSVersion:(NSString *)userAgentDeviceOSVersion
+        databaseQueue:(FMDatabaseQueue *)databaseQueue
+    writeBehindBuffer:(TLWriteBehindBuffer *)writeBehindBuffer;
+
+#pragma mark - Identifiers
+
+/**
+ @return A new globally unique identifier for a transaction of the given use
+ case, in its textual form.
+ */
++ (NSString *)guidForUsecase:(NSNumber *)usecase;
+
+/**
+ @return A new globally unique identifier for a transaction, in its stored
+ form: the 16 bytes of a random UUID.
+ */
++ (NSData *)newGuidBytes;
+
+/**
+ @return The textual form (TXN<use case>-<UUID>) of the given stored GUID of a
+ transaction of the given use case; nil if guidBytes is not 16 bytes long.
+ */
++ (NSString *)guidForUsecase:(NSNumber *)usecase guidBytes:(NSData *)guidBytes;
+
+/**
+ @return The stored form of the given textual GUID; nil if it does not end in a
+ UUID.
+ */
++ (NSData *)guidBytesOfGuid:(NSString *)guid;
+
 #pragma mark - Event Logging
 
 /**
@@ -79,14 +137,69 @@ userAgentDeviceOSVersion:(NSString *)userAgentDeviceOSVersion
     inContextErrDescription:(NSString *)inContextLocalizedErrDesc
                       error:(TLDaoErrorBlk)errorBlk;
 
+#pragma mark - Bulk Event Logging
+
+/**
+ Logs the given transaction log items, all in a single write to the local
+ database (or a single append to the write-behind buffer).  Use this to record
+ many events at once, e.g., the steps of a multi-step flow.
+ @param txnLogs The TLTransactionLog instances to log (timestamped by the
+ caller).
+ @param errorBlk Error block used in case of failed local database interaction.
+ */
+- (void)logTransactionLogs:(NSArray *)txnLogs
+                     error:(TLDaoErrorBlk)errorBlk;
+
+/**
+ Logs the given transaction log items of the given transactions, all in a
+ single write to the given database queue (or a single append per transaction
+ to the given write-behind buffer, if enabled).  Intended for use by
+ TLTransactionManager.
+ @param txnLogArrays Arrays of TLTransactionLog instances, one per transaction.
+ @param transactions The transactions txnLogArrays belong to (in the same
+ order).
+ @param databaseQueue Queue used to write the logs when not buffering.
+ @param writeBehindBuffer Buffer used to record the logs (may be nil).
+ @param metrics The metrics into which the logging is recorded (may be nil).
+ @param errorBlk Error block used in case of failed local database interaction.
+ */
++ (void)logTransactionLogs:(NSArray *)txnLogArrays
+           forTransactions:(NSArray *)transactions
+             databaseQueue:(FMDatabaseQueue *)databaseQueue
+         writeBehindBuffer:(TLWriteBehindBuffer *)writeBehindBuffer
+                   metrics:(TLMetrics *)metrics
+                     error:(TLDaoErrorBlk)errorBlk;
+
+/**
+ Runs the given block with a new span of this transaction, then commits the
+ events the block collected in it (see TLTransactionSpan).
+ @param block The block to run; it may hand the span on to code that completes
+ later, and commit it again from there.
+ @param errorBlk Error block used in case of failed local database interaction.
+ */
+- (void)spanWithBlock:(void (^)(TLTransactionSpan *span))block
+                error:(TLDaoErrorBlk)errorBlk;
+
 #pragma mark - Properties
 
 /** Local identifier used for locally storing this transaction. */
 @property (nonatomic) NSNumber *localId;
 
-/** The globally unique transaction identifier. */
+/**
+ The globally unique transaction identifier, in its textual form.  Unless set
+ explicitly, it is rendered (on each read) from guidBytes and the use case, so
+ it is best read only when serializing.  Setting it sets guidBytes too (to new
+ bytes if it does not end in a UUID).
+ */
 @property (nonatomic) NSString *guid;
 
+/**
+ The globally unique transaction identifier, in its stored form (16 bytes); nil
+ if the transaction is not recorded.  Setting it clears any explicitly set
+ guid.
+ */
+@property (nonatomic) NSData *guidBytes;
+
 /** The transaction type (e.g., use case). */
 @property (nonatomic) NSNumber *usecase;
 
@@ -99,6 +212,59 @@ userAgentDeviceOSVersion:(NSString *)userAgentDeviceOSVersion
 /** The user agent device OS version to associate with this transaction. */
 @property (nonatomic) NSString *userAgentDeviceOSVersion;
 
+/**
+ Local identifier of the stored user agent row matching this transaction's
+ user agent fields; resolved (and cached here) when the transaction is first
+ inserted if not already set.
+ */
+@property (nonatomic) NSNumber *userAgentLocalId;
+
+/**
+ The epoch of the local store this transaction is persisted in; set by the
+ transaction manager.  May be nil, in which case the transaction's row is
+ looked up each time it needs to be known to exist.
+ */
+@property (nonatomic) TLStoreEpoch *storeEpoch;
+
+/**
+ The metrics into which this transaction's logging is recorded; set by the
+ transaction manager.  May be nil.
+ */
+@property (nonatomic) TLMetrics *metrics;
+
+/**
+ The aggregator this transaction's events are counted into, if its use case is
+ rolled up (see TLLoggingPolicy); set by the transaction manager.  Such a
+ transaction is not recorded: its events are only counted.
+ */
+@property (nonatomic) TLRollupAggregator *rollupAggregator;
+
+/**
+ The store epoch at which this transaction was last known to be persisted (0
+ if never).
+ */
+@property (nonatomic) uint64_t persistedEpoch;
+
+/**
+ Whether this transaction is being recorded.  The logs of a transaction that is
+ not recorded (see TLLoggingPolicy) are dropped, unless recordsOnError is YES
+ and an error is logged, in which case the transaction is given a GUID and
+ recorded (with a sample rate of 1) from that log on.  Defaults to YES.
+ */
+@property (nonatomic, getter=isRecorded) BOOL recorded;
+
+/**
+ Whether this transaction, if not recorded, starts being recorded when an error
+ is logged.
+ */
+@property (nonatomic) BOOL recordsOnError;
+
+/**
+ The sample rate at which this transaction was recorded (see TLLoggingPolicy).
+ Defaults to 1.
+ */
+@property (nonatomic) double sampleRate;
+
 /** The set of transaction log instances associated with this transaction instance. */
 @property (nonatomic) NSArray *logs;
 
@@ -25,9 +25,16 @@
 #import <FMDB/FMDatabase.h>
 #import "TLDDLUtils.h"
 #import "TLDBUtils.h"
+#import "TLWriteBehindBuffer.h"
+#import "TLMetrics.h"
+#import "TLTransactionSpan.h"
+#import "TLRollupAggregator.h"
+#import <uuid/uuid.h>
 
 @implementation TLTransaction {
   FMDatabaseQueue *_databaseQueue;
+  TLWriteBehindBuffer *_writeBehindBuffer;
+  NSDate *_lastRolledUpEventTimestamp;
 }
 
 #pragma mark - Initializers
@@ -39,19 +46,98 @@
     userAgentDeviceOS:(NSString *)userAgentDeviceOS
 userAgentDeviceOSVersion:(NSString *)userAgentDeviceOSVersion
         databaseQueue:(FMDatabaseQueue *)databaseQueue {
+  return [self initWithUsecase:usecase
+                       localId:localId
+                          guid:guid
+           userAgentDeviceMake:userAgentDeviceMake
+             userAgentDeviceOS:userAgentDeviceOS
+      userAgentDeviceOSVersion:userAgentDeviceOSVersion
+                 databaseQueue:databaseQueue
+             writeBehindBuffer:nil];
+}
+
+- (id)initWithUsecase:(NSNumber *)usecase
+              localId:(NSNumber *)localId
+                 guid:(NSString *)guid
+  userAgentDeviceMake:(NSString *)userAgentDeviceMake
+    userAgentDeviceOS:(NSString *)userAgentDeviceOS
+userAgentDeviceOSVersion:(NSString *)userAgentDeviceOSVersion
+        databaseQueue:(FMDatabaseQueue *)databaseQueue
+    writeBehindBuffer:(TLWriteBehindBuffer *)writeBehindBuffer {
   self = [super init];
   if (self) {
     _usecase = usecase;
     _localId = localId;
-    _guid = guid;
+    [self setGuid:guid];
     _userAgentDeviceMake = userAgentDeviceMake;
     _userAgentDeviceOS = userAgentDeviceOS;
     _userAgentDeviceOSVersion = userAgentDeviceOSVersion;
     _databaseQueue = databaseQueue;
+    _writeBehindBuffer = writeBehindBuffer;
+    _recorded = YES;
+    _sampleRate = 1.0;
   }
   return self;
 }
 
+#pragma mark - Identifiers
+
++ (NSString *)guidForUsecase:(NSNumber *)usecase {
+  return [TLTransaction guidForUsecase:usecase guidBytes:[TLTransaction newGuidBytes]];
+}
+
++ (NSData *)newGuidBytes {
+  uuid_t uuid;
+  uuid_generate_random(uuid);
+  return [NSData dataWithBytes:uuid length:sizeof(uuid)];
+}
+
++ (NSString *)guidForUsecase:(NSNumber *)usecase guidBytes:(NSData *)guidBytes {
+  if ([guidBytes length] != sizeof(uuid_t)) {
+    return nil;
+  }
+  // "TXN" + up to 20 digits + "-" + 36 UUID characters (+ the terminator)
+  char guid[64];
+  int prefixLength = snprintf(guid, 25, "TXN%lld-", [usecase longLongValue]);
+  uuid_unparse_upper([guidBytes bytes], guid + prefixLength);
+  return [[NSString alloc] initWithBytes:guid
+                                  length:prefixLength + 36
+                                encoding:NSASCIIStringEncoding];
+}
+
++ (NSData *)guidBytesOfGuid:(NSString *)guid {
+  if ([guid length] < 36) {
+    return nil;
+  }
+  NSUUID *uuid = [[NSUUID alloc] initWithUUIDString:[guid substringFromIndex:[guid length] - 36]];
+  if (!uuid) {
+    return nil;
+  }
+  uuid_t bytes;
+  [uuid getUUIDBytes:bytes];
+  return [NSData dataWithBytes:bytes length:sizeof(bytes)];
+}
+
+- (NSString *)guid {
+  return _guid ? _guid : [TLTransaction guidForUsecase:_usecase guidBytes:_guidBytes];
+}
+
+- (void)setGuid:(NSString *)guid {
+  _guid = guid;
+  if (guid) {
+    // (a GUID not of the generated form keeps its text, with new bytes)
+    NSData *guidBytes = [TLTransaction guidBytesOfGuid:guid];
+    _guidBytes = guidBytes ? guidBytes : [TLTransaction newGuidBytes];
+  } else {
+    _guidBytes = nil;
+  }
+}
+
+- (void)setGuidBytes:(NSData *)guidBytes {
+  _guidBytes = guidBytes;
+  _guid = nil;
+}
+
 #pragma mark - Event Logging
 
 - (void)logWithUsecaseEvent:(NSNumber *)usecaseEvent
@@ -66,40 +152,166 @@ userAgentDeviceOSVersion:(NSString *)userAgentDeviceOSVersion
            inContextErrCode:(NSNumber *)inContextErrCode
     inContextErrDescription:(NSString *)inContextLocalizedErrDesc
                       error:(TLDaoErrorBlk)errorBlk {
-  NSString *stmt = [NSString stringWithFormat:@"INSERT INTO %@(%@, %@, %@, %@, %@) \
-                    VALUES(?, ?, ?, ?, ?)",
-                    TBL_TXN_LOG,
-                    COL_TXNLOG_PARENT_TXN_ID,
-                    COL_TXNLOG_TIMESTAMP,
-                    COL_TXNLOG_USECASE_EVENT,
-                    COL_TXNLOG_IN_CTX_ERR_CODE,
-                    COL_TXNLOG_IN_CTX_ERR_DESC];
+  TLMetrics *metrics = _metrics;
+  uint64_t startTime = TLLatencyClockNow();
+  if (_rollupAggregator) {
+    [self rollUpUsecaseEvent:usecaseEvent inContextErrCode:inContextErrCode timestamp:[NSDate date]];
+    [metrics addEventsLogged:1];
+    [[metrics eventLoggingLatency] recordDurationSince:startTime];
+    return;
+  }
+  if (!_recorded) {
+    if (!(_recordsOnError && inContextErrCode)) {
+      [[metrics eventLoggingLatency] recordDurationSince:startTime];
+      return;
+    }
+    [self startRecording];
+  }
+  TLTransactionLog *txnLog =
+    [[TLTransactionLog alloc] initWithUsecaseEvent:usecaseEvent
+                                  inContextErrCode:inContextErrCode
+                           inContextErrDescription:inContextLocalizedErrDesc];
+  if ([_writeBehindBuffer isEnabled]) {
+    [_writeBehindBuffer appendLog:txnLog forTransaction:self error:errorBlk];
+    [[metrics eventLoggingLatency] recordDurationSince:startTime];
+    return;
+  }
+  uint64_t enqueueTime = TLLatencyClockNow();
   [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
-    NSNumber *actualTxnLocalId =
-      [TLDBUtils numberFromTable:TBL_TXN
-                    selectColumn:COL_TXN_ID
-                     whereColumn:COL_TXN_GUID
-                      whereValue:_guid
-                              db:db
-                           error:errorBlk];
-    if (!actualTxnLocalId) {
-      // The transaction is not in the database (it must have been synced/pruned).  So
-      // we have to re-insert it.
-      [TLDBUtils insertTransaction:self db:db error:errorBlk];
+    [[metrics databaseQueueWaitLatency] recordDurationSince:enqueueTime];
+    [TLDBUtils insertTransactionIfAbsent:self db:db error:errorBlk];
+    if ([TLDBUtils insertTransactionLog:txnLog forTransaction:self db:db error:errorBlk]) {
+      [metrics addEventsLogged:1];
+    } else {
+      [metrics addEventsFailed:1];
+    }
+  }];
+  [[metrics eventLoggingLatency] recordDurationSince:startTime];
+}
+
+- (void)rollUpUsecaseEvent:(NSNumber *)usecaseEvent
+           inContextErrCode:(NSNumber *)inContextErrCode
+                  timestamp:(NSDate *)timestamp {
+  NSTimeInterval sincePreviousEvent = -1;
+  @synchronized(self) {
+    if (_lastRolledUpEventTimestamp) {
+      sincePreviousEvent = MAX([timestamp timeIntervalSinceDate:_lastRolledUpEventTimestamp], 0);
+    }
+    _lastRolledUpEventTimestamp = timestamp;
+  }
+  [_rollupAggregator addEventWithUsecase:_usecase
+                            usecaseEvent:usecaseEvent
+                        inContextErrCode:inContextErrCode
+                               timestamp:timestamp
+                      sincePreviousEvent:sincePreviousEvent];
+}
+
+- (void)startRecording {
+  // From here on, this transaction is recorded (its row is inserted along
+  // with the log that triggered the recording).
+  [self setGuidBytes:[TLTransaction newGuidBytes]];
+  _sampleRate = 1.0;
+  _recorded = YES;
+}
+
+#pragma mark - Bulk Event Logging
+
+- (void)logTransactionLogs:(NSArray *)txnLogs
+                     error:(TLDaoErrorBlk)errorBlk {
+  [TLTransaction logTransactionLogs:@[txnLogs]
+                    forTransactions:@[self]
+                      databaseQueue:_databaseQueue
+                  writeBehindBuffer:_writeBehindBuffer
+                            metrics:_metrics
+                              error:errorBlk];
+}
+
++ (void)logTransactionLogs:(NSArray *)txnLogArrays
+           forTransactions:(NSArray *)transactions
+             databaseQueue:(FMDatabaseQueue *)databaseQueue
+         writeBehindBuffer:(TLWriteBehindBuffer *)writeBehindBuffer
+                   metrics:(TLMetrics *)metrics
+                     error:(TLDaoErrorBlk)errorBlk {
+  uint64_t startTime = TLLatencyClockNow();
+  NSMutableArray *recordedTxns = [NSMutableArray arrayWithCapacity:[transactions count]];
+  NSMutableArray *recordedLogArrays = [NSMutableArray arrayWithCapacity:[transactions count]];
+  __block NSUInteger numRolledUp = 0;
+  [transactions enumerateObjectsUsingBlock:^(TLTransaction *txn, NSUInteger idx, BOOL *stop) {
+    if ([txn rollupAggregator]) {
+      for (TLTransactionLog *txnLog in txnLogArrays[idx]) {
+        [txn rollUpUsecaseEvent:[txnLog usecaseEvent]
+               inContextErrCode:[txnLog inContextErrCode]
+                      timestamp:[txnLog timestamp]];
+      }
+      numRolledUp += [txnLogArrays[idx] count];
+      return;
+    }
+    NSArray *recordedLogs = [txn recordedLogsOfLogs:txnLogArrays[idx]];
+    if ([recordedLogs count] > 0) {
+      [recordedTxns addObject:txn];
+      [recordedLogArrays addObject:recordedLogs];
+    }
+  }];
+  if (numRolledUp > 0) {
+    [metrics addEventsLogged:numRolledUp];
+  }
+  if ([recordedTxns count] == 0) {
+    [[metrics eventLoggingLatency] recordDurationSince:startTime];
+    return;
+  }
+  if ([writeBehindBuffer isEnabled]) {
+    [recordedTxns enumerateObjectsUsingBlock:^(TLTransaction *txn, NSUInteger idx, BOOL *stop) {
+      [writeBehindBuffer appendLogs:recordedLogArrays[idx] forTransaction:txn error:errorBlk];
+    }];
+    [[metrics eventLoggingLatency] recordDurationSince:startTime];
+    return;
+  }
+  uint64_t enqueueTime = TLLatencyClockNow();
+  [databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+    [[metrics databaseQueueWaitLatency] recordDurationSince:enqueueTime];
+    NSUInteger numLogged = 0;
+    NSUInteger numFailed = 0;
+    // one parent lookup per transaction, however many logs it has
+    for (NSUInteger i = 0; i < [recordedTxns count]; i++) {
+      TLTransaction *txn = recordedTxns[i];
+      [TLDBUtils insertTransactionIfAbsent:txn db:db error:errorBlk];
+      for (TLTransactionLog *txnLog in recordedLogArrays[i]) {
+        if ([TLDBUtils insertTransactionLog:txnLog forTransaction:txn db:db error:errorBlk]) {
+          numLogged++;
+        } else {
+          numFailed++;
+        }
+      }
     }
-    NSArray *args = @[[self localId],
-                      [NSDate date],
-                      usecaseEvent,
-                      inContextErrCode ? inContextErrCode : [NSNull null],
-                      inContextLocalizedErrDesc ? inContextLocalizedErrDesc : [NSNull null]];
-    [TLDBUtils doInsert:stmt
-              argsArray:args
-                 entity:nil
-             idAssigner:nil
-                     db:db
-                  error:errorBlk];
+    [metrics addEventsLogged:numLogged];
+    [metrics addEventsFailed:numFailed];
   }];
+  [[metrics eventLoggingLatency] recordDurationSince:startTime];
+}
+
+- (void)spanWithBlock:(void (^)(TLTransactionSpan *span))block
+                error:(TLDaoErrorBlk)errorBlk {
+  TLTransactionSpan *span = [[TLTransactionSpan alloc] initWithTransaction:self];
+  block(span);
+  [span commitWithError:errorBlk];
+}
 
+- (NSArray *)recordedLogsOfLogs:(NSArray *)txnLogs {
+  // An unrecorded transaction drops its logs, unless it records on error, in
+  // which case it starts recording at the first log of an error.
+  if (_recorded) {
+    return txnLogs;
+  }
+  if (_recordsOnError) {
+    NSUInteger errLogIdx = [txnLogs indexOfObjectPassingTest:^BOOL(TLTransactionLog *txnLog, NSUInteger idx, BOOL *stop) {
+      return [txnLog inContextErrCode] != nil;
+    }];
+    if (errLogIdx != NSNotFound) {
+      [self startRecording];
+      return [txnLogs subarrayWithRange:NSMakeRange(errLogIdx, [txnLogs count] - errLogIdx)];
+    }
+  }
+  return @[];
 }
 
 @end
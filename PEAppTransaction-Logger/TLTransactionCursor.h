@@ -0,0 +1,74 @@
+//
+//  TLTransactionCursor.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+
+@class TLTransaction;
+
+/**
+ * Fetches the next chunk of transactions (in id order) after the given
+ * transaction id, with at most the given number of transactions.
+ */
+typedef NSArray *(^TLTransactionChunkFetchBlk)(long long afterTxnId, NSUInteger limit);
+
+/**
+ * A forward-only cursor over transactions of the local store (see
+ * TLTransactionManager's transactionCursorWithFilter:chunkSize:error:).  The
+ * cursor holds at most one chunk of transactions in memory, and no database
+ * connection between chunks; so transactions inserted before the cursor
+ * reaches its end (which have greater ids) are included, and transactions
+ * deleted before their chunk is fetched are not.  A cursor is not thread-safe.
+ */
+@interface TLTransactionCursor : NSObject
+
+#pragma mark - Initializers
+
+/**
+ * Initializes a new instance, positioned before the first transaction.
+ * @param chunkSize The number of transactions fetched at a time.
+ * @param fetchBlk  Block fetching each chunk.
+ * @return The initialized instance.
+ */
+- (id)initWithChunkSize:(NSUInteger)chunkSize
+               fetchBlk:(TLTransactionChunkFetchBlk)fetchBlk;
+
+#pragma mark - Reading
+
+/**
+ * @return The next transaction (with its logs), or nil if there are no more.
+ */
+- (TLTransaction *)nextTransaction;
+
+/**
+ * @return The (up to chunkSize) next transactions, or an empty array if there
+ * are no more.
+ */
+- (NSArray *)nextChunk;
+
+#pragma mark - Properties
+
+/** The number of transactions fetched at a time. */
+@property (nonatomic, readonly) NSUInteger chunkSize;
+
+@end
@@ -0,0 +1,93 @@
+//
+//  TLTransactionCursor.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTransactionCursor.h"
+#import "TLTransaction.h"
+
+@implementation TLTransactionCursor {
+  TLTransactionChunkFetchBlk _fetchBlk;
+  NSArray *_chunk;
+  NSUInteger _chunkIndex;
+  long long _lastTxnId;
+  BOOL _exhausted;
+}
+
+#pragma mark - Initializers
+
+- (id)initWithChunkSize:(NSUInteger)chunkSize
+               fetchBlk:(TLTransactionChunkFetchBlk)fetchBlk {
+  self = [super init];
+  if (self) {
+    _chunkSize = chunkSize > 0 ? chunkSize : 1;
+    _fetchBlk = fetchBlk;
+    _chunk = @[];
+    _chunkIndex = 0;
+    _lastTxnId = 0;
+    _exhausted = NO;
+  }
+  return self;
+}
+
+#pragma mark - Reading
+
+- (TLTransaction *)nextTransaction {
+  if (_chunkIndex >= [_chunk count]) {
+    _chunk = [self fetchChunk];
+    _chunkIndex = 0;
+    if ([_chunk count] == 0) {
+      return nil;
+    }
+  }
+  return _chunk[_chunkIndex++];
+}
+
+- (NSArray *)nextChunk {
+  NSArray *chunk;
+  if (_chunkIndex < [_chunk count]) {
+    // the rest of a chunk partly read with nextTransaction
+    chunk = [_chunk subarrayWithRange:NSMakeRange(_chunkIndex, [_chunk count] - _chunkIndex)];
+  } else {
+    chunk = [self fetchChunk];
+  }
+  _chunk = @[];
+  _chunkIndex = 0;
+  return chunk;
+}
+
+- (NSArray *)fetchChunk {
+  if (_exhausted) {
+    return @[];
+  }
+  // keyset pagination: each chunk starts after the last transaction read
+  NSArray *chunk = _fetchBlk(_lastTxnId, _chunkSize);
+  if ([chunk count] < _chunkSize) {
+    _exhausted = YES;
+  }
+  if ([chunk count] > 0) {
+    _lastTxnId = [[[chunk lastObject] localId] longLongValue];
+  }
+  return chunk;
+}
+
+@end
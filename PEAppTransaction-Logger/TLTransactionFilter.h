@@ -0,0 +1,53 @@
+//
+//  TLTransactionFilter.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "TLTypedefs.h"
+
+/**
+ * Criteria on the transactions of the local store, for enumerating and
+ * aggregating them (see TLTransactionManager).  The criteria are evaluated by
+ * the local database.  A new filter matches all transactions.
+ */
+@interface TLTransactionFilter : NSObject
+
+/** The use cases (NSNumber instances) to match; nil for any use case. */
+@property (nonatomic, copy) NSArray *usecases;
+
+/**
+ * The start (inclusive) of the time range a transaction must have a log in;
+ * nil for no start.
+ */
+@property (nonatomic) NSDate *fromDate;
+
+/**
+ * The end (exclusive) of the time range a transaction must have a log in; nil
+ * for no end.
+ */
+@property (nonatomic) NSDate *toDate;
+
+/** Whether to match transactions with errors.  Defaults to TLTransactionErrorFilterAny. */
+@property (nonatomic) TLTransactionErrorFilter errorFilter;
+
+@end
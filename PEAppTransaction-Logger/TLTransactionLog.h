@@ -43,6 +43,21 @@
           inContextErrCode:(NSNumber *)inContextErrCode
    inContextErrDescription:(NSString *)inContextLocalizedErrDesc;
 
+/**
+ Initializes a new instance with the given timestamp (e.g., for recording
+ events after the fact; see TLTransaction's logTransactionLogs:error:).
+ @param usecaseEvent The use case event to associate with this transaction log item.
+ @param inContextErrCode The error code to associate with this transaction log
+ item (optional; may be nil).
+ @param inContextLocalizedErrDesc The error description to associate with this
+ transaction log item (optional; may be nil).
+ @param timestamp When the event occurred (nil for now).
+ */
+- (id)initWithUsecaseEvent:(NSNumber *)usecaseEvent
+          inContextErrCode:(NSNumber *)inContextErrCode
+   inContextErrDescription:(NSString *)inContextLocalizedErrDesc
+                 timestamp:(NSDate *)timestamp;
+
 #pragma mark - Properties
 
 /** The creation date timestamp for this transaction log item. */
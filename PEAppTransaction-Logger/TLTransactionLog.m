@@ -31,12 +31,22 @@
 - (id)initWithUsecaseEvent:(NSNumber *)usecaseEvent
           inContextErrCode:(NSNumber *)inContextErrCode
    inContextErrDescription:(NSString *)inContextLocalizedErrDesc {
+  return [self initWithUsecaseEvent:usecaseEvent
+                   inContextErrCode:inContextErrCode
+            inContextErrDescription:inContextLocalizedErrDesc
+                          timestamp:nil];
+}
+
+- (id)initWithUsecaseEvent:(NSNumber *)usecaseEvent
+          inContextErrCode:(NSNumber *)inContextErrCode
+   inContextErrDescription:(NSString *)inContextLocalizedErrDesc
+                 timestamp:(NSDate *)timestamp {
   self = [super init];
   if (self) {
     _usecaseEvent = usecaseEvent;
     _inContextErrCode = inContextErrCode;
     _inContextLocalizedErrDesc = inContextLocalizedErrDesc;
-    _timestamp = [NSDate date];
+    _timestamp = timestamp ? timestamp : [NSDate date];
   }
   return self;
 }
@@ -25,7 +25,14 @@
 #import <PEHateoas-Client/HCRelationExecutor.h>
 #import <PEHateoas-Client/HCResource.h>
 #import "TLTransaction.h"
+#import "TLWriteBehindBuffer.h"
+#import "TLLoggingPolicy.h"
+#import "TLFlushScheduler.h"
+#import "TLMetrics.h"
 #import "TLTypedefs.h"
+#import "TLTransactionFilter.h"
+#import "TLTransactionCursor.h"
+#import "TLRollupAggregator.h"
 
 /**
  * An abstraction for creating and managing the process of logging
@@ -68,21 +75,136 @@ transaction and transaction log instances.
   apptxnMediaSubtypePrefix:(NSString *)apptxnMediaSubtypePrefix
                      error:(TLDaoErrorBlk)errBlk;
 
+/**
+ * Initializes a new instance whose local store is set up (created or migrated)
+ * in the background, so that the initializer returns right away; the
+ * parameters are otherwise those of the initializer above.  Until the store is
+ * ready, new transactions and their logs are held in memory, in the
+ * write-behind buffer (whether or not it is enabled); they are committed as
+ * soon as the store is ready, before readyBlk is invoked.  Methods that read,
+ * delete or flush stored transactions wait for the store to be ready.
+ * @param readyBlk Block invoked (on a background queue) once the local store
+ * is ready.  May be nil.
+ * @return An initialized instance.
+ */
+- (id)initWithDataFilePath:(NSString *)sqliteDataFileUrl
+       userAgentDeviceMake:(NSString *)userAgentDeviceMake
+         userAgentDeviceOS:(NSString *)userAgentDeviceOS
+  userAgentDeviceOSVersion:(NSString *)userAgentDeviceOSVersion
+          relationExecutor:(HCRelationExecutor *)relationExecutor
+                authScheme:(NSString *)authScheme
+        authTokenParamName:(NSString *)authTokenParamName
+        contentTypeCharset:(HCCharset *)contentTypeCharset
+        apptxnResMtVersion:(NSString *)apptxnResMtVersion
+  apptxnMediaSubtypePrefix:(NSString *)apptxnMediaSubtypePrefix
+                  readyBlk:(TLStoreReadyBlk)readyBlk
+                     error:(TLDaoErrorBlk)errBlk;
+
+#pragma mark - Readiness
+
+/**
+ * Blocks until the local store is ready (returns right away unless the
+ * instance was initialized asynchronously).
+ */
+- (void)waitUntilReady;
+
 #pragma mark - Creating new transaction instances
 
 /**
- Creates and returns a new transaction instance with the given type.
+ Creates and returns a new transaction instance with the given type.  If the
+ loggingPolicy does not admit the transaction, it is returned unrecorded (see
+ TLTransaction's recorded property).
  @param usecase An integer representing the transaction use case.
  @return New transaction instance.
  */
 - (TLTransaction *)transactionWithUsecase:(NSNumber *)usecase
                                     error:(TLDaoErrorBlk)errorBlk;
 
+#pragma mark - Write-Behind
+
+/**
+ * Synchronously commits any transactions and transaction logs pending in the
+ * write-behind buffer, and the in-memory rollups, to the local data store.
+ */
+- (void)sync;
+
+#pragma mark - Bulk Event Logging
+
+/**
+ * Logs the given transaction log items of the given transactions (created by
+ * this manager), all in a single write to the local database (or a single
+ * append per transaction to the write-behind buffer).  Use this to record the
+ * events of many transactions at once.
+ * @param txnLogArrays Arrays of TLTransactionLog instances (timestamped by the
+ * caller), one per transaction.
+ * @param transactions The transactions txnLogArrays belong to (in the same
+ * order).
+ * @param errBlk Error block used in case of failed local database interaction.
+ */
+- (void)logTransactionLogs:(NSArray *)txnLogArrays
+           forTransactions:(NSArray *)transactions
+                     error:(TLDaoErrorBlk)errBlk;
+
 #pragma mark - Fetching
 
 /** @return All of the transaction instances from the local data store. */
 - (NSArray *)allTransactionsWithError:(TLDaoErrorBlk)errBlk;
 
+#pragma mark - Enumerating
+
+/**
+ * Opens a cursor over the stored transactions matching the given filter (in
+ * the order they were created), which fetches them (with their logs) chunkSize
+ * at a time.  Transactions pending in the write-behind buffer are committed
+ * first.
+ * @param filter    The filter to apply (nil for all transactions).
+ * @param chunkSize The number of transactions fetched at a time.
+ * @param errBlk    Error block used in case of failed local database interaction.
+ * @return The cursor.
+ */
+- (TLTransactionCursor *)transactionCursorWithFilter:(TLTransactionFilter *)filter
+                                           chunkSize:(NSUInteger)chunkSize
+                                               error:(TLDaoErrorBlk)errBlk;
+
+/**
+ * Invokes the given block with each of the stored transactions matching the
+ * given filter (in the order they were created), without loading more than a
+ * chunk of them at a time.  The block is not invoked on a database queue, so
+ * it may use this manager.
+ * @param filter The filter to apply (nil for all transactions).
+ * @param errBlk Error block used in case of failed local database interaction.
+ * @param block  The block; set its stop parameter to YES to stop enumerating.
+ */
+- (void)enumerateTransactionsWithFilter:(TLTransactionFilter *)filter
+                                  error:(TLDaoErrorBlk)errBlk
+                             usingBlock:(void(^)(TLTransaction *txn, BOOL *stop))block;
+
+#pragma mark - Aggregates
+
+/**
+ * @param filter The filter to apply (nil for all transactions).
+ * @param errBlk Error block used in case of failed local database interaction.
+ * @return The number of stored transactions matching the given filter.
+ */
+- (NSUInteger)numTransactionsWithFilter:(TLTransactionFilter *)filter
+                                  error:(TLDaoErrorBlk)errBlk;
+
+/**
+ * @param filter The filter to apply (nil for all transactions).
+ * @param errBlk Error block used in case of failed local database interaction.
+ * @return The number (NSNumber) of stored transactions matching the given
+ * filter, keyed by use case (NSNumber).
+ */
+- (NSDictionary *)numTransactionsByUsecaseWithFilter:(TLTransactionFilter *)filter
+                                               error:(TLDaoErrorBlk)errBlk;
+
+/**
+ * @param errBlk Error block used in case of failed local database interaction.
+ * @return The timestamp of the oldest stored (i.e., not yet flushed)
+ * transaction log, or nil if there is none.
+ */
+- (NSDate *)oldestPendingLogTimestampWithError:(TLDaoErrorBlk)errBlk;
+
 #pragma mark - Deletion
 
 /** 
@@ -102,7 +224,32 @@ transaction and transaction log instances.
 
 /**
  * Flushes the set of locally stored transaction / transaction log instances to
- * remote data store by way of invoking the web service.
+ * remote data store by way of invoking the web service.  The local database is
+ * only locked while the set of transactions is read, and again while the
+ * acknowledged rows are deleted; it is not locked while the web service call is
+ * in flight, so logging can proceed concurrently with a flush.  Logs recorded
+ * during the flush are retained for the next flush.
+ *
+ * Transactions are POSTed in batches bounded by maxTransactionsPerFlushBatch
+ * and maxFlushBatchPayloadBytes.  Up to maxConcurrentFlushRequests batches are
+ * in flight at once, and the next batch is read and encoded while they are on
+ * the wire.  Each batch is deleted from the local store as soon as it is
+ * acknowledged (and a TLTransactionSetFlushedSuccessfullyNotification is posted
+ * for it); once a batch is not acknowledged, no further batches are started,
+ * and this method returns when the batches already in flight complete.  Batches
+ * may be acknowledged out of order, and an unacknowledged batch is re-sent by a
+ * later flush.
+ *
+ * Each batch is leased in the local store under an idempotency key (sent in
+ * the batch's Idempotency-Key request header) before it is POSTed, and its rows
+ * are only deleted once its acknowledgement is recorded.  A batch whose flush
+ * is cut short (even by the app being killed) is re-sent, with the same rows
+ * and the same key, by the next flush, so the remote store can discard it if it
+ * had already been received.
+ *
+ * Once the transactions are flushed, the rollups of closed windows (see
+ * rollupAggregator) are POSTed, up to maxTransactionsPerFlushBatch of them, as
+ * a transaction set of their own with no transactions.
  * @param unavailBlk Block invoked in case the web service responds with a 
  * 'server unavailable' response (HTTP response code: 503).
  */
@@ -110,8 +257,39 @@ transaction and transaction log instances.
 
 #pragma mark - Timed Asynchronous Flush to Remote Store
 
+/**
+ * Requests a flush of the local store from the flushScheduler (see its
+ * requestFlush).  Intended to be the target of a repeating timer; starting the
+ * flushScheduler instead makes the timer unnecessary.
+ */
 - (void)asynchronousFlushTxnsToRemoteStore:(NSTimer *)timer;
 
+#pragma mark - Storage Quota
+
+/**
+ * Asynchronously evicts transactions from the local store if it exceeds
+ * maxStoredTransactionLogs or maxStoreBytes, until it is back under 90% of the
+ * exceeded limit.  Eviction drops the oldest transactions first, except that
+ * transactions with an error log (a log with an in-context error code) are
+ * only evicted once no others are left.  Eviction proceeds in batches of
+ * evictionBatchSize transactions, each in its own database transaction, so
+ * loggers are never blocked for long.  A TLTransactionsEvictedNotification is
+ * posted for each evicted batch.
+ */
+- (void)enforceStorageQuota;
+
+#pragma mark - Metrics
+
+/**
+ * @return A snapshot of this manager's self-instrumentation: latencies of
+ * transaction creation, event logging, local database queue waits, flush batch
+ * serialization and flush round trips; counts of events logged, flushed,
+ * evicted and failed; and the local store's backlog and data file size.  Taking
+ * a snapshot neither touches the database nor blocks loggers, so it can be
+ * polled (e.g., every second).
+ */
+- (TLMetricsSnapshot *)metricsSnapshot;
+
 #pragma mark - Properties
 
 /**
@@ -123,4 +301,151 @@ transaction and transaction log instances.
 /** The URI of the remote-store web service. */
 @property (nonatomic) NSURL *txnStoreResourceUri;
 
+/**
+ * The maximum number of transactions POSTed per flush batch (0 means no
+ * limit).  Defaults to 500.
+ */
+@property (nonatomic) NSUInteger maxTransactionsPerFlushBatch;
+
+/**
+ * The (approximate) maximum size, in bytes, of the request body of a flush
+ * batch (0 means no limit).  A batch always contains at least 1 transaction.
+ * Defaults to 256 KB.
+ */
+@property (nonatomic) NSUInteger maxFlushBatchPayloadBytes;
+
+/**
+ * The maximum number of flush batches POSTed concurrently.  Defaults to 2.
+ */
+@property (nonatomic) NSUInteger maxConcurrentFlushRequests;
+
+/**
+ * The wire format of flush request bodies.  The media type of the request is
+ * the 'apptxnset' media type with a sub-type suffix matching the format (e.g.,
+ * +json or +msgpack).  Defaults to TLTransactionSetFormatJSON.
+ */
+@property (nonatomic) TLTransactionSetFormat flushPayloadFormat;
+
+/**
+ * Whether or not flush request bodies are gzip-compressed (and sent with a
+ * 'Content-Encoding: gzip' header).  The remote-store web service must support
+ * compressed request bodies.  Defaults to NO.
+ */
+@property (nonatomic) BOOL compressesFlushPayloads;
+
+/**
+ * Flush request bodies smaller than this number of bytes are sent uncompressed,
+ * even if compressesFlushPayloads is YES.  Defaults to 1 KB.
+ */
+@property (nonatomic) NSUInteger minCompressibleFlushPayloadBytes;
+
+/**
+ * The maximum number of transaction logs kept in the local store (0 means no
+ * limit).  See enforceStorageQuota.  Defaults to 10,000.
+ */
+@property (nonatomic) NSUInteger maxStoredTransactionLogs;
+
+/**
+ * The maximum number of bytes of the local data file in use by stored rows (0
+ * means no limit).  See enforceStorageQuota.  Defaults to 0.
+ */
+@property (nonatomic) unsigned long long maxStoreBytes;
+
+/**
+ * The number of transactions evicted per database transaction when enforcing
+ * the storage quota.  Defaults to 100.
+ */
+@property (nonatomic) NSUInteger evictionBatchSize;
+
+/** The number of transactions evicted from the local store by this manager. */
+@property (readonly) NSUInteger evictedTransactionCount;
+
+/**
+ * The number of transaction logs (i.e., events) evicted from the local store by
+ * this manager.
+ */
+@property (readonly) NSUInteger evictedTransactionLogCount;
+
+/**
+ * The policy deciding which new transactions are recorded (nil records all of
+ * them).  The policy can be swapped at any time, from any thread, without
+ * blocking loggers; transactions created before the swap keep the decision made
+ * for them.  Defaults to nil.
+ */
+@property (atomic) TLLoggingPolicy *loggingPolicy;
+
+/**
+ * The scheduler of background flushes of the local store.  The scheduler is
+ * stopped by default; start it to have the local store flushed when its backlog
+ * grows large or old enough, with backoff on failures.  Scheduled flushes are
+ * skipped while no authentication token or remote-store URI is set, and each
+ * is followed by enforcement of the storage quota.
+ */
+@property (nonatomic, readonly) TLFlushScheduler *flushScheduler;
+
+/**
+ * The write-behind buffer used by the transactions created by this manager.
+ * The buffer is disabled by default; enable it to have transaction creation and
+ * event logging return without waiting on the local database.
+ */
+@property (nonatomic, readonly) TLWriteBehindBuffer *writeBehindBuffer;
+
+/**
+ * Block invoked (on a background thread) as each flush batch reaches each of
+ * its steps; returning NO abandons the flush right there, leaving the local
+ * store as it would be had the app been killed at that point.  Intended for
+ * testing the recovery of interrupted flushes.  Defaults to nil.
+ */
+@property (nonatomic, copy) TLFlushBatchStepBlk flushBatchStepBlk;
+
+/**
+ * The tuning of the local SQLite database.  TLDatabaseProfilePerformance
+ * switches the data file to a write-ahead log and opens a second, read-only
+ * connection to it, on which flushes take their snapshots and fetches and
+ * backlog counts run, so that they never hold up logging.  The profile is
+ * applied as it is set, and (re)sets databaseSynchronousMode to the profile's
+ * default.  In-memory databases keep a single connection.  Defaults to
+ * TLDatabaseProfileDefault.
+ */
+@property (nonatomic) TLDatabaseProfile databaseProfile;
+
+/**
+ * How hard SQLite works to make each commit durable; set it after
+ * databaseProfile to trade durability for speed (or vice versa).  Defaults to
+ * TLDatabaseSynchronousModeFull (TLDatabaseSynchronousModeNormal under
+ * TLDatabaseProfilePerformance).
+ */
+@property (nonatomic) TLDatabaseSynchronousMode databaseSynchronousMode;
+
+/**
+ * The size (in KiB) of the page cache of each connection under
+ * TLDatabaseProfilePerformance; read as the profile is applied.  Defaults to
+ * 2048.
+ */
+@property (nonatomic) NSUInteger databaseCacheSizeKiB;
+
+/**
+ * The number of bytes of the data file memory-mapped by each connection under
+ * TLDatabaseProfilePerformance (0 disables memory-mapped I/O); read as the
+ * profile is applied.  Defaults to 64 MiB.
+ */
+@property (nonatomic) unsigned long long databaseMmapSize;
+
+/**
+ * The aggregator the transactions of rolled-up use cases (see TLLoggingPolicy)
+ * are counted into.  Its rollups are moved to the local database (merged with
+ * those already stored for the same use case and window) on sync, when the
+ * app enters the background and at the start of each flush, and sent once
+ * their windows close; stored rollups of closed windows count toward the
+ * backlog that schedules flushes.  Set its
+ * windowDuration to change the length of the windows.
+ */
+@property (nonatomic, readonly) TLRollupAggregator *rollupAggregator;
+
+/**
+ * Whether the local store has been set up (always YES for an instance not
+ * initialized asynchronously).
+ */
+@property (atomic, readonly, getter=isReady) BOOL ready;
+
 @end
@@ -23,6 +23,15 @@
 
 #import "TLTransactionManager.h"
 #import "TLTransactionSetSerializer.h"
+#import "TLTransactionSetWriter.h"
+#import "TLTransactionSetMsgPackWriter.h"
+#import "TLCompressionUtils.h"
+#import "TLStoreEpoch.h"
+#import "TLLoggingPolicy.h"
+#import "TLMetrics.h"
+#import <UIKit/UIKit.h>
+#import <zlib.h>
+#import <stdatomic.h>
 #import <FMDB/FMDatabaseQueue.h>
 #import <FMDB/FMDatabase.h>
 #import <FMDB/FMResultSet.h>
@@ -35,24 +44,55 @@
 #import "TLNotificationNamesAndUserInfoKeys.h"
 #import "TLLogging.h"
 
-uint32_t const TL_REQUIRED_SCHEMA_VERSION = 1;
+uint32_t const TL_REQUIRED_SCHEMA_VERSION = 8;
+
+/** The persisted states of a flush batch (see TLFlushBatchStep). */
+typedef NS_ENUM(NSInteger, TLFlushBatchState) {
+  TLFlushBatchStateLeased = 0,
+  TLFlushBatchStateSent = 1,
+  TLFlushBatchStateAcknowledged = 2
+};
+
+/**
+ * A batch of transactions leased to a flush, and the request body it is sent
+ * as.
+ */
+@interface TLFlushBatch : NSObject
+@property (nonatomic) NSNumber *localId;
+@property (nonatomic) NSString *idempotencyKey;
+@property (nonatomic) long logWatermark;
+@property (nonatomic) TLFlushBatchState state;
+@property (nonatomic) NSArray *transactions;
+@property (nonatomic) NSData *body;
+@end
+
+@implementation TLFlushBatch
+@end
 
 @implementation TLTransactionManager {
   NSString *_sqliteDataFileUrl;
   NSString *_userAgentDeviceMake;
   NSString *_userAgentDeviceOS;
   NSString *_userAgentDeviceOSVersion;
+  NSNumber *_userAgentId;
   HCRelationExecutor *_relationExecutor;
   NSString *_authScheme;
   NSString *_authTokenParamName;
   HCResource *_txnStoreResource;
   FMDatabaseQueue *_databaseQueue;
+  FMDatabaseQueue *_readDatabaseQueue;
+  TLStoreEpoch *_storeEpoch;
+  TLMetrics *_metrics;
   dispatch_queue_t _serialQueue;
+  dispatch_queue_t _committerQueue;
   TLTransactionSetSerializer *_txnSetSerializer;
+  TLTransactionSetSerializer *_msgPackTxnSetSerializer;
   HCRedirectionBlk _redirectionBlk;
   HCClientErrorBlk _clientErrorBlk;
   HCServerErrorBlk _serverErrorBlk;
   HCConnFailureBlk _connectionFailureBlk;
+  atomic_bool _flushLeaseHeld;
+  dispatch_group_t _readyGroup;
 }
 
 #pragma mark - Initializers
@@ -68,12 +108,90 @@ uint32_t const TL_REQUIRED_SCHEMA_VERSION = 1;
         apptxnResMtVersion:(NSString *)apptxnResMtVersion
   apptxnMediaSubtypePrefix:(NSString *)apptxnMediaSubtypePrefix
                      error:(TLDaoErrorBlk)errBlk {
+  return [self initWithDataFilePath:sqliteDataFileUrl
+                userAgentDeviceMake:userAgentDeviceMake
+                  userAgentDeviceOS:userAgentDeviceOS
+           userAgentDeviceOSVersion:userAgentDeviceOSVersion
+                   relationExecutor:relationExecutor
+                         authScheme:authScheme
+                 authTokenParamName:authTokenParamName
+                 contentTypeCharset:contentTypeCharset
+                 apptxnResMtVersion:apptxnResMtVersion
+           apptxnMediaSubtypePrefix:apptxnMediaSubtypePrefix
+                       asynchronous:NO
+                           readyBlk:nil
+                              error:errBlk];
+}
+
+- (id)initWithDataFilePath:(NSString *)sqliteDataFileUrl
+       userAgentDeviceMake:(NSString *)userAgentDeviceMake
+         userAgentDeviceOS:(NSString *)userAgentDeviceOS
+  userAgentDeviceOSVersion:(NSString *)userAgentDeviceOSVersion
+          relationExecutor:(HCRelationExecutor *)relationExecutor
+                authScheme:(NSString *)authScheme
+        authTokenParamName:(NSString *)authTokenParamName
+        contentTypeCharset:(HCCharset *)contentTypeCharset
+        apptxnResMtVersion:(NSString *)apptxnResMtVersion
+  apptxnMediaSubtypePrefix:(NSString *)apptxnMediaSubtypePrefix
+                  readyBlk:(TLStoreReadyBlk)readyBlk
+                     error:(TLDaoErrorBlk)errBlk {
+  return [self initWithDataFilePath:sqliteDataFileUrl
+                userAgentDeviceMake:userAgentDeviceMake
+                  userAgentDeviceOS:userAgentDeviceOS
+           userAgentDeviceOSVersion:userAgentDeviceOSVersion
+                   relationExecutor:relationExecutor
+                         authScheme:authScheme
+                 authTokenParamName:authTokenParamName
+                 contentTypeCharset:contentTypeCharset
+                 apptxnResMtVersion:apptxnResMtVersion
+           apptxnMediaSubtypePrefix:apptxnMediaSubtypePrefix
+                       asynchronous:YES
+                           readyBlk:readyBlk
+                              error:errBlk];
+}
+
+- (id)initWithDataFilePath:(NSString *)sqliteDataFileUrl
+       userAgentDeviceMake:(NSString *)userAgentDeviceMake
+         userAgentDeviceOS:(NSString *)userAgentDeviceOS
+  userAgentDeviceOSVersion:(NSString *)userAgentDeviceOSVersion
+          relationExecutor:(HCRelationExecutor *)relationExecutor
+                authScheme:(NSString *)authScheme
+        authTokenParamName:(NSString *)authTokenParamName
+        contentTypeCharset:(HCCharset *)contentTypeCharset
+        apptxnResMtVersion:(NSString *)apptxnResMtVersion
+  apptxnMediaSubtypePrefix:(NSString *)apptxnMediaSubtypePrefix
+              asynchronous:(BOOL)asynchronous
+                  readyBlk:(TLStoreReadyBlk)readyBlk
+                     error:(TLDaoErrorBlk)errBlk {
   self = [super init];
   if (self) {
     _serialQueue = dispatch_queue_create("PEAppTransaction-Logger.apptxnlogging.bgprocessing",
                                          DISPATCH_QUEUE_SERIAL);
+    // (a queue of its own, so that background commits are not held up behind
+    // a flush)
+    _committerQueue = dispatch_queue_create("PEAppTransaction-Logger.apptxnlogging.writebehind",
+                                            DISPATCH_QUEUE_SERIAL);
     _sqliteDataFileUrl = sqliteDataFileUrl;
     _databaseQueue = [FMDatabaseQueue databaseQueueWithPath:sqliteDataFileUrl];
+    _storeEpoch = [[TLStoreEpoch alloc] init];
+    _metrics = [[TLMetrics alloc] init];
+    _maxTransactionsPerFlushBatch = 500;
+    _maxFlushBatchPayloadBytes = 256 * 1024;
+    _maxConcurrentFlushRequests = 2;
+    _flushPayloadFormat = TLTransactionSetFormatJSON;
+    _compressesFlushPayloads = NO;
+    _minCompressibleFlushPayloadBytes = 1024;
+    _maxStoredTransactionLogs = 10000;
+    _maxStoreBytes = 0;
+    _evictionBatchSize = 100;
+    _databaseProfile = TLDatabaseProfileDefault;
+    _databaseSynchronousMode = TLDatabaseSynchronousModeFull;
+    _databaseCacheSizeKiB = 2048;
+    _databaseMmapSize = 64 * 1024 * 1024;
+    _writeBehindBuffer = [[TLWriteBehindBuffer alloc] initWithDatabaseQueue:_databaseQueue
+                                                             committerQueue:_committerQueue];
+    [_writeBehindBuffer setMetrics:_metrics];
+    _rollupAggregator = [[TLRollupAggregator alloc] init];
     _userAgentDeviceMake = userAgentDeviceMake;
     _userAgentDeviceOS = userAgentDeviceOS;
     _userAgentDeviceOSVersion = userAgentDeviceOSVersion;
@@ -86,7 +204,46 @@ uint32_t const TL_REQUIRED_SCHEMA_VERSION = 1;
                                                     charset:contentTypeCharset
                             serializersForEmbeddedResources:@{}
                                 actionsForEmbeddedResources:@{}];
-    [self initializeDatabaseWithError:errBlk];
+    _msgPackTxnSetSerializer =
+      [[TLTransactionSetSerializer alloc] initWithMediaType:[TLKnownMediaTypes txnSetMediaTypeWithVersion:apptxnResMtVersion
+                                                                                       mediaSubTypePrefix:apptxnMediaSubtypePrefix
+                                                                                                   format:TLTransactionSetFormatMessagePack]
+                                                    charset:contentTypeCharset
+                            serializersForEmbeddedResources:@{}
+                                actionsForEmbeddedResources:@{}];
+    __weak TLTransactionManager *weakSelf = self;
+    _flushScheduler =
+      [[TLFlushScheduler alloc] initWithWorkQueue:_serialQueue
+                                            clock:[[TLSystemClock alloc] init]
+                                       backlogBlk:^(NSUInteger *numLogs, NSDate **oldestLogTimestamp) {
+                                         [weakSelf backlogNumLogs:numLogs oldestLogTimestamp:oldestLogTimestamp];
+                                       }
+                                         flushBlk:^TLFlushOutcome(NSDate **retryAfter) {
+                                           return [weakSelf scheduledFlushWithRetryAfter:retryAfter];
+                                         }];
+    if (asynchronous) {
+      // The local store is set up on the serial queue, ahead of any other work
+      // queued there (scheduled flushes, quota enforcement); meanwhile, new
+      // transactions and logs pile up in the held write-behind buffer, which
+      // commits nothing until the hold is released.
+      _readyGroup = dispatch_group_create();
+      dispatch_group_enter(_readyGroup);
+      [_writeBehindBuffer setHeld:YES];
+      dispatch_async(_serialQueue, ^{
+        [self openLocalStoreWithError:errBlk];
+        [_writeBehindBuffer releaseHoldAndCommit];
+        // (ready only once the held entries are in the store; the user agent
+        // id is only read once the store is known to be ready)
+        _ready = YES;
+        dispatch_group_leave(_readyGroup);
+        if (readyBlk) {
+          readyBlk();
+        }
+      });
+    } else {
+      [self openLocalStoreWithError:errBlk];
+      _ready = YES;
+    }
     _redirectionBlk = ^(NSURL *loc, BOOL moved, BOOL notModified, NSHTTPURLResponse *resp) {
       DDLogDebug(@"Redirection response received attempting to flush TLTransaction instances.  Response: %@", resp);
     };
@@ -99,15 +256,45 @@ uint32_t const TL_REQUIRED_SCHEMA_VERSION = 1;
     _connectionFailureBlk = ^(NSInteger nsurlErr) {
       DDLogDebug(@"Connection failure attempting to flush TLTransaction instances.  NSURL error code: [%ld]", (long)nsurlErr);
     };
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(applicationDidEnterBackground:)
+                                                 name:UIApplicationDidEnterBackgroundNotification
+                                               object:nil];
   }
   return self;
 }
 
 #pragma mark - Initialize Database
 
-- (void)initializeDatabaseWithError:(TLDaoErrorBlk)errorBlk {
+- (void)openLocalStoreWithError:(TLDaoErrorBlk)errBlk {
+  [self initializeDatabaseWithError:errBlk];
   [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+    _userAgentId = [TLDBUtils userAgentIdForDeviceMake:_userAgentDeviceMake
+                                              deviceOS:_userAgentDeviceOS
+                                       deviceOSVersion:_userAgentDeviceOSVersion
+                                                    db:db
+                                                 error:errBlk];
+    [_metrics setNumBacklogEvents:[db longForQuery:[NSString stringWithFormat:@"SELECT COUNT(*) FROM %@",
+                                                    TBL_TXN_LOG]]];
+  }];
+}
+
+#pragma mark - Readiness
+
+- (void)waitUntilReady {
+  if (_readyGroup) {
+    dispatch_group_wait(_readyGroup, DISPATCH_TIME_FOREVER);
+  }
+}
+
+- (void)initializeDatabaseWithError:(TLDaoErrorBlk)errorBlk {
+  [_databaseQueue inDatabase:^(FMDatabase *db) {
+    // (a no-op if issued within a transaction)
     [db executeUpdate:@"PRAGMA foreign_keys = ON"];
+  }];
+  [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+    // keep the statements issued on the logging path prepared across calls
+    [db setShouldCacheStatements:YES];
     uint32_t currentSchemaVersion = [db userVersion];
     DDLogDebug(@"in TLTransactionManager/initializeDatabaseWithError:, \
 currentSchemaVersion: %d.  Required schema version: %d.", currentSchemaVersion, TL_REQUIRED_SCHEMA_VERSION);
@@ -117,16 +304,178 @@ currentSchemaVersion: %d.  Required schema version: %d.", currentSchemaVersion,
         DDLogDebug(@"in TLTransactionManager/initializeDatabaseWithError:, \
 applied schema updates for version 0 (initial).");
         // fall-through to apply "next" schema updates
+      case 1:
+        [self applyVersion1SchemaEditsWithDb:db error:errorBlk];
+        DDLogDebug(@"in TLTransactionManager/initializeDatabaseWithError:, \
+applied schema updates for version 1.");
+        // fall-through to apply "next" schema updates
+      case 2:
+        [self applyVersion2SchemaEditsWithDb:db error:errorBlk];
+        DDLogDebug(@"in TLTransactionManager/initializeDatabaseWithError:, \
+applied schema updates for version 2.");
+        // fall-through to apply "next" schema updates
+      case 3:
+        [self applyVersion3SchemaEditsWithDb:db error:errorBlk];
+        DDLogDebug(@"in TLTransactionManager/initializeDatabaseWithError:, \
+applied schema updates for version 3.");
+        // fall-through to apply "next" schema updates
+      case 4:
+        [self applyVersion4SchemaEditsWithDb:db error:errorBlk];
+        DDLogDebug(@"in TLTransactionManager/initializeDatabaseWithError:, \
+applied schema updates for version 4.");
+        // fall-through to apply "next" schema updates
+      case 5:
+        [self applyVersion5SchemaEditsWithDb:db error:errorBlk];
+        DDLogDebug(@"in TLTransactionManager/initializeDatabaseWithError:, \
+applied schema updates for version 5.");
+        // fall-through to apply "next" schema updates
+      case 6:
+        [self applyVersion6SchemaEditsWithDb:db error:errorBlk];
+        DDLogDebug(@"in TLTransactionManager/initializeDatabaseWithError:, \
+applied schema updates for version 6.");
+        // fall-through to apply "next" schema updates
+      case 7:
+        [self applyVersion7SchemaEditsWithDb:db error:errorBlk];
+        DDLogDebug(@"in TLTransactionManager/initializeDatabaseWithError:, \
+applied schema updates for version 7.");
+        // fall-through to apply "next" schema updates
       case TL_REQUIRED_SCHEMA_VERSION:
         // great, nothing needed to do except update the db's schema version
         [db setUserVersion:TL_REQUIRED_SCHEMA_VERSION];
         break;
     }
+    [TLDBUtils doUpdate:[TLDDLUtils tempTransactionIdDDL] db:db error:errorBlk];
   }];
 }
 
 #pragma mark - Schema version: <FUTURE VERSION>
 
+#pragma mark - Schema edits, version: 7
+
+- (void)applyVersion7SchemaEditsWithDb:(FMDatabase *)db
+                                 error:(TLDaoErrorBlk)errorBlk {
+  [TLDBUtils doUpdate:[TLDDLUtils transactionRollupDDL] db:db error:errorBlk];
+  [TLDBUtils doUpdate:[TLDDLUtils transactionRollupWindowIndexDDL] db:db error:errorBlk];
+}
+
+#pragma mark - Schema edits, version: 6
+
+- (void)applyVersion6SchemaEditsWithDb:(FMDatabase *)db
+                                 error:(TLDaoErrorBlk)errorBlk {
+  // GUIDs are converted from their textual form (TXN<use case>-<UUID>, ~45
+  // bytes; the use case is in its own column anyway) to the 16 bytes of their
+  // UUID.  SQLite stores a blob as-is whatever the column's declared type, so
+  // the column (and its index) stay; only the values change.
+  NSMutableArray *txnIds = [NSMutableArray array];
+  NSMutableArray *guidBytes = [NSMutableArray array];
+  FMResultSet *rs = [TLDBUtils doQuery:[NSString stringWithFormat:@"SELECT %@, %@ FROM %@ WHERE typeof(%@) = 'text'",
+                                        COL_TXN_ID, COL_TXN_GUID, TBL_TXN, COL_TXN_GUID]
+                             argsArray:@[]
+                                    db:db
+                                 error:errorBlk];
+  while ([rs next]) {
+    NSData *rowGuidBytes = [TLTransaction guidBytesOfGuid:[rs stringForColumnIndex:1]];
+    [txnIds addObject:@([rs longLongIntForColumnIndex:0])];
+    [guidBytes addObject:(rowGuidBytes ? rowGuidBytes : [TLTransaction newGuidBytes])];
+  }
+  [rs close];
+  NSString *updateGuid = [NSString stringWithFormat:@"UPDATE %@ SET %@ = ? WHERE %@ = ?",
+                          TBL_TXN, COL_TXN_GUID, COL_TXN_ID];
+  for (NSUInteger i = 0; i < [txnIds count]; i++) {
+    [TLDBUtils doUpdate:updateGuid argsArray:@[guidBytes[i], txnIds[i]] db:db error:errorBlk];
+  }
+}
+
+#pragma mark - Schema edits, version: 5
+
+- (void)applyVersion5SchemaEditsWithDb:(FMDatabase *)db
+                                 error:(TLDaoErrorBlk)errorBlk {
+  // SQLite cannot add ON DELETE CASCADE to an existing foreign key, so the
+  // transaction log table is rebuilt.  Orphaned logs (left behind while
+  // foreign keys went unenforced) are not carried over.
+  [TLDBUtils doUpdate:[TLDDLUtils cascadingTransactionLogDDLWithTable:TBL_TXN_LOG_REBUILD] db:db error:errorBlk];
+  NSString *cols = [@[COL_TXNLOG_ID,
+                      COL_TXNLOG_PARENT_TXN_ID,
+                      COL_TXNLOG_TIMESTAMP,
+                      COL_TXNLOG_USECASE_EVENT,
+                      COL_TXNLOG_IN_CTX_ERR_CODE,
+                      COL_TXNLOG_IN_CTX_ERR_DESC] componentsJoinedByString:@", "];
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"INSERT INTO %@(%@) SELECT %@ FROM %@ \
+                       WHERE %@ IN (SELECT %@ FROM %@)",
+                       TBL_TXN_LOG_REBUILD, cols, cols, TBL_TXN_LOG,
+                       COL_TXNLOG_PARENT_TXN_ID, COL_TXN_ID, TBL_TXN]
+                   db:db
+                error:errorBlk];
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"DROP TABLE %@", TBL_TXN_LOG] db:db error:errorBlk];
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"ALTER TABLE %@ RENAME TO %@", TBL_TXN_LOG_REBUILD, TBL_TXN_LOG]
+                   db:db
+                error:errorBlk];
+  [TLDBUtils doUpdate:[TLDDLUtils transactionLogParentTxnIdIndexDDL] db:db error:errorBlk];
+}
+
+#pragma mark - Schema edits, version: 4
+
+- (void)applyVersion4SchemaEditsWithDb:(FMDatabase *)db
+                                 error:(TLDaoErrorBlk)errorBlk {
+  [TLDBUtils doUpdate:[TLDDLUtils flushBatchDDL] db:db error:errorBlk];
+  [TLDBUtils doUpdate:[TLDDLUtils transactionFlushBatchIdColumnDDL] db:db error:errorBlk];
+  [TLDBUtils doUpdate:[TLDDLUtils transactionFlushBatchIdIndexDDL] db:db error:errorBlk];
+}
+
+#pragma mark - Schema edits, version: 3
+
+- (void)applyVersion3SchemaEditsWithDb:(FMDatabase *)db
+                                 error:(TLDaoErrorBlk)errorBlk {
+  [TLDBUtils doUpdate:[TLDDLUtils transactionSampleRateColumnDDL] db:db error:errorBlk];
+}
+
+#pragma mark - Schema edits, version: 2
+
+- (void)applyVersion2SchemaEditsWithDb:(FMDatabase *)db
+                                 error:(TLDaoErrorBlk)errorBlk {
+  // The user agent triple is constant for the life of a manager, so it moves
+  // out of the transaction table into its own table, referenced by id.
+  [TLDBUtils doUpdate:[TLDDLUtils userAgentDDL] db:db error:errorBlk];
+  [TLDBUtils doUpdate:[TLDDLUtils transactionUserAgentIdColumnDDL] db:db error:errorBlk];
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"INSERT INTO %@(%@, %@, %@) \
+                       SELECT DISTINCT %@, %@, %@ FROM %@",
+                       TBL_USER_AGENT,
+                       COL_USERAGENT_DEVICE_MAKE,
+                       COL_USERAGENT_DEVICE_OS,
+                       COL_USERAGENT_DEVICE_OS_VERSION,
+                       COL_TXN_USERAGENT_DEVICE_MAKE,
+                       COL_TXN_USERAGENT_DEVICE_OS,
+                       COL_TXN_USERAGENT_DEVICE_OS_VERSION,
+                       TBL_TXN]
+                   db:db
+                error:errorBlk];
+  // SQLite cannot drop the (now unused) legacy columns, but nulling them out
+  // reclaims their space.
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"UPDATE %@ SET %@ = \
+                       (SELECT ua.%@ FROM %@ ua WHERE ua.%@ IS %@.%@ AND ua.%@ IS %@.%@ AND ua.%@ IS %@.%@), \
+                       %@ = NULL, %@ = NULL, %@ = NULL",
+                       TBL_TXN,
+                       COL_TXN_USER_AGENT_ID,
+                       COL_USERAGENT_ID,
+                       TBL_USER_AGENT,
+                       COL_USERAGENT_DEVICE_MAKE, TBL_TXN, COL_TXN_USERAGENT_DEVICE_MAKE,
+                       COL_USERAGENT_DEVICE_OS, TBL_TXN, COL_TXN_USERAGENT_DEVICE_OS,
+                       COL_USERAGENT_DEVICE_OS_VERSION, TBL_TXN, COL_TXN_USERAGENT_DEVICE_OS_VERSION,
+                       COL_TXN_USERAGENT_DEVICE_MAKE,
+                       COL_TXN_USERAGENT_DEVICE_OS,
+                       COL_TXN_USERAGENT_DEVICE_OS_VERSION]
+                   db:db
+                error:errorBlk];
+}
+
+#pragma mark - Schema edits, version: 1
+
+- (void)applyVersion1SchemaEditsWithDb:(FMDatabase *)db
+                                 error:(TLDaoErrorBlk)errorBlk {
+  [TLDBUtils doUpdate:[TLDDLUtils transactionGuidIndexDDL] db:db error:errorBlk];
+  [TLDBUtils doUpdate:[TLDDLUtils transactionLogParentTxnIdIndexDDL] db:db error:errorBlk];
+}
+
 #pragma mark - Schema edits, version: 0 (initial schema version)
 
 - (void)applyVersion0SchemaEditsWithDb:(FMDatabase *)db
@@ -146,72 +495,488 @@ applied schema updates for version 0 (initial).");
   }
 }
 
+- (void)setDatabaseProfile:(TLDatabaseProfile)databaseProfile {
+  _databaseProfile = databaseProfile;
+  BOOL performance = (databaseProfile == TLDatabaseProfilePerformance);
+  NSString *path = [_databaseQueue path];
+  BOOL inMemory = ([path length] == 0 || [path isEqualToString:@":memory:"]);
+  TLDaoErrorBlk errBlk = ^(NSError *err, int code, NSString *msg) {
+    DDLogError(@"Error applying database profile [%ld]: %@ (code: %d)", (long)databaseProfile, msg, code);
+  };
+  NSArray *connectionPragmas =
+    performance ? @[[NSString stringWithFormat:@"cache_size = -%lu", (unsigned long)_databaseCacheSizeKiB],
+                    [NSString stringWithFormat:@"mmap_size = %llu", _databaseMmapSize]]
+                : @[@"cache_size = -2000", @"mmap_size = 0"];
+  [_databaseQueue inDatabase:^(FMDatabase *db) {
+    if (!inMemory) {
+      NSString *journalMode = [TLDBUtils doPragma:(performance ? @"journal_mode = WAL" : @"journal_mode = DELETE")
+                                               db:db
+                                            error:errBlk];
+      DDLogDebug(@"Database journal mode now: [%@].", journalMode);
+    }
+    for (NSString *pragma in connectionPragmas) {
+      [TLDBUtils doPragma:pragma db:db error:errBlk];
+    }
+  }];
+  // Under a WAL, readers work off a snapshot of the data file and neither
+  // block nor are blocked by the writer; so reads get their own connection.
+  FMDatabaseQueue *readDatabaseQueue = nil;
+  if (performance && !inMemory) {
+    readDatabaseQueue = [FMDatabaseQueue databaseQueueWithPath:path flags:SQLITE_OPEN_READONLY];
+    [readDatabaseQueue inDatabase:^(FMDatabase *db) {
+      [db setShouldCacheStatements:YES];
+      for (NSString *pragma in connectionPragmas) {
+        [TLDBUtils doPragma:pragma db:db error:errBlk];
+      }
+    }];
+  }
+  FMDatabaseQueue *oldReadDatabaseQueue = nil;
+  @synchronized(self) {
+    oldReadDatabaseQueue = _readDatabaseQueue;
+    _readDatabaseQueue = readDatabaseQueue;
+  }
+  [oldReadDatabaseQueue close];
+  [self setDatabaseSynchronousMode:(performance ? TLDatabaseSynchronousModeNormal
+                                                : TLDatabaseSynchronousModeFull)];
+}
+
+- (void)setDatabaseSynchronousMode:(TLDatabaseSynchronousMode)databaseSynchronousMode {
+  _databaseSynchronousMode = databaseSynchronousMode;
+  [_databaseQueue inDatabase:^(FMDatabase *db) {
+    [TLDBUtils doPragma:[NSString stringWithFormat:@"synchronous = %ld", (long)databaseSynchronousMode]
+                     db:db
+                  error:^(NSError *err, int code, NSString *msg) {
+                    DDLogError(@"Error setting the database synchronous mode: %@ (code: %d)", msg, code);
+                  }];
+  }];
+}
+
+#pragma mark - Read Connection
+
+- (void)inReadTransaction:(void (^)(FMDatabase *db))block {
+  [self inReadTransactionWithPersistedEpoch:^(FMDatabase *db, uint64_t persistedEpoch) {
+    block(db);
+  }];
+}
+
+- (void)inReadTransactionWithPersistedEpoch:(void (^)(FMDatabase *db, uint64_t persistedEpoch))block {
+  // The block is also given the store epoch at which the rows it reads are
+  // known to be persisted.  Rows read on the write connection are persisted
+  // at the current epoch, as nothing is deleted while they are read.  Rows
+  // read from a snapshot of the read connection may have been deleted (and
+  // the epoch advanced) since the snapshot was taken, so they are known to be
+  // persisted at no epoch (0).
+  FMDatabaseQueue *readDatabaseQueue = nil;
+  @synchronized(self) {
+    readDatabaseQueue = _readDatabaseQueue;
+  }
+  // (a deferred transaction, so that the block reads from a single snapshot)
+  if (readDatabaseQueue) {
+    [readDatabaseQueue inDeferredTransaction:^(FMDatabase *db, BOOL *rollback) {
+      block(db, 0);
+    }];
+  } else {
+    [_databaseQueue inDeferredTransaction:^(FMDatabase *db, BOOL *rollback) {
+      block(db, [_storeEpoch value]);
+    }];
+  }
+}
+
 #pragma mark - Creating new transaction instances
 
 - (TLTransaction *)transactionWithUsecase:(NSNumber *)usecase
                                     error:(TLDaoErrorBlk)errorBlk {
-  NSString *guid = [NSString stringWithFormat:@"TXN%@-%@", usecase,
-                              [[NSUUID UUID] UUIDString]];
+  uint64_t startTime = TLLatencyClockNow();
+  TLLoggingPolicy *loggingPolicy = [self loggingPolicy];
+  if ([loggingPolicy rollsUpUsecase:usecase]) {
+    // never recorded; the transaction and its events are only counted
+    TLTransaction *rolledUpTxn =
+      [[TLTransaction alloc] initWithUsecase:usecase
+                                     localId:nil
+                                        guid:nil
+                         userAgentDeviceMake:_userAgentDeviceMake
+                           userAgentDeviceOS:_userAgentDeviceOS
+                    userAgentDeviceOSVersion:_userAgentDeviceOSVersion
+                               databaseQueue:_databaseQueue
+                           writeBehindBuffer:nil];
+    [rolledUpTxn setMetrics:_metrics];
+    [rolledUpTxn setRecorded:NO];
+    [rolledUpTxn setRecordsOnError:NO];
+    [rolledUpTxn setRollupAggregator:_rollupAggregator];
+    [_rollupAggregator addTransactionWithUsecase:usecase];
+    [[_metrics transactionCreationLatency] recordDurationSince:startTime];
+    return rolledUpTxn;
+  }
+  double sampleRate = loggingPolicy ? [loggingPolicy admitTransactionWithUsecase:usecase] : 1.0;
+  BOOL recorded = sampleRate > 0.0;
   TLTransaction *newTxn =
     [[TLTransaction alloc] initWithUsecase:usecase
                                    localId:nil
-                                      guid:guid
+                                      guid:nil
                        userAgentDeviceMake:_userAgentDeviceMake
                          userAgentDeviceOS:_userAgentDeviceOS
                   userAgentDeviceOSVersion:_userAgentDeviceOSVersion
-                             databaseQueue:_databaseQueue];
-  [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
-    [TLDBUtils insertTransaction:newTxn db:db error:errorBlk];
-  }];
+                             databaseQueue:_databaseQueue
+                         writeBehindBuffer:_writeBehindBuffer];
+  [newTxn setMetrics:_metrics];
+  // (left nil until the store is ready; it is then looked up on insert)
+  [newTxn setUserAgentLocalId:([self isReady] ? _userAgentId : nil)];
+  [newTxn setStoreEpoch:_storeEpoch];
+  if (!recorded) {
+    // no GUID and no write; the transaction only springs to life if it logs
+    // an error (and the policy keeps errors)
+    [newTxn setRecorded:NO];
+    [newTxn setRecordsOnError:[loggingPolicy alwaysKeepsErrors]];
+    [[_metrics transactionCreationLatency] recordDurationSince:startTime];
+    return newTxn;
+  }
+  [newTxn setGuidBytes:[TLTransaction newGuidBytes]];
+  [newTxn setSampleRate:sampleRate];
+  if ([_writeBehindBuffer isEnabled]) {
+    [_writeBehindBuffer appendTransaction:newTxn error:errorBlk];
+  } else {
+    uint64_t enqueueTime = TLLatencyClockNow();
+    [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+      [[_metrics databaseQueueWaitLatency] recordDurationSince:enqueueTime];
+      [TLDBUtils insertTransaction:newTxn db:db error:errorBlk];
+    }];
+  }
+  [[_metrics transactionCreationLatency] recordDurationSince:startTime];
   return newTxn;
 }
 
+#pragma mark - Write-Behind
+
+- (void)sync {
+  [self waitUntilReady];
+  [_writeBehindBuffer sync];
+  [self persistRollupsWithError:^(NSError *err, int code, NSString *msg) {
+    NSLog(@"Local database error attempting to store transaction rollups.  \
+Error code: [%d], error msg: [%@], error: [%@]", code, msg, err);
+  }];
+}
+
+#pragma mark - Notifications
+
+- (void)applicationDidEnterBackground:(NSNotification *)notification {
+  // The in-memory rollups would be lost if the app were then killed; they are
+  // stored now (once the store is ready, if it is still being set up).
+  TLDaoErrorBlk errorBlk = ^(NSError *err, int code, NSString *msg) {
+    NSLog(@"Local database error attempting to store transaction rollups.  \
+Error code: [%d], error msg: [%@], error: [%@]", code, msg, err);
+  };
+  if ([self isReady]) {
+    [self persistRollupsWithError:errorBlk];
+  } else {
+    dispatch_async(_serialQueue, ^{
+      [self persistRollupsWithError:errorBlk];
+    });
+  }
+}
+
+#pragma mark - Bulk Event Logging
+
+- (void)logTransactionLogs:(NSArray *)txnLogArrays
+           forTransactions:(NSArray *)transactions
+                     error:(TLDaoErrorBlk)errBlk {
+  NSAssert([txnLogArrays count] == [transactions count],
+           @"One array of transaction logs is needed per transaction.");
+  [TLTransaction logTransactionLogs:txnLogArrays
+                    forTransactions:transactions
+                      databaseQueue:_databaseQueue
+                  writeBehindBuffer:_writeBehindBuffer
+                            metrics:_metrics
+                              error:errBlk];
+}
+
 #pragma mark - Fetching
 
 - (NSArray *)allTransactionsWithError:(TLDaoErrorBlk)errBlk {
+  [self waitUntilReady];
+  [_writeBehindBuffer sync];
   __block NSArray *txns = nil;
-  [_databaseQueue inDatabase:^(FMDatabase *db) {
-    txns = [self allTransactionsWithDb:db error:errBlk];
+  [self inReadTransactionWithPersistedEpoch:^(FMDatabase *db, uint64_t persistedEpoch) {
+    txns = [self allTransactionsWithDb:db persistedEpoch:persistedEpoch error:errBlk];
   }];
   return txns;
 }
 
 - (NSArray *)allTransactionsWithDb:(FMDatabase *)db
+                    persistedEpoch:(uint64_t)persistedEpoch
                              error:(TLDaoErrorBlk)errBlk {
   NSMutableArray *txns = [NSMutableArray array];
-  NSString *qry = [NSString stringWithFormat:@"SELECT * FROM %@", TBL_TXN];
-  FMResultSet *rs = [TLDBUtils doQuery:qry argsArray:@[] db:db error:errBlk];
+  [self enumerateTransactionsAfterTxnId:0
+                                  limit:0
+                                     db:db
+                         persistedEpoch:persistedEpoch
+                                  error:errBlk
+                             usingBlock:^(TLTransaction *txn, BOOL *stop) {
+                           [txns addObject:txn];
+                         }];
+  return txns;
+}
+
+- (void)enumerateTransactionsAfterTxnId:(long long)afterTxnId
+                                  limit:(NSUInteger)limit
+                                     db:(FMDatabase *)db
+                         persistedEpoch:(uint64_t)persistedEpoch
+                                  error:(TLDaoErrorBlk)errBlk
+                             usingBlock:(void(^)(TLTransaction *, BOOL *))block {
+  [self enumerateTransactionsWhere:[NSString stringWithFormat:@"%@ > ?", COL_TXN_ID]
+                         whereArgs:@[@(afterTxnId)]
+                      logWatermark:LONG_MAX
+                             limit:limit
+                                db:db
+                    persistedEpoch:persistedEpoch
+                             error:errBlk
+                        usingBlock:block];
+}
+
+- (void)enumerateTransactionsWhere:(NSString *)txnCondition
+                         whereArgs:(NSArray *)txnConditionArgs
+                      logWatermark:(long)logWatermark
+                             limit:(NSUInteger)limit
+                                db:(FMDatabase *)db
+                    persistedEpoch:(uint64_t)persistedEpoch
+                             error:(TLDaoErrorBlk)errBlk
+                        usingBlock:(void(^)(TLTransaction *, BOOL *))block {
+  // A single ordered outer join: the rows of each transaction are adjacent,
+  // so each transaction is complete (and handed to the block) as soon as the
+  // next transaction's first row is read.  A limit of 0 means no limit; logs
+  // with an id above the watermark are left out.  The transactions are known
+  // to be persisted at persistedEpoch (see inReadTransactionWithPersistedEpoch:).
+  NSString *qry = [NSString stringWithFormat:@"SELECT t.%@, t.%@, t.%@, ua.%@, ua.%@, ua.%@, \
+                   l.%@, l.%@, l.%@, l.%@, l.%@, t.%@, t.%@ \
+                   FROM (SELECT * FROM %@ WHERE %@ ORDER BY %@ LIMIT ?) t \
+                   LEFT OUTER JOIN %@ ua ON ua.%@ = t.%@ \
+                   LEFT OUTER JOIN %@ l ON l.%@ = t.%@ AND l.%@ <= ? \
+                   ORDER BY t.%@, l.%@",
+                   COL_TXN_ID,                      // idx 0
+                   COL_TXN_GUID,                    // idx 1
+                   COL_TXN_USECASE,                 // idx 2
+                   COL_USERAGENT_DEVICE_MAKE,       // idx 3
+                   COL_USERAGENT_DEVICE_OS,         // idx 4
+                   COL_USERAGENT_DEVICE_OS_VERSION, // idx 5
+                   COL_TXNLOG_ID,                   // idx 6
+                   COL_TXNLOG_TIMESTAMP,            // idx 7
+                   COL_TXNLOG_USECASE_EVENT,        // idx 8
+                   COL_TXNLOG_IN_CTX_ERR_CODE,      // idx 9
+                   COL_TXNLOG_IN_CTX_ERR_DESC,      // idx 10
+                   COL_TXN_USER_AGENT_ID,           // idx 11
+                   COL_TXN_SAMPLE_RATE,             // idx 12
+                   TBL_TXN, txnCondition, COL_TXN_ID,
+                   TBL_USER_AGENT, COL_USERAGENT_ID, COL_TXN_USER_AGENT_ID,
+                   TBL_TXN_LOG, COL_TXNLOG_PARENT_TXN_ID, COL_TXN_ID, COL_TXNLOG_ID,
+                   COL_TXN_ID, COL_TXNLOG_ID];
+  NSMutableArray *args = [NSMutableArray arrayWithArray:txnConditionArgs];
+  [args addObject:limit > 0 ? @(limit) : @(-1)];
+  [args addObject:@(logWatermark)];
+  FMResultSet *rs = [TLDBUtils doQuery:qry
+                             argsArray:args
+                                    db:db
+                                 error:errBlk];
+  TLTransaction *txn = nil;
+  NSMutableArray *txnLogs = nil;
+  long long txnId = 0;
+  // The user agent fields are read (and allocated) only when the user agent
+  // changes from one transaction to the next, which is rare.
+  NSNumber *userAgentId = nil;
+  NSString *userAgentDeviceMake = nil;
+  NSString *userAgentDeviceOS = nil;
+  NSString *userAgentDeviceOSVersion = nil;
+  BOOL stop = NO;
   while ([rs next]) {
-    TLTransaction *txn =
-      [[TLTransaction alloc] initWithUsecase:[rs objectForColumnName:COL_TXN_USECASE]
-                                     localId:[rs objectForColumnName:COL_TXN_ID]
-                                        guid:[rs stringForColumn:COL_TXN_GUID]
-                         userAgentDeviceMake:[rs stringForColumn:COL_TXN_USERAGENT_DEVICE_MAKE]
-                           userAgentDeviceOS:[rs stringForColumn:COL_TXN_USERAGENT_DEVICE_OS]
-                    userAgentDeviceOSVersion:[rs stringForColumn:COL_TXN_USERAGENT_DEVICE_OS_VERSION]
-                               databaseQueue:_databaseQueue];
-    [txns addObject:txn];
-  }
-  qry = [NSString stringWithFormat:@"SELECT * FROM %@ WHERE %@ = ?", TBL_TXN_LOG, COL_TXNLOG_PARENT_TXN_ID];
-  for (TLTransaction *txn in txns) {
-    NSMutableArray *txnLogs = [NSMutableArray array];
-    rs = [TLDBUtils doQuery:qry argsArray:@[[txn localId]] db:db error:errBlk];
-    while ([rs next]) {
+    long long rowTxnId = [rs longLongIntForColumnIndex:0];
+    if (!txn || rowTxnId != txnId) {
+      if (txn) {
+        [txn setLogs:txnLogs];
+        block(txn, &stop);
+        if (stop) {
+          break;
+        }
+      }
+      txnId = rowTxnId;
+      txnLogs = [NSMutableArray array];
+      NSNumber *rowUserAgentId = [rs columnIndexIsNull:11] ? nil : @([rs longLongIntForColumnIndex:11]);
+      if (!rowUserAgentId || !userAgentId || ![rowUserAgentId isEqualToNumber:userAgentId]) {
+        userAgentId = rowUserAgentId;
+        userAgentDeviceMake = [rs stringForColumnIndex:3];
+        userAgentDeviceOS = [rs stringForColumnIndex:4];
+        userAgentDeviceOSVersion = [rs stringForColumnIndex:5];
+      }
+      txn = [[TLTransaction alloc] initWithUsecase:[rs objectForColumnIndex:2]
+                                           localId:@(rowTxnId)
+                                              guid:nil
+                               userAgentDeviceMake:userAgentDeviceMake
+                                 userAgentDeviceOS:userAgentDeviceOS
+                          userAgentDeviceOSVersion:userAgentDeviceOSVersion
+                                     databaseQueue:_databaseQueue
+                                 writeBehindBuffer:_writeBehindBuffer];
+      [txn setGuidBytes:[rs dataForColumnIndex:1]];
+      [txn setUserAgentLocalId:userAgentId];
+      [txn setStoreEpoch:_storeEpoch];
+      [txn setMetrics:_metrics];
+      if (![rs columnIndexIsNull:12]) {
+        [txn setSampleRate:[rs doubleForColumnIndex:12]];
+      }
+      [txn setPersistedEpoch:persistedEpoch];
+    }
+    if (![rs columnIndexIsNull:6]) {
       TLTransactionLog *txnLog =
-        [[TLTransactionLog alloc] initWithUsecaseEvent:[rs objectForColumnName:COL_TXNLOG_USECASE_EVENT]
-                                      inContextErrCode:[rs objectForColumnName:COL_TXNLOG_IN_CTX_ERR_CODE]
-                               inContextErrDescription:[rs stringForColumn:COL_TXNLOG_IN_CTX_ERR_DESC]];
+        [[TLTransactionLog alloc] initWithUsecaseEvent:[rs objectForColumnIndex:8]
+                                      inContextErrCode:[rs objectForColumnIndex:9]
+                               inContextErrDescription:[rs stringForColumnIndex:10]];
+      [txnLog setTimestamp:[rs dateForColumnIndex:7]];
       [txnLogs addObject:txnLog];
     }
+  }
+  if (stop) {
+    [rs close];
+  } else if (txn) {
     [txn setLogs:txnLogs];
+    block(txn, &stop);
   }
-  return txns;
 }
 
+#pragma mark - Enumerating
+
+- (TLTransactionCursor *)transactionCursorWithFilter:(TLTransactionFilter *)filter
+                                           chunkSize:(NSUInteger)chunkSize
+                                               error:(TLDaoErrorBlk)errBlk {
+  [self waitUntilReady];
+  [_writeBehindBuffer sync];
+  NSMutableArray *filterArgs = [NSMutableArray array];
+  NSString *filterCondition = [self conditionForFilter:filter args:filterArgs];
+  __weak TLTransactionManager *weakSelf = self;
+  return [[TLTransactionCursor alloc] initWithChunkSize:chunkSize
+                                               fetchBlk:^NSArray *(long long afterTxnId, NSUInteger limit) {
+    NSMutableArray *txns = [NSMutableArray arrayWithCapacity:limit];
+    [weakSelf inReadTransactionWithPersistedEpoch:^(FMDatabase *db, uint64_t persistedEpoch) {
+      [weakSelf enumerateTransactionsWhere:[NSString stringWithFormat:@"%@ > ? AND (%@)",
+                                            COL_TXN_ID, filterCondition]
+                                 whereArgs:[@[@(afterTxnId)] arrayByAddingObjectsFromArray:filterArgs]
+                              logWatermark:LONG_MAX
+                                     limit:limit
+                                        db:db
+                            persistedEpoch:persistedEpoch
+                                     error:errBlk
+                                usingBlock:^(TLTransaction *txn, BOOL *stop) {
+                                  [txns addObject:txn];
+                                }];
+    }];
+    return txns;
+  }];
+}
+
+- (void)enumerateTransactionsWithFilter:(TLTransactionFilter *)filter
+                                  error:(TLDaoErrorBlk)errBlk
+                             usingBlock:(void(^)(TLTransaction *txn, BOOL *stop))block {
+  TLTransactionCursor *cursor = [self transactionCursorWithFilter:filter chunkSize:100 error:errBlk];
+  BOOL stop = NO;
+  TLTransaction *txn;
+  while (!stop && (txn = [cursor nextTransaction])) {
+    block(txn, &stop);
+  }
+}
+
+- (NSString *)conditionForFilter:(TLTransactionFilter *)filter
+                            args:(NSMutableArray *)args {
+  // (a condition on the rows of the transaction table, referenced by name)
+  NSMutableArray *conditions = [NSMutableArray array];
+  if ([filter usecases]) {
+    NSMutableArray *placeholders = [NSMutableArray array];
+    for (NSNumber *usecase in [filter usecases]) {
+      [placeholders addObject:@"?"];
+      [args addObject:usecase];
+    }
+    [conditions addObject:[NSString stringWithFormat:@"%@ IN (%@)",
+                           COL_TXN_USECASE, [placeholders componentsJoinedByString:@", "]]];
+  }
+  if ([filter fromDate] || [filter toDate]) {
+    NSMutableString *logCondition = [NSMutableString string];
+    if ([filter fromDate]) {
+      [logCondition appendFormat:@" AND l2.%@ >= ?", COL_TXNLOG_TIMESTAMP];
+      [args addObject:[filter fromDate]];
+    }
+    if ([filter toDate]) {
+      [logCondition appendFormat:@" AND l2.%@ < ?", COL_TXNLOG_TIMESTAMP];
+      [args addObject:[filter toDate]];
+    }
+    [conditions addObject:[NSString stringWithFormat:@"EXISTS (SELECT 1 FROM %@ l2 WHERE l2.%@ = %@.%@%@)",
+                           TBL_TXN_LOG, COL_TXNLOG_PARENT_TXN_ID, TBL_TXN, COL_TXN_ID, logCondition]];
+  }
+  if ([filter errorFilter] != TLTransactionErrorFilterAny) {
+    [conditions addObject:[NSString stringWithFormat:@"%@EXISTS (SELECT 1 FROM %@ l3 WHERE l3.%@ = %@.%@ AND l3.%@ IS NOT NULL)",
+                           ([filter errorFilter] == TLTransactionErrorFilterWithoutErrors ? @"NOT " : @""),
+                           TBL_TXN_LOG, COL_TXNLOG_PARENT_TXN_ID, TBL_TXN, COL_TXN_ID, COL_TXNLOG_IN_CTX_ERR_CODE]];
+  }
+  return [conditions count] > 0 ? [conditions componentsJoinedByString:@" AND "] : @"1";
+}
+
+#pragma mark - Aggregates
+
+- (NSUInteger)numTransactionsWithFilter:(TLTransactionFilter *)filter
+                                  error:(TLDaoErrorBlk)errBlk {
+  [self waitUntilReady];
+  [_writeBehindBuffer sync];
+  NSMutableArray *args = [NSMutableArray array];
+  NSString *qry = [NSString stringWithFormat:@"SELECT COUNT(*) FROM %@ WHERE %@",
+                   TBL_TXN, [self conditionForFilter:filter args:args]];
+  __block NSUInteger numTxns = 0;
+  [self inReadTransaction:^(FMDatabase *db) {
+    FMResultSet *rs = [TLDBUtils doQuery:qry argsArray:args db:db error:errBlk];
+    if ([rs next]) {
+      numTxns = (NSUInteger)[rs longLongIntForColumnIndex:0];
+    }
+    [rs close];
+  }];
+  return numTxns;
+}
+
+- (NSDictionary *)numTransactionsByUsecaseWithFilter:(TLTransactionFilter *)filter
+                                               error:(TLDaoErrorBlk)errBlk {
+  [self waitUntilReady];
+  [_writeBehindBuffer sync];
+  NSMutableArray *args = [NSMutableArray array];
+  NSString *qry = [NSString stringWithFormat:@"SELECT %@, COUNT(*) FROM %@ WHERE %@ GROUP BY %@",
+                   COL_TXN_USECASE, TBL_TXN, [self conditionForFilter:filter args:args], COL_TXN_USECASE];
+  NSMutableDictionary *numTxnsByUsecase = [NSMutableDictionary dictionary];
+  [self inReadTransaction:^(FMDatabase *db) {
+    FMResultSet *rs = [TLDBUtils doQuery:qry argsArray:args db:db error:errBlk];
+    while ([rs next]) {
+      if (![rs columnIndexIsNull:0]) {
+        numTxnsByUsecase[[rs objectForColumnIndex:0]] = @([rs longLongIntForColumnIndex:1]);
+      }
+    }
+    [rs close];
+  }];
+  return numTxnsByUsecase;
+}
+
+- (NSDate *)oldestPendingLogTimestampWithError:(TLDaoErrorBlk)errBlk {
+  [self waitUntilReady];
+  [_writeBehindBuffer sync];
+  __block NSDate *oldestLogTimestamp = nil;
+  [self inReadTransaction:^(FMDatabase *db) {
+    FMResultSet *rs = [TLDBUtils doQuery:[NSString stringWithFormat:@"SELECT MIN(%@) FROM %@",
+                                          COL_TXNLOG_TIMESTAMP, TBL_TXN_LOG]
+                               argsArray:@[]
+                                      db:db
+                                   error:errBlk];
+    if ([rs next] && ![rs columnIndexIsNull:0]) {
+      oldestLogTimestamp = [rs dateForColumnIndex:0];
+    }
+    [rs close];
+  }];
+  return oldestLogTimestamp;
+}
 
 #pragma mark - Deletion
 
 - (void)deleteAllTransactionsInTxnWithError:(TLDaoErrorBlk)errBlk {
+  [self waitUntilReady];
+  [_writeBehindBuffer sync];
+  [_rollupAggregator drainRollups];
   [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
     [self deleteAllTransactionsInDb:db error:errBlk];
   }];
@@ -221,10 +986,15 @@ applied schema updates for version 0 (initial).");
                             error:(TLDaoErrorBlk)errBlk {
   [TLDBUtils deleteFromTable:TBL_TXN_LOG whereColumns:@[] whereValues:@[] db:db error:errBlk];
   [TLDBUtils deleteFromTable:TBL_TXN whereColumns:@[] whereValues:@[] db:db error:errBlk];
+  [TLDBUtils deleteFromTable:TBL_FLUSH_BATCH whereColumns:@[] whereValues:@[] db:db error:errBlk];
+  [TLDBUtils deleteFromTable:TBL_TXN_ROLLUP whereColumns:@[] whereValues:@[] db:db error:errBlk];
+  [_storeEpoch advance];
+  [_metrics setNumBacklogEvents:0];
 }
 
 - (void)deleteTransactionsInTxn:(NSArray *)transactions
                           error:(TLDaoErrorBlk)errBlk {
+  [self waitUntilReady];
   [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
     [self deleteTransactions:transactions db:db error:errBlk];
   }];
@@ -233,98 +1003,875 @@ applied schema updates for version 0 (initial).");
 - (void)deleteTransactions:(NSArray *)transactions
                         db:(FMDatabase *)db
                      error:(TLDaoErrorBlk)errBlk {
+  NSString *stageTxnIdStmt = [NSString stringWithFormat:@"INSERT OR IGNORE INTO %@(%@) VALUES (?)",
+                              TBL_TEMP_TXN_ID, COL_TEMPTXNID_ID];
   for (TLTransaction *txn in transactions) {
-    [TLDBUtils deleteFromTable:TBL_TXN_LOG
-                  whereColumns:@[COL_TXNLOG_PARENT_TXN_ID]
-                   whereValues:@[[txn localId]]
-                            db:db
-                         error:errBlk];
-    [TLDBUtils deleteFromTable:TBL_TXN
-                  whereColumns:@[COL_TXN_ID]
-                   whereValues:@[[txn localId]]
-                            db:db
-                         error:errBlk];
+    [TLDBUtils doUpdate:stageTxnIdStmt argsArray:@[[txn localId]] db:db error:errBlk];
   }
+  [self deleteStagedTransactionsInDb:db numLogsDeleted:NULL error:errBlk];
+  [_storeEpoch advance];
+  [_metrics setNumBacklogEvents:[db longForQuery:[NSString stringWithFormat:@"SELECT COUNT(*) FROM %@",
+                                                  TBL_TXN_LOG]]];
+}
+
+- (NSUInteger)deleteStagedTransactionsInDb:(FMDatabase *)db
+                             numLogsDeleted:(NSUInteger *)numLogsDeleted
+                                      error:(TLDaoErrorBlk)errBlk {
+  // The transactions whose ids are staged in the temporary id table are
+  // deleted with a single statement; their logs go with them (ON DELETE
+  // CASCADE).  The table is emptied for the next use.
+  if (numLogsDeleted) {
+    // (rows deleted by a cascade don't count as changes)
+    *numLogsDeleted = (NSUInteger)[db longForQuery:[NSString stringWithFormat:@"SELECT COUNT(*) FROM %@ \
+                                                    WHERE %@ IN (SELECT %@ FROM %@)",
+                                                    TBL_TXN_LOG, COL_TXNLOG_PARENT_TXN_ID,
+                                                    COL_TEMPTXNID_ID, TBL_TEMP_TXN_ID]];
+  }
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"DELETE FROM %@ WHERE %@ IN (SELECT %@ FROM %@)",
+                       TBL_TXN, COL_TXN_ID, COL_TEMPTXNID_ID, TBL_TEMP_TXN_ID]
+                   db:db
+                error:errBlk];
+  NSUInteger numTxnsDeleted = (NSUInteger)[db changes];
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"DELETE FROM %@", TBL_TEMP_TXN_ID] db:db error:errBlk];
+  return numTxnsDeleted;
 }
 
 #pragma mark - Flush to Remote Store
 
-- (void)synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:(HCServerUnavailableBlk)unavailBlk {
+- (NSArray *)flushBatchTransactionsWhere:(NSString *)txnCondition
+                               whereArgs:(NSArray *)txnConditionArgs
+                            logWatermark:(long)logWatermark
+                                   limit:(NSUInteger)limit
+                         maxPayloadBytes:(NSUInteger)maxPayloadBytes
+                                  format:(TLTransactionSetFormat)format
+                                      db:(FMDatabase *)db
+                                   error:(TLDaoErrorBlk)errBlk
+                                    body:(NSData **)body {
+  // Transactions are encoded into the request body as they come off the
+  // cursor; only their (log-less) shells are retained.  A maxPayloadBytes of 0
+  // means no limit.
+  uint64_t startTime = TLLatencyClockNow();
+  NSMutableArray *transactions = [NSMutableArray array];
+  id<TLTransactionSetEncoder> writer;
+  if (format == TLTransactionSetFormatMessagePack) {
+    writer = [[TLTransactionSetMsgPackWriter alloc] init];
+  } else {
+    writer = [[TLTransactionSetWriter alloc] init];
+  }
+  [self enumerateTransactionsWhere:txnCondition
+                         whereArgs:txnConditionArgs
+                      logWatermark:logWatermark
+                             limit:limit
+                                db:db
+                    persistedEpoch:0
+                             error:errBlk
+                        usingBlock:^(TLTransaction *txn, BOOL *stop) {
+    [writer writeTransaction:txn];
+    if ([transactions count] > 0 && maxPayloadBytes > 0 && [writer length] > maxPayloadBytes) {
+      // this transaction will lead off the next batch
+      [writer discardLastTransaction];
+      *stop = YES;
+      return;
+    }
+    [txn setLogs:nil];
+    [transactions addObject:txn];
+  }];
+  *body = [writer finish];
+  [[_metrics serializationLatency] recordDurationSince:startTime];
+  return transactions;
+}
+
+- (TLFlushBatch *)nextFlushBatchWithFormat:(TLTransactionSetFormat)format
+                                        db:(FMDatabase *)db
+                                     error:(TLDaoErrorBlk)errBlk {
+  // The batch is the leading run of unleased transactions (in id order), along
+  // with their logs up to the log watermark: the max txn_log row id, in the
+  // snapshot the batch is read from, of those transactions' logs.  (Logs
+  // appended to them since get greater ids, as the batch's own logs are still
+  // in the table.)
+  NSData *body = nil;
+  NSArray *transactions =
+    [self flushBatchTransactionsWhere:[NSString stringWithFormat:@"%@ IS NULL", COL_TXN_FLUSH_BATCH_ID]
+                            whereArgs:@[]
+                         logWatermark:LONG_MAX
+                                limit:_maxTransactionsPerFlushBatch
+                      maxPayloadBytes:_maxFlushBatchPayloadBytes
+                               format:format
+                                   db:db
+                                error:errBlk
+                                 body:&body];
+  if ([transactions count] == 0) {
+    return nil;
+  }
+  TLFlushBatch *batch = [[TLFlushBatch alloc] init];
+  [batch setIdempotencyKey:[[NSUUID UUID] UUIDString]];
+  [batch setLogWatermark:[db longForQuery:[NSString stringWithFormat:@"SELECT COALESCE(MAX(l.%@), 0) \
+                                           FROM %@ l JOIN %@ t ON t.%@ = l.%@ \
+                                           WHERE t.%@ IS NULL AND t.%@ <= ?",
+                                           COL_TXNLOG_ID, TBL_TXN_LOG, TBL_TXN,
+                                           COL_TXN_ID, COL_TXNLOG_PARENT_TXN_ID,
+                                           COL_TXN_FLUSH_BATCH_ID, COL_TXN_ID],
+                          [[transactions lastObject] localId]]];
+  [batch setState:TLFlushBatchStateLeased];
+  [batch setTransactions:transactions];
+  [batch setBody:body];
+  return batch;
+}
+
+- (void)leaseFlushBatch:(TLFlushBatch *)batch
+                     db:(FMDatabase *)db
+                  error:(TLDaoErrorBlk)errBlk {
+  // The batch's transactions are leased by id rather than by range: since
+  // the batch was read, an earlier batch of this flush may have been
+  // acknowledged, releasing its transactions (those with logs appended since
+  // it was leased), and those logs are not in this batch's body.
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"INSERT INTO %@(%@, %@, %@, %@) VALUES (?, ?, ?, ?)",
+                       TBL_FLUSH_BATCH,
+                       COL_FLUSHBATCH_IDEMPOTENCY_KEY,
+                       COL_FLUSHBATCH_LOG_WATERMARK,
+                       COL_FLUSHBATCH_STATE,
+                       COL_FLUSHBATCH_CREATED_AT]
+            argsArray:@[[batch idempotencyKey],
+                        @([batch logWatermark]),
+                        @([batch state]),
+                        [NSDate date]]
+                   db:db
+                error:errBlk];
+  [batch setLocalId:@([db lastInsertRowId])];
+  NSString *stageTxnIdStmt = [NSString stringWithFormat:@"INSERT OR IGNORE INTO %@(%@) VALUES (?)",
+                              TBL_TEMP_TXN_ID, COL_TEMPTXNID_ID];
+  for (TLTransaction *txn in [batch transactions]) {
+    [TLDBUtils doUpdate:stageTxnIdStmt argsArray:@[[txn localId]] db:db error:errBlk];
+  }
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"UPDATE %@ SET %@ = ? WHERE %@ IS NULL AND %@ IN \
+                       (SELECT %@ FROM %@)",
+                       TBL_TXN, COL_TXN_FLUSH_BATCH_ID, COL_TXN_FLUSH_BATCH_ID, COL_TXN_ID,
+                       COL_TEMPTXNID_ID, TBL_TEMP_TXN_ID]
+            argsArray:@[[batch localId]]
+                   db:db
+                error:errBlk];
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"DELETE FROM %@", TBL_TEMP_TXN_ID] db:db error:errBlk];
+}
+
+- (NSMutableArray *)pendingFlushBatchesInDb:(FMDatabase *)db
+                                      error:(TLDaoErrorBlk)errBlk {
+  NSMutableArray *batches = [NSMutableArray array];
+  FMResultSet *rs = [TLDBUtils doQuery:[NSString stringWithFormat:@"SELECT %@, %@, %@, %@ FROM %@ ORDER BY %@",
+                                        COL_FLUSHBATCH_ID,
+                                        COL_FLUSHBATCH_IDEMPOTENCY_KEY,
+                                        COL_FLUSHBATCH_LOG_WATERMARK,
+                                        COL_FLUSHBATCH_STATE,
+                                        TBL_FLUSH_BATCH,
+                                        COL_FLUSHBATCH_ID]
+                             argsArray:@[]
+                                    db:db
+                                 error:errBlk];
+  while ([rs next]) {
+    TLFlushBatch *batch = [[TLFlushBatch alloc] init];
+    [batch setLocalId:@([rs longLongIntForColumnIndex:0])];
+    [batch setIdempotencyKey:[rs stringForColumnIndex:1]];
+    [batch setLogWatermark:[rs longForColumnIndex:2]];
+    [batch setState:[rs intForColumnIndex:3]];
+    [batches addObject:batch];
+  }
+  return batches;
+}
+
+- (void)loadFlushBatch:(TLFlushBatch *)batch
+                format:(TLTransactionSetFormat)format
+                    db:(FMDatabase *)db
+                 error:(TLDaoErrorBlk)errBlk {
+  NSData *body = nil;
+  [batch setTransactions:[self flushBatchTransactionsWhere:[NSString stringWithFormat:@"%@ = ?", COL_TXN_FLUSH_BATCH_ID]
+                                                 whereArgs:@[[batch localId]]
+                                              logWatermark:[batch logWatermark]
+                                                     limit:0
+                                           maxPayloadBytes:0
+                                                    format:format
+                                                        db:db
+                                                     error:errBlk
+                                                      body:&body]];
+  [batch setBody:body];
+}
+
+- (void)recordState:(TLFlushBatchState)state
+       ofFlushBatch:(TLFlushBatch *)batch
+              error:(TLDaoErrorBlk)errBlk {
   [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
-    TLDaoErrorBlk errorBlk = ^(NSError *err, int code, NSString *msg) {
-      NSLog(@"Local database error attempting to flush TLTransaction instances.  \
-Error code: [%d], error msg: [%@], error: [%@]", code, msg, err);
+    [TLDBUtils doUpdate:[NSString stringWithFormat:@"UPDATE %@ SET %@ = ? WHERE %@ = ?",
+                         TBL_FLUSH_BATCH, COL_FLUSHBATCH_STATE, COL_FLUSHBATCH_ID]
+              argsArray:@[@(state), [batch localId]]
+                     db:db
+                  error:errBlk];
+  }];
+  [batch setState:state];
+}
+
+- (void)deleteFlushBatch:(TLFlushBatch *)batch
+                      db:(FMDatabase *)db
+                   error:(TLDaoErrorBlk)errBlk {
+  // Only the logs that were part of the leased snapshot are removed; logs
+  // appended since stay behind (along with their parent transaction row, which
+  // is released from the batch) for the next flush.  A constant number of
+  // statements, whatever the size of the batch.
+  uint64_t startTime = TLLatencyClockNow();
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"DELETE FROM %@ WHERE %@ <= ? AND %@ IN \
+                       (SELECT %@ FROM %@ WHERE %@ = ?)",
+                       TBL_TXN_LOG, COL_TXNLOG_ID, COL_TXNLOG_PARENT_TXN_ID,
+                       COL_TXN_ID, TBL_TXN, COL_TXN_FLUSH_BATCH_ID]
+            argsArray:@[@([batch logWatermark]), [batch localId]]
+                   db:db
+                error:errBlk];
+  [_metrics addEventsFlushed:(NSUInteger)[db changes]];
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"DELETE FROM %@ WHERE %@ = ? AND NOT EXISTS \
+                       (SELECT 1 FROM %@ WHERE %@ = %@.%@)",
+                       TBL_TXN, COL_TXN_FLUSH_BATCH_ID,
+                       TBL_TXN_LOG, COL_TXNLOG_PARENT_TXN_ID, TBL_TXN, COL_TXN_ID]
+            argsArray:@[[batch localId]]
+                   db:db
+                error:errBlk];
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"UPDATE %@ SET %@ = NULL WHERE %@ = ?",
+                       TBL_TXN, COL_TXN_FLUSH_BATCH_ID, COL_TXN_FLUSH_BATCH_ID]
+            argsArray:@[[batch localId]]
+                   db:db
+                error:errBlk];
+  [TLDBUtils doUpdate:[NSString stringWithFormat:@"DELETE FROM %@ WHERE %@ = ?",
+                       TBL_FLUSH_BATCH, COL_FLUSHBATCH_ID]
+            argsArray:@[[batch localId]]
+                   db:db
+                error:errBlk];
+  [_storeEpoch advance];
+  [[_metrics cleanupLatency] recordDurationSince:startTime];
+}
+
+- (BOOL)flushBatch:(TLFlushBatch *)batch
+     continuesPast:(TLFlushBatchStep)step {
+  TLFlushBatchStepBlk flushBatchStepBlk = _flushBatchStepBlk;
+  if (!flushBatchStepBlk || flushBatchStepBlk(step, [batch idempotencyKey])) {
+    return YES;
+  }
+  DDLogDebug(@"Flush abandoned at step [%ld] of batch [%@].", (long)step, [batch idempotencyKey]);
+  return NO;
+}
+
+- (BOOL)postFlushBatchBody:(NSData *)body
+            idempotencyKey:(NSString *)idempotencyKey
+                    format:(TLTransactionSetFormat)format
+           numTransactions:(NSUInteger)numTransactions
+          unavailableError:(HCServerUnavailableBlk)unavailBlk {
+  __block BOOL acknowledged = NO;
+  HCPOSTSuccessBlk successBlk =
+    ^(NSURL *loc, id resModel, NSDate *lastModified, NSDictionary *rels, NSHTTPURLResponse *resp) {
+      acknowledged = YES;
     };
-    NSArray *transactions = [self allTransactionsWithDb:db error:errorBlk];
-    if ([transactions count] > 0) {
-      HCServerUnavailableBlk remoteStoreUnavailableBlk = ^(NSDate *retryAfter, NSHTTPURLResponse *resp) {
-        [[NSNotificationCenter defaultCenter] postNotificationName:TLTransactionSetFlushServerBusyNotification
-                                                            object:self
-                                                          userInfo:nil];
-        unavailBlk(retryAfter, resp);
-      };
-      HCPOSTSuccessBlk successBlk =
-        ^(NSURL *loc, id resModel, NSDate *lastModified, NSDictionary *rels, NSHTTPURLResponse *resp) {
-          [self deleteTransactions:transactions db:db error:errorBlk];
-          NSUInteger numFlushed = [transactions count];
-          DDLogDebug(@"[%ld] TLTransaction instances successfully flushed to remote \
-stored and removed from local store.", (unsigned long)numFlushed);
-          [[NSNotificationCenter defaultCenter] postNotificationName:TLTransactionSetFlushedSuccessfullyNotification
-                                                              object:self
-                                                            userInfo:@{TLNumTransactionsFlushedKey : @(numFlushed)}];
-        };
-      HCAuthReqdErrorBlk authRequiredBlk = ^(HCAuthentication *auth, NSHTTPURLResponse *resp) {
-        DDLogDebug(@"Authorization-required response received attempting to flush \
+  HCAuthReqdErrorBlk authRequiredBlk = ^(HCAuthentication *auth, NSHTTPURLResponse *resp) {
+    DDLogDebug(@"Authorization-required response received attempting to flush \
 TLTransaction instances.  Proceeding to null-out existing '_authToken' member.");
-        _authToken = nil;
-      };
-      DDLogDebug(@"Proceeding to flush app-transactions to remote store.  \
-Number of transaction instances: [%ld]", (unsigned long)[transactions count]);
-      [_relationExecutor
-       doPostForTargetResource:_txnStoreResource
-            resourceModelParam:transactions
-               paramSerializer:_txnSetSerializer
-      responseEntitySerializer:_txnSetSerializer
-                  asynchronous:NO
-               completionQueue:_serialQueue
-                 authorization:[HCAuthorization
-                                 authWithScheme:_authScheme
-                            singleAuthParamName:_authTokenParamName
-                                 authParamValue:[self authToken]]
-                       success:successBlk
-                   redirection:_redirectionBlk
-                   clientError:_clientErrorBlk
-        authenticationRequired:authRequiredBlk
-                   serverError:_serverErrorBlk
-              unavailableError:remoteStoreUnavailableBlk
-             connectionFailure:_connectionFailureBlk
-                       timeout:60
-                  otherHeaders:nil];
-    } else {
-      DDLogDebug(@"There are currently no app-transaction logs in need of flushing.");
+    _authToken = nil;
+  };
+  TLTransactionSetSerializer *serializer =
+    (format == TLTransactionSetFormatMessagePack) ? _msgPackTxnSetSerializer : _txnSetSerializer;
+  NSMutableDictionary *otherHeaders = [NSMutableDictionary dictionaryWithObject:idempotencyKey
+                                                                         forKey:@"Idempotency-Key"];
+  BOOL compressed = NO;
+  if (_compressesFlushPayloads && [body length] >= _minCompressibleFlushPayloadBytes) {
+    NSData *compressedBody = [TLCompressionUtils gzipData:body level:Z_DEFAULT_COMPRESSION];
+    if (compressedBody) {
+      body = compressedBody;
+      otherHeaders[@"Content-Encoding"] = @"gzip";
+      compressed = YES;
+    }
+  }
+  DDLogDebug(@"Proceeding to flush app-transactions to remote store.  \
+Number of transaction instances: [%ld], body length: [%ld], compressed: [%@], \
+idempotency key: [%@]",
+             (unsigned long)numTransactions, (unsigned long)[body length],
+             compressed ? @"YES" : @"NO", idempotencyKey);
+  uint64_t startTime = TLLatencyClockNow();
+  [_relationExecutor
+   doPostForTargetResource:_txnStoreResource
+        resourceModelParam:body
+           paramSerializer:serializer
+  responseEntitySerializer:serializer
+              asynchronous:NO
+           completionQueue:_serialQueue
+             authorization:[HCAuthorization
+                             authWithScheme:_authScheme
+                        singleAuthParamName:_authTokenParamName
+                             authParamValue:[self authToken]]
+                   success:successBlk
+               redirection:_redirectionBlk
+               clientError:_clientErrorBlk
+    authenticationRequired:authRequiredBlk
+               serverError:_serverErrorBlk
+          unavailableError:unavailBlk
+         connectionFailure:_connectionFailureBlk
+                   timeout:60
+              otherHeaders:otherHeaders];
+  [[_metrics httpRoundTripLatency] recordDurationSince:startTime];
+  return acknowledged;
+}
+
+- (void)synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:(HCServerUnavailableBlk)unavailBlk {
+  [self flushTxnsToRemoteStoreWithRemoteStoreBusyBlock:unavailBlk];
+}
+
+- (TLFlushOutcome)flushTxnsToRemoteStoreWithRemoteStoreBusyBlock:(HCServerUnavailableBlk)unavailBlk {
+  TLDaoErrorBlk errorBlk = ^(NSError *err, int code, NSString *msg) {
+    NSLog(@"Local database error attempting to flush TLTransaction instances.  \
+Error code: [%d], error msg: [%@], error: [%@]", code, msg, err);
+  };
+
+  [self waitUntilReady];
+  [self persistRollupsWithError:errorBlk];
+
+  [_writeBehindBuffer sync];
+
+  // The in-memory lease covers the whole flush; it simply prevents a
+  // concurrent flush (or eviction) from picking up the rows being flushed.
+  // Each batch's rows are in turn leased to the batch in the local store, so
+  // that a flush cut short by the app being killed is picked up where it left
+  // off.
+  if (atomic_exchange(&_flushLeaseHeld, true)) {
+    DDLogDebug(@"Skipping flush of TLTransaction instances; a previous flush is \
+still in progress.");
+    return TLFlushOutcomeSkipped;
+  }
+
+  // Batches are pipelined: while up to maxConcurrentFlushRequests batches are
+  // on the wire, the next batch is leased and encoded.  Batches left over from
+  // an earlier flush go first, with their original rows and idempotency keys.
+  // Each batch is deleted as soon as it is acknowledged; once any batch is not
+  // acknowledged, no further batches are started.
+  TLTransactionSetFormat format = _flushPayloadFormat;
+  dispatch_semaphore_t requestSlots = dispatch_semaphore_create(MAX(_maxConcurrentFlushRequests, 1));
+  dispatch_group_t requestsInFlight = dispatch_group_create();
+  dispatch_queue_t resultsQueue = dispatch_queue_create("PEAppTransaction-Logger.apptxnlogging.flushresults",
+                                                        DISPATCH_QUEUE_SERIAL);
+  __block BOOL halted = NO;
+  __block BOOL remoteStoreBusy = NO;
+  __block NSDate *busyRetryAfter = nil;
+  __block NSHTTPURLResponse *busyResponse = nil;
+  __block NSUInteger numBatchesFlushed = 0;
+  __block NSUInteger totalNumFlushed = 0;
+  __block NSMutableArray *pendingBatches = nil;
+  [self inReadTransaction:^(FMDatabase *db) {
+    pendingBatches = [self pendingFlushBatchesInDb:db error:errorBlk];
+  }];
+  NSUInteger numBatchesStarted = 0;
+  while (YES) {
+    // Phase 1: take the next left-over batch, or read and lease a new one.
+    // The batch is read (and serialized) from a snapshot, which, under the
+    // performance database profile, does not hold up logging; only the
+    // clean-up and lease that follow take the write lock.
+    __block TLFlushBatch *batch = nil;
+    __block BOOL newlyLeased = NO;
+    NSMutableArray *spentBatches = [NSMutableArray array];
+    [self inReadTransaction:^(FMDatabase *db) {
+      while (!batch && [pendingBatches count] > 0) {
+        TLFlushBatch *pendingBatch = pendingBatches[0];
+        [pendingBatches removeObjectAtIndex:0];
+        if ([pendingBatch state] != TLFlushBatchStateAcknowledged) {
+          [self loadFlushBatch:pendingBatch format:format db:db error:errorBlk];
+          if ([[pendingBatch transactions] count] > 0) {
+            DDLogDebug(@"Re-sending flush batch [%@] left over from an earlier flush.",
+                       [pendingBatch idempotencyKey]);
+            batch = pendingBatch;
+            break;
+          }
+        }
+        // acknowledged (or evicted) already; all that is left is the clean-up
+        [spentBatches addObject:pendingBatch];
+      }
+      if (!batch) {
+        batch = [self nextFlushBatchWithFormat:format db:db error:errorBlk];
+        newlyLeased = (batch != nil);
+      }
+    }];
+    if ([spentBatches count] > 0 || newlyLeased) {
+      [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+        for (TLFlushBatch *spentBatch in spentBatches) {
+          [self deleteFlushBatch:spentBatch db:db error:errorBlk];
+        }
+        if (newlyLeased) {
+          [self leaseFlushBatch:batch db:db error:errorBlk];
+        }
+      }];
+    }
+    if (!batch) {
+      if (numBatchesStarted == 0) {
+        DDLogDebug(@"There are currently no app-transaction logs in need of flushing.");
+      }
+      break;
+    }
+    if (newlyLeased && ![self flushBatch:batch continuesPast:TLFlushBatchStepLeased]) {
+      dispatch_sync(resultsQueue, ^{ halted = YES; });
+      break;
+    }
+    dispatch_semaphore_wait(requestSlots, DISPATCH_TIME_FOREVER);
+    __block BOOL stop = NO;
+    dispatch_sync(resultsQueue, ^{ stop = halted; });
+    if (stop) {
+      dispatch_semaphore_signal(requestSlots);
+      break;
+    }
+    numBatchesStarted++;
+
+    // Phase 2: POST the batch with no database lock held, so that loggers are
+    // free to proceed while the request is on the wire.
+    dispatch_group_async(requestsInFlight, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+      __block BOOL batchRemoteStoreBusy = NO;
+      __block NSDate *batchRetryAfter = nil;
+      __block NSHTTPURLResponse *batchBusyResponse = nil;
+      NSUInteger numTransactions = [[batch transactions] count];
+      BOOL acknowledged = NO;
+      BOOL deleted = NO;
+      [self recordState:TLFlushBatchStateSent ofFlushBatch:batch error:errorBlk];
+      if ([self flushBatch:batch continuesPast:TLFlushBatchStepSent]) {
+        acknowledged = [self postFlushBatchBody:[batch body]
+                                 idempotencyKey:[batch idempotencyKey]
+                                         format:format
+                                numTransactions:numTransactions
+                               unavailableError:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {
+                                 batchRemoteStoreBusy = YES;
+                                 batchRetryAfter = retryAfter;
+                                 batchBusyResponse = resp;
+                               }];
+      }
+
+      // Phase 3: on acknowledgement, record it, then delete the batch's rows.
+      if (acknowledged && [self flushBatch:batch continuesPast:TLFlushBatchStepPosted]) {
+        [self recordState:TLFlushBatchStateAcknowledged ofFlushBatch:batch error:errorBlk];
+        if ([self flushBatch:batch continuesPast:TLFlushBatchStepAcknowledged]) {
+          [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+            [self deleteFlushBatch:batch db:db error:errorBlk];
+          }];
+          deleted = YES;
+        }
+      }
+      [batch setBody:nil];
+      __block NSUInteger batchNumber = 0;
+      __block NSUInteger totalSoFar = 0;
+      dispatch_sync(resultsQueue, ^{
+        if (deleted) {
+          batchNumber = ++numBatchesFlushed;
+          totalNumFlushed += numTransactions;
+          totalSoFar = totalNumFlushed;
+        } else {
+          halted = YES;
+          [_metrics addFlushBatchFailed];
+          if (batchRemoteStoreBusy) {
+            remoteStoreBusy = YES;
+            busyRetryAfter = busyRetryAfter ? [busyRetryAfter laterDate:batchRetryAfter] : batchRetryAfter;
+            busyResponse = batchBusyResponse;
+          }
+        }
+      });
+      if (deleted) {
+        DDLogDebug(@"[%ld] TLTransaction instances successfully flushed to remote \
+stored and removed from local store (batch [%ld], [%ld] flushed in total).",
+                   (unsigned long)numTransactions, (unsigned long)batchNumber,
+                   (unsigned long)totalSoFar);
+        [[NSNotificationCenter defaultCenter] postNotificationName:TLTransactionSetFlushedSuccessfullyNotification
+                                                            object:self
+                                                          userInfo:@{TLNumTransactionsFlushedKey : @(numTransactions),
+                                                                     TLTotalNumTransactionsFlushedKey : @(totalSoFar),
+                                                                     TLFlushBatchNumberKey : @(batchNumber)}];
+      }
+      dispatch_semaphore_signal(requestSlots);
+    });
+  }
+  dispatch_group_wait(requestsInFlight, DISPATCH_TIME_FOREVER);
+
+  // Phase 4: the rollups of closed windows follow the transactions.
+  TLFlushOutcome rollupOutcome = TLFlushOutcomeNothingToFlush;
+  if (!halted) {
+    rollupOutcome = [self flushRollupsWithFormat:format
+                                unavailableError:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {
+                                  remoteStoreBusy = YES;
+                                  busyRetryAfter = retryAfter;
+                                  busyResponse = resp;
+                                }
+                                           error:errorBlk];
+  }
+
+  atomic_store(&_flushLeaseHeld, false);
+  if (remoteStoreBusy) {
+    [[NSNotificationCenter defaultCenter] postNotificationName:TLTransactionSetFlushServerBusyNotification
+                                                        object:self
+                                                      userInfo:nil];
+    unavailBlk(busyRetryAfter, busyResponse);
+    return TLFlushOutcomeRemoteStoreBusy;
+  }
+  if (halted || rollupOutcome == TLFlushOutcomeFailed) {
+    return TLFlushOutcomeFailed;
+  }
+  return (numBatchesStarted == 0 && rollupOutcome == TLFlushOutcomeNothingToFlush) ?
+    TLFlushOutcomeNothingToFlush : TLFlushOutcomeFlushed;
+}
+
+#pragma mark - Rollups
+
+- (NSString *)jsonOfCounts:(NSDictionary *)counts {
+  NSData *json = [NSJSONSerialization dataWithJSONObject:[TLTransactionRollup pairsOfCounts:counts]
+                                                 options:0
+                                                   error:nil];
+  return [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding];
+}
+
+- (NSDictionary *)countsOfJson:(NSString *)json {
+  NSData *data = [json dataUsingEncoding:NSUTF8StringEncoding];
+  if (!data) {
+    return @{};
+  }
+  id pairs = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+  return [TLTransactionRollup countsOfPairs:([pairs isKindOfClass:[NSArray class]] ? pairs : @[])];
+}
+
+- (NSArray *)rollupsWhere:(NSString *)condition
+                whereArgs:(NSArray *)conditionArgs
+                       db:(FMDatabase *)db
+                    error:(TLDaoErrorBlk)errorBlk {
+  NSMutableArray *rollups = [NSMutableArray array];
+  FMResultSet *rs = [TLDBUtils doQuery:[NSString stringWithFormat:@"SELECT %@, %@, %@, %@, %@, %@, %@, %@, %@ \
+                                        FROM %@ WHERE %@ ORDER BY %@",
+                                        COL_TXNROLLUP_ID,
+                                        COL_TXNROLLUP_USECASE,
+                                        COL_TXNROLLUP_WINDOW_START,
+                                        COL_TXNROLLUP_WINDOW_DURATION,
+                                        COL_TXNROLLUP_NUM_TXNS,
+                                        COL_TXNROLLUP_NUM_EVENTS,
+                                        COL_TXNROLLUP_EVENT_COUNTS,
+                                        COL_TXNROLLUP_ERR_CODE_COUNTS,
+                                        COL_TXNROLLUP_DURATION_HISTOGRAM,
+                                        TBL_TXN_ROLLUP, condition, COL_TXNROLLUP_ID]
+                             argsArray:conditionArgs
+                                    db:db
+                                 error:errorBlk];
+  while ([rs next]) {
+    TLTransactionRollup *rollup =
+      [[TLTransactionRollup alloc] initWithUsecase:@([rs intForColumnIndex:1])
+                                       windowStart:[rs dateForColumnIndex:2]
+                                    windowDuration:[rs doubleForColumnIndex:3]
+                                   numTransactions:(NSUInteger)[rs longLongIntForColumnIndex:4]
+                                         numEvents:(NSUInteger)[rs longLongIntForColumnIndex:5]
+                                       eventCounts:[self countsOfJson:[rs stringForColumnIndex:6]]
+                                     errCodeCounts:[self countsOfJson:[rs stringForColumnIndex:7]]
+                                 durationHistogram:[self countsOfJson:[rs stringForColumnIndex:8]]];
+    [rollup setLocalId:@([rs longLongIntForColumnIndex:0])];
+    [rollups addObject:rollup];
+  }
+  [rs close];
+  return rollups;
+}
+
+- (void)persistRollupsWithError:(TLDaoErrorBlk)errorBlk {
+  NSArray *rollups = [_rollupAggregator drainRollups];
+  if ([rollups count] == 0) {
+    return;
+  }
+  [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+    for (TLTransactionRollup *rollup in rollups) {
+      [self persistRollup:rollup db:db error:errorBlk];
     }
   }];
 }
 
+- (void)persistRollup:(TLTransactionRollup *)rollup
+                   db:(FMDatabase *)db
+                error:(TLDaoErrorBlk)errorBlk {
+  // A rollup is merged into the stored one of its use case and window, unless
+  // that one is leased to a flush (in which case it gets a row of its own).
+  NSString *condition = [NSString stringWithFormat:@"%@ = ? AND %@ = ? AND %@ = ? AND %@ IS NULL",
+                         COL_TXNROLLUP_USECASE, COL_TXNROLLUP_WINDOW_START,
+                         COL_TXNROLLUP_WINDOW_DURATION, COL_TXNROLLUP_FLUSH_KEY];
+  TLTransactionRollup *storedRollup =
+    [[self rollupsWhere:condition
+              whereArgs:@[[rollup usecase], [rollup windowStart], @([rollup windowDuration])]
+                     db:db
+                  error:errorBlk] firstObject];
+  if (storedRollup) {
+    [storedRollup mergeRollup:rollup];
+    [TLDBUtils doUpdate:[NSString stringWithFormat:@"UPDATE %@ SET %@ = ?, %@ = ?, %@ = ?, %@ = ?, %@ = ? WHERE %@ = ?",
+                         TBL_TXN_ROLLUP,
+                         COL_TXNROLLUP_NUM_TXNS,
+                         COL_TXNROLLUP_NUM_EVENTS,
+                         COL_TXNROLLUP_EVENT_COUNTS,
+                         COL_TXNROLLUP_ERR_CODE_COUNTS,
+                         COL_TXNROLLUP_DURATION_HISTOGRAM,
+                         COL_TXNROLLUP_ID]
+              argsArray:@[@([storedRollup numTransactions]),
+                          @([storedRollup numEvents]),
+                          [self jsonOfCounts:[storedRollup eventCounts]],
+                          [self jsonOfCounts:[storedRollup errCodeCounts]],
+                          [self jsonOfCounts:[storedRollup durationHistogram]],
+                          [storedRollup localId]]
+                     db:db
+                  error:errorBlk];
+  } else {
+    [TLDBUtils doUpdate:[NSString stringWithFormat:@"INSERT INTO %@ (%@, %@, %@, %@, %@, %@, %@, %@) \
+                         VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+                         TBL_TXN_ROLLUP,
+                         COL_TXNROLLUP_USECASE,
+                         COL_TXNROLLUP_WINDOW_START,
+                         COL_TXNROLLUP_WINDOW_DURATION,
+                         COL_TXNROLLUP_NUM_TXNS,
+                         COL_TXNROLLUP_NUM_EVENTS,
+                         COL_TXNROLLUP_EVENT_COUNTS,
+                         COL_TXNROLLUP_ERR_CODE_COUNTS,
+                         COL_TXNROLLUP_DURATION_HISTOGRAM]
+              argsArray:@[[rollup usecase],
+                          [rollup windowStart],
+                          @([rollup windowDuration]),
+                          @([rollup numTransactions]),
+                          @([rollup numEvents]),
+                          [self jsonOfCounts:[rollup eventCounts]],
+                          [self jsonOfCounts:[rollup errCodeCounts]],
+                          [self jsonOfCounts:[rollup durationHistogram]]]
+                     db:db
+                  error:errorBlk];
+  }
+}
+
+- (TLFlushOutcome)flushRollupsWithFormat:(TLTransactionSetFormat)format
+                        unavailableError:(HCServerUnavailableBlk)unavailBlk
+                                   error:(TLDaoErrorBlk)errorBlk {
+  // The rollups of closed windows are leased under a flush key, which doubles
+  // as the request's idempotency key; rollups left leased by an earlier flush
+  // go first, under their original key.  The rollups are sent as a transaction
+  // set with no transactions, and deleted once acknowledged.
+  __block NSString *flushKey = nil;
+  __block NSArray *rollups = nil;
+  NSUInteger maxRollups = MAX(_maxTransactionsPerFlushBatch, 1);
+  [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+    flushKey = [db stringForQuery:[NSString stringWithFormat:@"SELECT %@ FROM %@ WHERE %@ IS NOT NULL LIMIT 1",
+                                   COL_TXNROLLUP_FLUSH_KEY, TBL_TXN_ROLLUP, COL_TXNROLLUP_FLUSH_KEY]];
+    if (!flushKey) {
+      NSString *newFlushKey = [[NSUUID UUID] UUIDString];
+      [TLDBUtils doUpdate:[NSString stringWithFormat:@"UPDATE %@ SET %@ = ? WHERE %@ IN \
+                           (SELECT %@ FROM %@ WHERE %@ IS NULL AND %@ + %@ <= ? ORDER BY %@ LIMIT ?)",
+                           TBL_TXN_ROLLUP, COL_TXNROLLUP_FLUSH_KEY, COL_TXNROLLUP_ID,
+                           COL_TXNROLLUP_ID, TBL_TXN_ROLLUP, COL_TXNROLLUP_FLUSH_KEY,
+                           COL_TXNROLLUP_WINDOW_START, COL_TXNROLLUP_WINDOW_DURATION,
+                           COL_TXNROLLUP_WINDOW_START]
+                argsArray:@[newFlushKey, @([[NSDate date] timeIntervalSince1970]), @(maxRollups)]
+                       db:db
+                    error:errorBlk];
+      if ([db changes] > 0) {
+        flushKey = newFlushKey;
+      }
+    }
+    if (flushKey) {
+      rollups = [self rollupsWhere:[NSString stringWithFormat:@"%@ = ?", COL_TXNROLLUP_FLUSH_KEY]
+                         whereArgs:@[flushKey]
+                                db:db
+                             error:errorBlk];
+    }
+  }];
+  if ([rollups count] == 0) {
+    return TLFlushOutcomeNothingToFlush;
+  }
+  uint64_t startTime = TLLatencyClockNow();
+  id<TLTransactionSetEncoder> writer;
+  if (format == TLTransactionSetFormatMessagePack) {
+    writer = [[TLTransactionSetMsgPackWriter alloc] init];
+  } else {
+    writer = [[TLTransactionSetWriter alloc] init];
+  }
+  [writer writeRollups:rollups];
+  NSData *body = [writer finish];
+  [[_metrics serializationLatency] recordDurationSince:startTime];
+  BOOL acknowledged = [self postFlushBatchBody:body
+                                idempotencyKey:flushKey
+                                        format:format
+                               numTransactions:0
+                              unavailableError:unavailBlk];
+  if (!acknowledged) {
+    [_metrics addFlushBatchFailed];
+    return TLFlushOutcomeFailed;
+  }
+  [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+    [TLDBUtils deleteFromTable:TBL_TXN_ROLLUP
+                  whereColumns:@[COL_TXNROLLUP_FLUSH_KEY]
+                   whereValues:@[flushKey]
+                            db:db
+                         error:errorBlk];
+  }];
+  DDLogDebug(@"[%ld] transaction rollups successfully flushed to remote store \
+and removed from local store.", (unsigned long)[rollups count]);
+  return TLFlushOutcomeFlushed;
+}
+
 #pragma mark - Timed Asynchronous Flush to Remote Store
 
 - (void)asynchronousFlushTxnsToRemoteStore:(NSTimer *)timer {
-  if (_authToken) {
-    if (_txnStoreResource) {
-      dispatch_async(_serialQueue, ^{
-        HCServerUnavailableBlk remoteStoreUnavailableBlk = ^(NSDate *retryAfter, NSHTTPURLResponse *resp) {
-          [timer setFireDate:[[timer fireDate] laterDate:retryAfter]];
-        };
-        [self synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:remoteStoreUnavailableBlk];
-      });
-    } else {
-      DDLogDebug(@"Skipping flush of TLTransaction instances to remote \
-server due to having a nil transaction store hypermedia resource.");
+  [_flushScheduler requestFlush];
+}
+
+#pragma mark - Scheduled Flush to Remote Store
+
+- (void)backlogNumLogs:(NSUInteger *)numLogs
+    oldestLogTimestamp:(NSDate **)oldestLogTimestamp {
+  __block NSUInteger numStoredLogs = 0;
+  __block NSDate *oldestStoredLogTimestamp = nil;
+  [self inReadTransaction:^(FMDatabase *db) {
+    FMResultSet *rs = [db executeQuery:[NSString stringWithFormat:@"SELECT COUNT(*), MIN(%@) FROM %@",
+                                        COL_TXNLOG_TIMESTAMP, TBL_TXN_LOG]];
+    if ([rs next]) {
+      numStoredLogs = (NSUInteger)[rs longForColumnIndex:0];
+      oldestStoredLogTimestamp = [rs columnIndexIsNull:1] ? nil : [rs dateForColumnIndex:1];
     }
-  } else {
+    [rs close];
+    // so are the stored rollups whose windows have closed (each counting for
+    // at least one log, so that one of event-less transactions still counts)
+    rs = [db executeQuery:[NSString stringWithFormat:@"SELECT SUM(MAX(%@, 1)), MIN(%@) FROM %@ WHERE %@ + %@ <= ?",
+                           COL_TXNROLLUP_NUM_EVENTS, COL_TXNROLLUP_WINDOW_START, TBL_TXN_ROLLUP,
+                           COL_TXNROLLUP_WINDOW_START, COL_TXNROLLUP_WINDOW_DURATION]
+      withArgumentsInArray:@[@([[NSDate date] timeIntervalSince1970])]];
+    if ([rs next] && ![rs columnIndexIsNull:1]) {
+      numStoredLogs += (NSUInteger)[rs longForColumnIndex:0];
+      NSDate *oldestWindowStart = [rs dateForColumnIndex:1];
+      if (!oldestStoredLogTimestamp || [oldestWindowStart compare:oldestStoredLogTimestamp] == NSOrderedAscending) {
+        oldestStoredLogTimestamp = oldestWindowStart;
+      }
+    }
+    [rs close];
+  }];
+  // logs still in the write-behind buffer are part of the backlog too
+  *numLogs = numStoredLogs + [_writeBehindBuffer pendingCount];
+  *oldestLogTimestamp = oldestStoredLogTimestamp;
+}
+
+- (TLFlushOutcome)scheduledFlushWithRetryAfter:(NSDate **)retryAfter {
+  TLFlushOutcome outcome = TLFlushOutcomeSkipped;
+  if (!_authToken) {
     DDLogDebug(@"Skipping flush of TLTransaction instances to remote \
 server due to having a nil authentication token.");
+  } else if (!_txnStoreResource) {
+    DDLogDebug(@"Skipping flush of TLTransaction instances to remote \
+server due to having a nil transaction store hypermedia resource.");
+  } else {
+    __block NSDate *busyRetryAfter = nil;
+    outcome = [self flushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfterDate, NSHTTPURLResponse *resp) {
+      busyRetryAfter = retryAfterDate;
+    }];
+    *retryAfter = busyRetryAfter;
   }
+  // whether or not the flush could proceed, the local store must stay bounded
+  [self enforceStorageQuota];
+  return outcome;
+}
+
+#pragma mark - Metrics
+
+- (TLMetricsSnapshot *)metricsSnapshot {
+  // the data file, plus its write-ahead log if there is one
+  NSFileManager *fileMgr = [NSFileManager defaultManager];
+  NSString *dataFilePath = [_databaseQueue path];
+  if ([dataFilePath hasPrefix:@"file:"]) {
+    // (SQLite takes URI filenames, e.g., the absoluteString of a file URL)
+    dataFilePath = [[NSURL URLWithString:dataFilePath] path];
+  }
+  unsigned long long dataFileBytes = 0;
+  for (NSString *path in @[dataFilePath, [dataFilePath stringByAppendingString:@"-wal"]]) {
+    dataFileBytes += [[fileMgr attributesOfItemAtPath:path error:nil] fileSize];
+  }
+  return [_metrics snapshotWithDataFileBytes:dataFileBytes];
+}
+
+#pragma mark - Storage Quota
+
+- (void)enforceStorageQuota {
+  if (_maxStoredTransactionLogs == 0 && _maxStoreBytes == 0) {
+    return;
+  }
+  dispatch_async(_serialQueue, ^{
+    [self evictBatchIfOverQuotaContinuing:NO];
+  });
+}
+
+- (BOOL)storeExceedsFraction:(double)fraction
+                 ofQuotaInDb:(FMDatabase *)db {
+  if (_maxStoredTransactionLogs > 0) {
+    long numLogs = [db longForQuery:[NSString stringWithFormat:@"SELECT COUNT(*) FROM %@", TBL_TXN_LOG]];
+    if (numLogs > _maxStoredTransactionLogs * fraction) {
+      return YES;
+    }
+  }
+  if (_maxStoreBytes > 0) {
+    // pages on the freelist are free for reuse, so don't count against the quota
+    long numPagesInUse = [db longForQuery:@"PRAGMA page_count"] - [db longForQuery:@"PRAGMA freelist_count"];
+    unsigned long long numBytesInUse = (unsigned long long)numPagesInUse * [db longForQuery:@"PRAGMA page_size"];
+    if (numBytesInUse > _maxStoreBytes * fraction) {
+      return YES;
+    }
+  }
+  return NO;
+}
+
+- (void)stageEvictionCandidatesWithLimit:(NSUInteger)limit
+                                      db:(FMDatabase *)db
+                                   error:(TLDaoErrorBlk)errBlk {
+  // Oldest first, with the transactions having an error log sorted last.
+  NSString *stmt = [NSString stringWithFormat:@"INSERT OR IGNORE INTO %@(%@) SELECT t.%@ FROM %@ t \
+                    ORDER BY EXISTS (SELECT 1 FROM %@ l WHERE l.%@ = t.%@ AND l.%@ IS NOT NULL), t.%@ \
+                    LIMIT ?",
+                    TBL_TEMP_TXN_ID, COL_TEMPTXNID_ID,
+                    COL_TXN_ID, TBL_TXN,
+                    TBL_TXN_LOG, COL_TXNLOG_PARENT_TXN_ID, COL_TXN_ID, COL_TXNLOG_IN_CTX_ERR_CODE,
+                    COL_TXN_ID];
+  [TLDBUtils doUpdate:stmt argsArray:@[@(limit)] db:db error:errBlk];
+}
+
+- (void)evictBatchIfOverQuotaContinuing:(BOOL)continuing {
+  TLDaoErrorBlk errorBlk = ^(NSError *err, int code, NSString *msg) {
+    NSLog(@"Local database error attempting to evict TLTransaction instances.  \
+Error code: [%d], error msg: [%@], error: [%@]", code, msg, err);
+  };
+  __block NSUInteger numTxnsEvicted = 0;
+  __block NSUInteger numLogsEvicted = 0;
+  [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+    if (atomic_load(&_flushLeaseHeld)) {
+      // the rows may be in flight; the next quota check will pick up from here
+      return;
+    }
+    // Once eviction has started, it continues down to 90% of the quota, so
+    // that it isn't immediately triggered again.
+    if (![self storeExceedsFraction:(continuing ? 0.9 : 1.0) ofQuotaInDb:db]) {
+      return;
+    }
+    uint64_t startTime = TLLatencyClockNow();
+    [self stageEvictionCandidatesWithLimit:MAX(_evictionBatchSize, 1) db:db error:errorBlk];
+    numTxnsEvicted = [self deleteStagedTransactionsInDb:db numLogsDeleted:&numLogsEvicted error:errorBlk];
+    if (numTxnsEvicted > 0) {
+      [_storeEpoch advance];
+      [[_metrics cleanupLatency] recordDurationSince:startTime];
+    }
+  }];
+  if (numTxnsEvicted == 0) {
+    return;
+  }
+  _evictedTransactionCount += numTxnsEvicted;
+  _evictedTransactionLogCount += numLogsEvicted;
+  [_metrics addEventsEvicted:numLogsEvicted];
+  DDLogDebug(@"Local store over quota; evicted [%ld] TLTransaction instances \
+([%ld] logs).  Evicted in total: [%ld] transactions, [%ld] logs.",
+             (unsigned long)numTxnsEvicted, (unsigned long)numLogsEvicted,
+             (unsigned long)_evictedTransactionCount, (unsigned long)_evictedTransactionLogCount);
+  [[NSNotificationCenter defaultCenter] postNotificationName:TLTransactionsEvictedNotification
+                                                      object:self
+                                                    userInfo:@{TLNumTransactionsEvictedKey : @(numTxnsEvicted),
+                                                               TLNumTransactionLogsEvictedKey : @(numLogsEvicted)}];
+  // re-queue (rather than loop), so that other queued work is interleaved
+  dispatch_async(_serialQueue, ^{
+    [self evictBatchIfOverQuotaContinuing:YES];
+  });
+}
+
+#pragma mark - NSObject overrides
+
+- (void)dealloc {
+  [[NSNotificationCenter defaultCenter] removeObserver:self];
 }
 
 @end
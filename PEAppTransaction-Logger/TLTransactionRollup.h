@@ -0,0 +1,142 @@
+//
+//  TLTransactionRollup.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The statistics of the transactions of one use case over one time window:
+ * transaction and event counts, the frequency of each use case event and of
+ * each in-context error code, and a histogram of the time between consecutive
+ * events of a transaction.  Rollups of the same use case and window merge by
+ * simple addition, so partial rollups (e.g., one in memory and one in the
+ * local store) can be combined at any point.
+ */
+@interface TLTransactionRollup : NSObject
+
+#pragma mark - Initializers
+
+/**
+ * Initializes a new, empty instance.
+ * @param usecase        The use case.
+ * @param windowStart    The start of the window.
+ * @param windowDuration The length of the window, in seconds.
+ * @return The initialized instance.
+ */
+- (id)initWithUsecase:(NSNumber *)usecase
+          windowStart:(NSDate *)windowStart
+       windowDuration:(NSTimeInterval)windowDuration;
+
+/**
+ * Initializes a new instance with the given statistics (e.g., as read from
+ * the local store).
+ * @param usecase           The use case.
+ * @param windowStart       The start of the window.
+ * @param windowDuration    The length of the window, in seconds.
+ * @param numTransactions   The number of transactions.
+ * @param numEvents         The number of events.
+ * @param eventCounts       Counts by use case event.
+ * @param errCodeCounts     Counts by in-context error code.
+ * @param durationHistogram Counts by duration bucket (see durationHistogram).
+ * @return The initialized instance.
+ */
+- (id)initWithUsecase:(NSNumber *)usecase
+          windowStart:(NSDate *)windowStart
+       windowDuration:(NSTimeInterval)windowDuration
+      numTransactions:(NSUInteger)numTransactions
+            numEvents:(NSUInteger)numEvents
+          eventCounts:(NSDictionary *)eventCounts
+        errCodeCounts:(NSDictionary *)errCodeCounts
+    durationHistogram:(NSDictionary *)durationHistogram;
+
+#pragma mark - Recording
+
+/** Counts a new transaction. */
+- (void)addTransaction;
+
+/**
+ * Counts an event.
+ * @param usecaseEvent       The use case event.
+ * @param inContextErrCode   The in-context error code of the event (may be
+ * nil).
+ * @param sincePreviousEvent The time, in seconds, since the previous event of
+ * the same transaction; negative if the event is its transaction's first.
+ */
+- (void)addEventWithUsecaseEvent:(NSNumber *)usecaseEvent
+                inContextErrCode:(NSNumber *)inContextErrCode
+              sincePreviousEvent:(NSTimeInterval)sincePreviousEvent;
+
+/**
+ * Adds the statistics of the given rollup (of the same use case and window) to
+ * this one.
+ * @param rollup The rollup to merge in.
+ */
+- (void)mergeRollup:(TLTransactionRollup *)rollup;
+
+#pragma mark - Count Pairs
+
+/**
+ * @return The given counts as an array of [key, count] pairs, in key order
+ * (the form in which counts are stored and sent).
+ */
++ (NSArray *)pairsOfCounts:(NSDictionary *)counts;
+
+/**
+ * @return The counts of the given array of [key, count] pairs.
+ */
++ (NSDictionary *)countsOfPairs:(NSArray *)pairs;
+
+#pragma mark - Properties
+
+/** Local identifier used for locally storing this rollup. */
+@property (nonatomic) NSNumber *localId;
+
+/** The use case. */
+@property (nonatomic, readonly) NSNumber *usecase;
+
+/** The start of the window. */
+@property (nonatomic, readonly) NSDate *windowStart;
+
+/** The length of the window, in seconds. */
+@property (nonatomic, readonly) NSTimeInterval windowDuration;
+
+/** The number of transactions begun in the window. */
+@property (nonatomic, readonly) NSUInteger numTransactions;
+
+/** The number of events logged in the window. */
+@property (nonatomic, readonly) NSUInteger numEvents;
+
+/** Event counts, keyed by use case event. */
+@property (nonatomic, readonly) NSDictionary *eventCounts;
+
+/** Event counts, keyed by in-context error code (events with one only). */
+@property (nonatomic, readonly) NSDictionary *errCodeCounts;
+
+/**
+ * Counts of the times between consecutive events of a transaction, keyed by
+ * bucket: the smallest power of 2 of milliseconds (1 at the least) not less
+ * than the time.
+ */
+@property (nonatomic, readonly) NSDictionary *durationHistogram;
+
+@end
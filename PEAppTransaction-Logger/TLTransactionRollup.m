@@ -0,0 +1,148 @@
+//
+//  TLTransactionRollup.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTransactionRollup.h"
+
+static void TLAddCount(NSMutableDictionary *counts, id key, NSUInteger count) {
+  counts[key] = @([counts[key] unsignedIntegerValue] + count);
+}
+
+@implementation TLTransactionRollup {
+  NSMutableDictionary *_eventCounts;
+  NSMutableDictionary *_errCodeCounts;
+  NSMutableDictionary *_durationHistogram;
+}
+
+#pragma mark - Initializers
+
+- (id)initWithUsecase:(NSNumber *)usecase
+          windowStart:(NSDate *)windowStart
+       windowDuration:(NSTimeInterval)windowDuration {
+  return [self initWithUsecase:usecase
+                   windowStart:windowStart
+                windowDuration:windowDuration
+               numTransactions:0
+                     numEvents:0
+                   eventCounts:nil
+                 errCodeCounts:nil
+             durationHistogram:nil];
+}
+
+- (id)initWithUsecase:(NSNumber *)usecase
+          windowStart:(NSDate *)windowStart
+       windowDuration:(NSTimeInterval)windowDuration
+      numTransactions:(NSUInteger)numTransactions
+            numEvents:(NSUInteger)numEvents
+          eventCounts:(NSDictionary *)eventCounts
+        errCodeCounts:(NSDictionary *)errCodeCounts
+    durationHistogram:(NSDictionary *)durationHistogram {
+  self = [super init];
+  if (self) {
+    _usecase = usecase;
+    _windowStart = windowStart;
+    _windowDuration = windowDuration;
+    _numTransactions = numTransactions;
+    _numEvents = numEvents;
+    _eventCounts = eventCounts ? [eventCounts mutableCopy] : [NSMutableDictionary dictionary];
+    _errCodeCounts = errCodeCounts ? [errCodeCounts mutableCopy] : [NSMutableDictionary dictionary];
+    _durationHistogram = durationHistogram ? [durationHistogram mutableCopy] : [NSMutableDictionary dictionary];
+  }
+  return self;
+}
+
+#pragma mark - Recording
+
+- (void)addTransaction {
+  _numTransactions++;
+}
+
+- (void)addEventWithUsecaseEvent:(NSNumber *)usecaseEvent
+                inContextErrCode:(NSNumber *)inContextErrCode
+              sincePreviousEvent:(NSTimeInterval)sincePreviousEvent {
+  _numEvents++;
+  if (usecaseEvent) {
+    TLAddCount(_eventCounts, usecaseEvent, 1);
+  }
+  if (inContextErrCode && inContextErrCode != (id)[NSNull null]) {
+    TLAddCount(_errCodeCounts, inContextErrCode, 1);
+  }
+  if (sincePreviousEvent >= 0) {
+    unsigned long long bucket = 1;
+    double millis = sincePreviousEvent * 1000.0;
+    while (bucket < millis && bucket < (1ULL << 62)) {
+      bucket <<= 1;
+    }
+    TLAddCount(_durationHistogram, @(bucket), 1);
+  }
+}
+
+- (void)mergeRollup:(TLTransactionRollup *)rollup {
+  _numTransactions += [rollup numTransactions];
+  _numEvents += [rollup numEvents];
+  [[rollup eventCounts] enumerateKeysAndObjectsUsingBlock:^(id key, NSNumber *count, BOOL *stop) {
+    TLAddCount(_eventCounts, key, [count unsignedIntegerValue]);
+  }];
+  [[rollup errCodeCounts] enumerateKeysAndObjectsUsingBlock:^(id key, NSNumber *count, BOOL *stop) {
+    TLAddCount(_errCodeCounts, key, [count unsignedIntegerValue]);
+  }];
+  [[rollup durationHistogram] enumerateKeysAndObjectsUsingBlock:^(id key, NSNumber *count, BOOL *stop) {
+    TLAddCount(_durationHistogram, key, [count unsignedIntegerValue]);
+  }];
+}
+
+#pragma mark - Properties
+
+- (NSDictionary *)eventCounts {
+  return _eventCounts;
+}
+
+- (NSDictionary *)errCodeCounts {
+  return _errCodeCounts;
+}
+
+- (NSDictionary *)durationHistogram {
+  return _durationHistogram;
+}
+
+#pragma mark - Count Pairs
+
++ (NSArray *)pairsOfCounts:(NSDictionary *)counts {
+  NSMutableArray *pairs = [NSMutableArray arrayWithCapacity:[counts count]];
+  for (NSNumber *key in [[counts allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+    [pairs addObject:@[key, counts[key]]];
+  }
+  return pairs;
+}
+
++ (NSDictionary *)countsOfPairs:(NSArray *)pairs {
+  NSMutableDictionary *counts = [NSMutableDictionary dictionaryWithCapacity:[pairs count]];
+  for (NSArray *pair in pairs) {
+    if ([pair isKindOfClass:[NSArray class]] && [pair count] == 2) {
+      counts[pair[0]] = pair[1];
+    }
+  }
+  return counts;
+}
+
+@end
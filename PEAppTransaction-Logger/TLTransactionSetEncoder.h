@@ -0,0 +1,66 @@
+//
+//  TLTransactionSetEncoder.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "TLTransaction.h"
+#import "TLTransactionRollup.h"
+
+/**
+ * An incremental encoder of a transaction set request body, in a particular
+ * wire format.
+ */
+@protocol TLTransactionSetEncoder <NSObject>
+
+/**
+ * Encodes the given transaction, along with its logs.
+ * @param txn The transaction to encode.
+ */
+- (void)writeTransaction:(TLTransaction *)txn;
+
+/**
+ * Discards the most recently encoded transaction.  Only supported once per
+ * written transaction.
+ */
+- (void)discardLastTransaction;
+
+/**
+ * Encodes the given rollups.  Called at most once, after the last transaction
+ * is encoded.
+ * @param rollups The TLTransactionRollup instances to encode.
+ */
+- (void)writeRollups:(NSArray *)rollups;
+
+/**
+ * Completes the transaction set.
+ * @return The encoded transaction set (nil if the encoder writes to a stream).
+ */
+- (NSData *)finish;
+
+/** The number of bytes the completed transaction set would have right now. */
+- (NSUInteger)length;
+
+/** The number of transactions encoded so far. */
+- (NSUInteger)transactionCount;
+
+@end
@@ -0,0 +1,56 @@
+//
+//  TLTransactionSetMsgPackWriter.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "TLTransactionSetEncoder.h"
+
+/**
+ * Encoder for the compact MessagePack 'apptxnset' request body.  Positional
+ * arrays are used in place of keyed maps, integers use the smallest MessagePack
+ * integer encoding that fits, and the body has the following layout:
+ *
+ *     [userAgents, txns]
+ *  or [userAgents, txns, rollups]
+ *     userAgents: [[device-make, device-os, device-os-version], ...]
+ *     txn:        [id, usecase, user-agent-index, first-log-timestamp, logs]
+ *              or [id, usecase, user-agent-index, first-log-timestamp, logs, sample-rate]
+ *     log:        [usecase-event, timestamp-delta]
+ *              or [usecase-event, timestamp-delta, in-ctx-err-code, in-ctx-err-desc]
+ *     rollup:     [usecase, window-start, window-duration, num-txns, num-events,
+ *                  event-counts, err-code-counts, duration-histogram]
+ *     counts:     [[key, count], ...]
+ *
+ * Each distinct user agent triple is encoded once per transaction set and
+ * referenced by its index.  Timestamps are milliseconds: a transaction's
+ * first-log-timestamp is relative to the Unix epoch (nil if the transaction has
+ * no logs), and each log's timestamp-delta is relative to first-log-timestamp.
+ * A transaction's sample-rate (a float) is only present if less than 1.  A
+ * rollup's window-start is in milliseconds since the Unix epoch, and its
+ * window-duration in (whole) seconds; rollups are only present if written.
+ *
+ * The encoded set is assembled in memory.
+ */
+@interface TLTransactionSetMsgPackWriter : NSObject <TLTransactionSetEncoder>
+
+@end
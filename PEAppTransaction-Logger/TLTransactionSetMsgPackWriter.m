@@ -0,0 +1,247 @@
+//
+//  TLTransactionSetMsgPackWriter.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTransactionSetMsgPackWriter.h"
+#import "TLTransactionLog.h"
+
+static void TLPackUInt8(NSMutableData *data, uint8_t value) {
+  [data appendBytes:&value length:1];
+}
+
+static void TLPackBigEndian(NSMutableData *data, uint8_t marker, uint64_t value, int numBytes) {
+  uint8_t buf[9];
+  buf[0] = marker;
+  for (int i = 0; i < numBytes; i++) {
+    buf[numBytes - i] = (uint8_t)(value >> (8 * i));
+  }
+  [data appendBytes:buf length:numBytes + 1];
+}
+
+static void TLPackNil(NSMutableData *data) {
+  TLPackUInt8(data, 0xc0);
+}
+
+static void TLPackInt(NSMutableData *data, int64_t value) {
+  if (value >= 0) {
+    if (value < 128)              { TLPackUInt8(data, (uint8_t)value); }
+    else if (value <= UINT8_MAX)  { TLPackBigEndian(data, 0xcc, value, 1); }
+    else if (value <= UINT16_MAX) { TLPackBigEndian(data, 0xcd, value, 2); }
+    else if (value <= UINT32_MAX) { TLPackBigEndian(data, 0xce, value, 4); }
+    else                          { TLPackBigEndian(data, 0xcf, value, 8); }
+  } else {
+    if (value >= -32)             { TLPackUInt8(data, (uint8_t)(0xe0 | (value + 32))); }
+    else if (value >= INT8_MIN)   { TLPackBigEndian(data, 0xd0, (uint8_t)value, 1); }
+    else if (value >= INT16_MIN)  { TLPackBigEndian(data, 0xd1, (uint16_t)value, 2); }
+    else if (value >= INT32_MIN)  { TLPackBigEndian(data, 0xd2, (uint32_t)value, 4); }
+    else                          { TLPackBigEndian(data, 0xd3, (uint64_t)value, 8); }
+  }
+}
+
+static void TLPackNumber(NSMutableData *data, id number) {
+  if (!number || number == [NSNull null]) {
+    TLPackNil(data);
+  } else {
+    TLPackInt(data, [number longLongValue]);
+  }
+}
+
+static void TLPackDouble(NSMutableData *data, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  TLPackBigEndian(data, 0xcb, bits, 8);
+}
+
+static void TLPackString(NSMutableData *data, NSString *string) {
+  if (![string isKindOfClass:[NSString class]]) {
+    TLPackNil(data);
+    return;
+  }
+  NSUInteger length = [string lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+  if (length < 32)              { TLPackUInt8(data, (uint8_t)(0xa0 | length)); }
+  else if (length <= UINT8_MAX) { TLPackBigEndian(data, 0xd9, length, 1); }
+  else if (length <= UINT16_MAX){ TLPackBigEndian(data, 0xda, length, 2); }
+  else                          { TLPackBigEndian(data, 0xdb, length, 4); }
+  [data appendBytes:[string UTF8String] length:length];
+}
+
+static void TLPackArrayHeader(NSMutableData *data, NSUInteger count) {
+  if (count < 16)               { TLPackUInt8(data, (uint8_t)(0x90 | count)); }
+  else if (count <= UINT16_MAX) { TLPackBigEndian(data, 0xdc, count, 2); }
+  else                          { TLPackBigEndian(data, 0xdd, count, 4); }
+}
+
+static NSUInteger TLArrayHeaderLength(NSUInteger count) {
+  return (count < 16) ? 1 : ((count <= UINT16_MAX) ? 3 : 5);
+}
+
+static int64_t TLMillisSinceEpoch(NSDate *date) {
+  return (int64_t)llround([date timeIntervalSince1970] * 1000.0);
+}
+
+@implementation TLTransactionSetMsgPackWriter {
+  NSMutableData *_userAgents;
+  NSMutableDictionary *_userAgentIndexes;
+  NSMutableData *_txns;
+  NSUInteger _transactionCount;
+  NSUInteger _txnsLengthBeforeLastTransaction;
+  id _userAgentAddedByLastTransaction;
+  NSUInteger _userAgentsLengthBeforeLastTransaction;
+  NSMutableData *_rollups;
+  NSUInteger _rollupCount;
+}
+
+#pragma mark - Initializers
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _userAgents = [NSMutableData data];
+    _userAgentIndexes = [NSMutableDictionary dictionary];
+    _txns = [NSMutableData dataWithCapacity:4096];
+  }
+  return self;
+}
+
+#pragma mark - Helpers
+
+- (NSUInteger)indexOfUserAgentOfTransaction:(TLTransaction *)txn {
+  id (^orNull)(id) = ^id(id value) { return value ? value : [NSNull null]; };
+  NSArray *userAgent = @[orNull([txn userAgentDeviceMake]),
+                         orNull([txn userAgentDeviceOS]),
+                         orNull([txn userAgentDeviceOSVersion])];
+  NSNumber *index = [_userAgentIndexes objectForKey:userAgent];
+  if (!index) {
+    index = @([_userAgentIndexes count]);
+    _userAgentsLengthBeforeLastTransaction = [_userAgents length];
+    _userAgentAddedByLastTransaction = userAgent;
+    [_userAgentIndexes setObject:index forKey:userAgent];
+    TLPackArrayHeader(_userAgents, 3);
+    TLPackString(_userAgents, [txn userAgentDeviceMake]);
+    TLPackString(_userAgents, [txn userAgentDeviceOS]);
+    TLPackString(_userAgents, [txn userAgentDeviceOSVersion]);
+  }
+  return [index unsignedIntegerValue];
+}
+
+- (void)packCountPairsOf:(NSDictionary *)counts {
+  NSArray *pairs = [TLTransactionRollup pairsOfCounts:counts];
+  TLPackArrayHeader(_rollups, [pairs count]);
+  for (NSArray *pair in pairs) {
+    TLPackArrayHeader(_rollups, 2);
+    TLPackNumber(_rollups, pair[0]);
+    TLPackNumber(_rollups, pair[1]);
+  }
+}
+
+#pragma mark - TLTransactionSetEncoder
+
+- (void)writeTransaction:(TLTransaction *)txn {
+  _txnsLengthBeforeLastTransaction = [_txns length];
+  _userAgentAddedByLastTransaction = nil;
+  NSArray *txnLogs = [txn logs];
+  BOOL sampled = [txn sampleRate] < 1.0;
+  TLPackArrayHeader(_txns, sampled ? 6 : 5);
+  TLPackString(_txns, [txn guid]);
+  TLPackNumber(_txns, [txn usecase]);
+  TLPackInt(_txns, [self indexOfUserAgentOfTransaction:txn]);
+  int64_t firstTimestamp = 0;
+  if ([txnLogs count] > 0) {
+    firstTimestamp = TLMillisSinceEpoch([txnLogs[0] timestamp]);
+    TLPackInt(_txns, firstTimestamp);
+  } else {
+    TLPackNil(_txns);
+  }
+  TLPackArrayHeader(_txns, [txnLogs count]);
+  for (TLTransactionLog *txnLog in txnLogs) {
+    id errCode = [txnLog inContextErrCode];
+    NSString *errDesc = [txnLog inContextLocalizedErrDesc];
+    BOOL hasErr = (errCode && errCode != [NSNull null]) || errDesc;
+    TLPackArrayHeader(_txns, hasErr ? 4 : 2);
+    TLPackNumber(_txns, [txnLog usecaseEvent]);
+    TLPackInt(_txns, TLMillisSinceEpoch([txnLog timestamp]) - firstTimestamp);
+    if (hasErr) {
+      TLPackNumber(_txns, errCode);
+      TLPackString(_txns, errDesc);
+    }
+  }
+  if (sampled) {
+    TLPackDouble(_txns, [txn sampleRate]);
+  }
+  _transactionCount++;
+}
+
+- (void)discardLastTransaction {
+  NSAssert(_transactionCount > 0, @"No transaction to discard.");
+  [_txns setLength:_txnsLengthBeforeLastTransaction];
+  if (_userAgentAddedByLastTransaction) {
+    [_userAgentIndexes removeObjectForKey:_userAgentAddedByLastTransaction];
+    [_userAgents setLength:_userAgentsLengthBeforeLastTransaction];
+    _userAgentAddedByLastTransaction = nil;
+  }
+  _transactionCount--;
+}
+
+- (void)writeRollups:(NSArray *)rollups {
+  NSAssert(!_rollups, @"Rollups can only be written once.");
+  _rollups = [NSMutableData data];
+  for (TLTransactionRollup *rollup in rollups) {
+    TLPackArrayHeader(_rollups, 8);
+    TLPackNumber(_rollups, [rollup usecase]);
+    TLPackInt(_rollups, TLMillisSinceEpoch([rollup windowStart]));
+    TLPackInt(_rollups, (int64_t)llround([rollup windowDuration]));
+    TLPackInt(_rollups, [rollup numTransactions]);
+    TLPackInt(_rollups, [rollup numEvents]);
+    [self packCountPairsOf:[rollup eventCounts]];
+    [self packCountPairsOf:[rollup errCodeCounts]];
+    [self packCountPairsOf:[rollup durationHistogram]];
+  }
+  _rollupCount = [rollups count];
+}
+
+- (NSData *)finish {
+  NSMutableData *data = [NSMutableData dataWithCapacity:[self length]];
+  TLPackArrayHeader(data, _rollups ? 3 : 2);
+  TLPackArrayHeader(data, [_userAgentIndexes count]);
+  [data appendData:_userAgents];
+  TLPackArrayHeader(data, _transactionCount);
+  [data appendData:_txns];
+  if (_rollups) {
+    TLPackArrayHeader(data, _rollupCount);
+    [data appendData:_rollups];
+  }
+  return data;
+}
+
+- (NSUInteger)length {
+  return 1 +
+    TLArrayHeaderLength([_userAgentIndexes count]) + [_userAgents length] +
+    TLArrayHeaderLength(_transactionCount) + [_txns length] +
+    (_rollups ? TLArrayHeaderLength(_rollupCount) + [_rollups length] : 0);
+}
+
+- (NSUInteger)transactionCount {
+  return _transactionCount;
+}
+
+@end
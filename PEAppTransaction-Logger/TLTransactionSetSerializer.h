@@ -24,7 +24,39 @@
 #import <Foundation/Foundation.h>
 #import <PEHateoas-Client/HCHalJsonSerializerExtensionSupport.h>
 
-/** Serializer for creating HTTP request body JSON from a transaction set. */
+// Transaction Log JSON keys
+FOUNDATION_EXPORT NSString * const TLTxnLogUsecaseEventKey;
+FOUNDATION_EXPORT NSString * const TLTxnLogTimestampKey;
+FOUNDATION_EXPORT NSString * const TLTxnLogInCtxErrCodeKey;
+FOUNDATION_EXPORT NSString * const TLTxnLogInCtxErrDescKey;
+
+// Transaction JSON keys
+FOUNDATION_EXPORT NSString * const TLTxnsKey;
+FOUNDATION_EXPORT NSString * const TLTxnIdentifierKey;
+FOUNDATION_EXPORT NSString * const TLTxnUsecaseKey;
+FOUNDATION_EXPORT NSString * const TLTxnUserAgentDeviceMakeKey;
+FOUNDATION_EXPORT NSString * const TLTxnUserAgentDeviceOsKey;
+FOUNDATION_EXPORT NSString * const TLTxnUserAgentDeviceOsVersionKey;
+FOUNDATION_EXPORT NSString * const TLTxnSampleRateKey;
+FOUNDATION_EXPORT NSString * const TLTxnLogsKey;
+
+// Transaction Rollup JSON keys
+FOUNDATION_EXPORT NSString * const TLTxnRollupsKey;
+FOUNDATION_EXPORT NSString * const TLTxnRollupUsecaseKey;
+FOUNDATION_EXPORT NSString * const TLTxnRollupWindowStartKey;
+FOUNDATION_EXPORT NSString * const TLTxnRollupWindowDurationKey;
+FOUNDATION_EXPORT NSString * const TLTxnRollupNumTxnsKey;
+FOUNDATION_EXPORT NSString * const TLTxnRollupNumEventsKey;
+FOUNDATION_EXPORT NSString * const TLTxnRollupEventCountsKey;
+FOUNDATION_EXPORT NSString * const TLTxnRollupErrCodeCountsKey;
+FOUNDATION_EXPORT NSString * const TLTxnRollupDurationHistogramKey;
+
+/**
+ * Serializer for creating HTTP request body JSON from a transaction set.  The
+ * resource model is either an array of TLTransaction instances, or the NSData
+ * of an already-encoded JSON transaction set (see TLTransactionSetWriter),
+ * which is passed through as is.
+ */
 @interface TLTransactionSetSerializer : HCHalJsonSerializerExtensionSupport
 
 @end
@@ -25,6 +25,7 @@
 #import "TLTransactionSetSerializer.h"
 #import "TLTransaction.h"
 #import "TLTransactionLog.h"
+#import "TLTransactionSetWriter.h"
 #import <PEHateoas-Client/HCUtils.h>
 
 // Transaction Log JSON keys
@@ -40,8 +41,20 @@ NSString * const TLTxnUsecaseKey                  = @"apptxn/usecase";
 NSString * const TLTxnUserAgentDeviceMakeKey      = @"apptxn/user-agent-device-make";
 NSString * const TLTxnUserAgentDeviceOsKey        = @"apptxn/user-agent-device-os";
 NSString * const TLTxnUserAgentDeviceOsVersionKey = @"apptxn/user-agent-device-os-version";
+NSString * const TLTxnSampleRateKey               = @"apptxn/sample-rate";
 NSString * const TLTxnLogsKey                     = @"apptxn/logs";
 
+// Transaction Rollup JSON keys
+NSString * const TLTxnRollupsKey                 = @"apptxnrollups";
+NSString * const TLTxnRollupUsecaseKey           = @"apptxnrollup/usecase";
+NSString * const TLTxnRollupWindowStartKey       = @"apptxnrollup/window-start";
+NSString * const TLTxnRollupWindowDurationKey    = @"apptxnrollup/window-duration";
+NSString * const TLTxnRollupNumTxnsKey           = @"apptxnrollup/num-txns";
+NSString * const TLTxnRollupNumEventsKey         = @"apptxnrollup/num-events";
+NSString * const TLTxnRollupEventCountsKey       = @"apptxnrollup/event-counts";
+NSString * const TLTxnRollupErrCodeCountsKey     = @"apptxnrollup/err-code-counts";
+NSString * const TLTxnRollupDurationHistogramKey = @"apptxnrollup/duration-histogram";
+
 @implementation TLTransactionSetSerializer
 
 #pragma mark - Helpers
@@ -65,6 +78,9 @@ NSString * const TLTxnLogsKey                     = @"apptxn/logs";
   dictPutter(txn, @selector(userAgentDeviceMake), TLTxnUserAgentDeviceMakeKey);
   dictPutter(txn, @selector(userAgentDeviceOS), TLTxnUserAgentDeviceOsKey);
   dictPutter(txn, @selector(userAgentDeviceOSVersion), TLTxnUserAgentDeviceOsVersionKey);
+  if ([txn sampleRate] < 1.0) {
+    [dictionary setObject:@([txn sampleRate]) forKey:TLTxnSampleRateKey];
+  }
   NSArray *txnLogs = [txn logs];
   NSMutableArray *serializedTxnLgs = [NSMutableArray arrayWithCapacity:[txnLogs count]];
   for (TLTransactionLog *txnLog in txnLogs) {
@@ -74,9 +90,30 @@ NSString * const TLTxnLogsKey                     = @"apptxn/logs";
   return dictionary;
 }
 
+#pragma mark - Serialization (Resource Model -> JSON)
+
+- (NSData *)serializeResourceModelToJson:(id)resourceModel {
+  if ([resourceModel isKindOfClass:[NSData class]]) {
+    return resourceModel;
+  }
+  TLTransactionSetWriter *writer = [[TLTransactionSetWriter alloc] init];
+  for (TLTransaction *txn in (NSArray *)resourceModel) {
+    [writer writeTransaction:txn];
+  }
+  return [writer finish];
+}
+
 #pragma mark - Serialization (Resource Model -> Dictionary)
 
 - (NSDictionary *)dictionaryWithResourceModel:(id)resourceModel {
+  if ([resourceModel isKindOfClass:[NSData class]]) {
+    // only a JSON body has a dictionary form; a MessagePack or compressed one
+    // never reaches a JSON serializer
+    NSError *err = nil;
+    NSDictionary *dictionary = [NSJSONSerialization JSONObjectWithData:resourceModel options:0 error:&err];
+    NSAssert(dictionary, @"An already-encoded transaction set must be JSON: %@", err);
+    return dictionary;
+  }
   NSArray *txnObjects = (NSArray *)resourceModel;
   NSMutableDictionary *dictionary = [NSMutableDictionary dictionary];
   NSMutableArray *txnDicts =
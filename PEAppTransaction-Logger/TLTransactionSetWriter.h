@@ -0,0 +1,91 @@
+//
+//  TLTransactionSetWriter.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "TLTransaction.h"
+#import "TLTransactionSetEncoder.h"
+
+/**
+ * Streaming encoder for the JSON 'apptxnset' request body.  Transactions are
+ * encoded one at a time, as they are read, directly into an output buffer (or
+ * output stream), rather than first being turned into a tree of dictionaries.
+ * The output is UTF-8 encoded, and decodes to the same JSON as the body
+ * produced by TLTransactionSetSerializer's dictionary-based serialization
+ * (though it need not match it byte for byte).
+ */
+@interface TLTransactionSetWriter : NSObject <TLTransactionSetEncoder>
+
+#pragma mark - Initializers
+
+/**
+ * Initializes a new instance that encodes into an in-memory buffer.
+ * @return The initialized instance.
+ */
+- (id)init;
+
+/**
+ * Initializes a new instance that encodes into the given (open) output stream.
+ * @param outputStream The stream to write the encoded transaction set to.
+ * @return The initialized instance.
+ */
+- (id)initWithOutputStream:(NSOutputStream *)outputStream;
+
+#pragma mark - Encoding
+
+/**
+ * Encodes the given transaction, along with its logs.
+ * @param txn The transaction to encode.
+ */
+- (void)writeTransaction:(TLTransaction *)txn;
+
+/**
+ * Discards the most recently encoded transaction.  Only supported when encoding
+ * into an in-memory buffer, and only once per written transaction.
+ */
+- (void)discardLastTransaction;
+
+/**
+ * Encodes the given rollups (as the set's 'apptxnrollups' member).  Called at
+ * most once, after the last transaction is encoded; transactions can no longer
+ * be discarded afterwards.
+ * @param rollups The TLTransactionRollup instances to encode.
+ */
+- (void)writeRollups:(NSArray *)rollups;
+
+/**
+ * Completes the transaction set.
+ * @return The encoded transaction set if encoding into an in-memory buffer;
+ * nil otherwise.
+ */
+- (NSData *)finish;
+
+#pragma mark - Properties
+
+/** The number of bytes encoded so far (including the closing bytes). */
+@property (nonatomic, readonly) NSUInteger length;
+
+/** The number of transactions encoded so far. */
+@property (nonatomic, readonly) NSUInteger transactionCount;
+
+@end
@@ -0,0 +1,351 @@
+//
+//  TLTransactionSetWriter.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTransactionSetWriter.h"
+#import "TLTransactionLog.h"
+#import "TLTransactionSetSerializer.h"
+#import <PEHateoas-Client/HCUtils.h>
+
+// Pre-encoded JSON member names (i.e., "<key>":)
+static NSData *TLTxnsMemberName;
+static NSData *TLTxnIdentifierMemberName;
+static NSData *TLTxnUsecaseMemberName;
+static NSData *TLTxnUserAgentDeviceMakeMemberName;
+static NSData *TLTxnUserAgentDeviceOsMemberName;
+static NSData *TLTxnUserAgentDeviceOsVersionMemberName;
+static NSData *TLTxnSampleRateMemberName;
+static NSData *TLTxnLogsMemberName;
+static NSData *TLTxnLogTimestampMemberName;
+static NSData *TLTxnLogUsecaseEventMemberName;
+static NSData *TLTxnLogInCtxErrCodeMemberName;
+static NSData *TLTxnLogInCtxErrDescMemberName;
+static NSData *TLTxnRollupsMemberName;
+static NSData *TLTxnRollupUsecaseMemberName;
+static NSData *TLTxnRollupWindowStartMemberName;
+static NSData *TLTxnRollupWindowDurationMemberName;
+static NSData *TLTxnRollupNumTxnsMemberName;
+static NSData *TLTxnRollupNumEventsMemberName;
+static NSData *TLTxnRollupEventCountsMemberName;
+static NSData *TLTxnRollupErrCodeCountsMemberName;
+static NSData *TLTxnRollupDurationHistogramMemberName;
+
+static inline void TLAppendBytes(NSMutableData *data, const char *bytes, NSUInteger length) {
+  [data appendBytes:bytes length:length];
+}
+
+static inline void TLAppendChar(NSMutableData *data, char c) {
+  [data appendBytes:&c length:1];
+}
+
+/**
+ * Appends the given string as a JSON string, escaped the same way
+ * NSJSONSerialization escapes strings (including the solidus).
+ */
+static void TLAppendJsonString(NSMutableData *data, NSString *string) {
+  TLAppendChar(data, '"');
+  const unsigned char *bytes = (const unsigned char *)[string UTF8String];
+  const unsigned char *run = bytes;
+  const unsigned char *p = bytes;
+  for (; *p; p++) {
+    const char *escape = NULL;
+    char unicodeEscape[7];
+    switch (*p) {
+      case '"':  escape = "\\\""; break;
+      case '\\': escape = "\\\\"; break;
+      case '/':  escape = "\\/";  break;
+      case '\b': escape = "\\b";  break;
+      case '\f': escape = "\\f";  break;
+      case '\n': escape = "\\n";  break;
+      case '\r': escape = "\\r";  break;
+      case '\t': escape = "\\t";  break;
+      default:
+        if (*p < 0x20) {
+          snprintf(unicodeEscape, sizeof(unicodeEscape), "\\u%04x", *p);
+          escape = unicodeEscape;
+        }
+    }
+    if (escape) {
+      TLAppendBytes(data, (const char *)run, p - run);
+      TLAppendBytes(data, escape, strlen(escape));
+      run = p + 1;
+    }
+  }
+  TLAppendBytes(data, (const char *)run, p - run);
+  TLAppendChar(data, '"');
+}
+
+static void TLAppendJsonNumber(NSMutableData *data, id number) {
+  if (number == [NSNull null]) {
+    TLAppendBytes(data, "null", 4);
+    return;
+  }
+  const char *objCType = [number objCType];
+  if (strcmp(objCType, @encode(double)) == 0 || strcmp(objCType, @encode(float)) == 0) {
+    NSString *str = [number stringValue];
+    TLAppendBytes(data, [str UTF8String], [str lengthOfBytesUsingEncoding:NSUTF8StringEncoding]);
+  } else {
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%lld", [number longLongValue]);
+    TLAppendBytes(data, buf, len);
+  }
+}
+
+static NSData *TLEncodedMemberName(NSString *key) {
+  NSMutableData *data = [NSMutableData data];
+  TLAppendJsonString(data, key);
+  TLAppendChar(data, ':');
+  return data;
+}
+
+@implementation TLTransactionSetWriter {
+  NSOutputStream *_outputStream;
+  NSMutableData *_buffer;
+  NSUInteger _numBytesStreamed;
+  NSUInteger _lengthBeforeLastTransaction;
+  long long _lastTimestampSecond;
+  NSData *_lastTimestamp;
+  BOOL _rollupsWritten;
+}
+
+#pragma mark - Class Initialization
+
++ (void)initialize {
+  if (self == [TLTransactionSetWriter class]) {
+    TLTxnsMemberName                        = TLEncodedMemberName(TLTxnsKey);
+    TLTxnIdentifierMemberName               = TLEncodedMemberName(TLTxnIdentifierKey);
+    TLTxnUsecaseMemberName                  = TLEncodedMemberName(TLTxnUsecaseKey);
+    TLTxnUserAgentDeviceMakeMemberName      = TLEncodedMemberName(TLTxnUserAgentDeviceMakeKey);
+    TLTxnUserAgentDeviceOsMemberName        = TLEncodedMemberName(TLTxnUserAgentDeviceOsKey);
+    TLTxnUserAgentDeviceOsVersionMemberName = TLEncodedMemberName(TLTxnUserAgentDeviceOsVersionKey);
+    TLTxnSampleRateMemberName               = TLEncodedMemberName(TLTxnSampleRateKey);
+    TLTxnLogsMemberName                     = TLEncodedMemberName(TLTxnLogsKey);
+    TLTxnLogTimestampMemberName             = TLEncodedMemberName(TLTxnLogTimestampKey);
+    TLTxnLogUsecaseEventMemberName          = TLEncodedMemberName(TLTxnLogUsecaseEventKey);
+    TLTxnLogInCtxErrCodeMemberName          = TLEncodedMemberName(TLTxnLogInCtxErrCodeKey);
+    TLTxnLogInCtxErrDescMemberName          = TLEncodedMemberName(TLTxnLogInCtxErrDescKey);
+    TLTxnRollupsMemberName                  = TLEncodedMemberName(TLTxnRollupsKey);
+    TLTxnRollupUsecaseMemberName            = TLEncodedMemberName(TLTxnRollupUsecaseKey);
+    TLTxnRollupWindowStartMemberName        = TLEncodedMemberName(TLTxnRollupWindowStartKey);
+    TLTxnRollupWindowDurationMemberName     = TLEncodedMemberName(TLTxnRollupWindowDurationKey);
+    TLTxnRollupNumTxnsMemberName            = TLEncodedMemberName(TLTxnRollupNumTxnsKey);
+    TLTxnRollupNumEventsMemberName          = TLEncodedMemberName(TLTxnRollupNumEventsKey);
+    TLTxnRollupEventCountsMemberName        = TLEncodedMemberName(TLTxnRollupEventCountsKey);
+    TLTxnRollupErrCodeCountsMemberName      = TLEncodedMemberName(TLTxnRollupErrCodeCountsKey);
+    TLTxnRollupDurationHistogramMemberName  = TLEncodedMemberName(TLTxnRollupDurationHistogramKey);
+  }
+}
+
+#pragma mark - Initializers
+
+- (id)init {
+  return [self initWithOutputStream:nil];
+}
+
+- (id)initWithOutputStream:(NSOutputStream *)outputStream {
+  self = [super init];
+  if (self) {
+    _outputStream = outputStream;
+    _buffer = [NSMutableData dataWithCapacity:4096];
+    _lastTimestampSecond = LLONG_MIN;
+    TLAppendChar(_buffer, '{');
+    [_buffer appendData:TLTxnsMemberName];
+    TLAppendChar(_buffer, '[');
+    [self drainBufferToStream];
+  }
+  return self;
+}
+
+#pragma mark - Helpers
+
+- (void)drainBufferToStream {
+  if (!_outputStream) {
+    return;
+  }
+  const uint8_t *bytes = [_buffer bytes];
+  NSUInteger remaining = [_buffer length];
+  while (remaining > 0) {
+    NSInteger written = [_outputStream write:bytes maxLength:remaining];
+    if (written <= 0) {
+      break;
+    }
+    bytes += written;
+    remaining -= written;
+    _numBytesStreamed += written;
+  }
+  [_buffer setLength:0];
+}
+
+- (void)appendMember:(NSData *)memberName string:(NSString *)value first:(BOOL *)first {
+  if (value) {
+    if (!*first) {
+      TLAppendChar(_buffer, ',');
+    }
+    [_buffer appendData:memberName];
+    TLAppendJsonString(_buffer, value);
+    *first = NO;
+  }
+}
+
+- (void)appendMember:(NSData *)memberName number:(id)value first:(BOOL *)first {
+  if (value) {
+    if (!*first) {
+      TLAppendChar(_buffer, ',');
+    }
+    [_buffer appendData:memberName];
+    TLAppendJsonNumber(_buffer, value);
+    *first = NO;
+  }
+}
+
+- (void)appendTimestamp:(NSDate *)timestamp {
+  // RFC 7231 dates have 1-second resolution, and logs tend to arrive in
+  // bursts, so the most recently formatted date is reused whenever possible.
+  long long second = (long long)floor([timestamp timeIntervalSince1970]);
+  if (second != _lastTimestampSecond || !_lastTimestamp) {
+    NSMutableData *encoded = [NSMutableData data];
+    TLAppendJsonString(encoded, [HCUtils rfc7231StringFromDate:timestamp]);
+    _lastTimestamp = encoded;
+    _lastTimestampSecond = second;
+  }
+  [_buffer appendData:_lastTimestamp];
+}
+
+- (void)appendMember:(NSData *)memberName countPairsOf:(NSDictionary *)counts {
+  TLAppendChar(_buffer, ',');
+  [_buffer appendData:memberName];
+  TLAppendChar(_buffer, '[');
+  BOOL firstPair = YES;
+  for (NSArray *pair in [TLTransactionRollup pairsOfCounts:counts]) {
+    if (!firstPair) {
+      TLAppendChar(_buffer, ',');
+    }
+    TLAppendChar(_buffer, '[');
+    TLAppendJsonNumber(_buffer, pair[0]);
+    TLAppendChar(_buffer, ',');
+    TLAppendJsonNumber(_buffer, pair[1]);
+    TLAppendChar(_buffer, ']');
+    firstPair = NO;
+  }
+  TLAppendChar(_buffer, ']');
+}
+
+#pragma mark - Encoding
+
+- (void)writeTransaction:(TLTransaction *)txn {
+  NSAssert(!_rollupsWritten, @"Transactions cannot be written after rollups.");
+  _lengthBeforeLastTransaction = [_buffer length];
+  if (_transactionCount > 0) {
+    TLAppendChar(_buffer, ',');
+  }
+  TLAppendChar(_buffer, '{');
+  BOOL first = YES;
+  [self appendMember:TLTxnIdentifierMemberName string:[txn guid] first:&first];
+  [self appendMember:TLTxnUsecaseMemberName number:[txn usecase] first:&first];
+  [self appendMember:TLTxnUserAgentDeviceMakeMemberName string:[txn userAgentDeviceMake] first:&first];
+  [self appendMember:TLTxnUserAgentDeviceOsMemberName string:[txn userAgentDeviceOS] first:&first];
+  [self appendMember:TLTxnUserAgentDeviceOsVersionMemberName string:[txn userAgentDeviceOSVersion] first:&first];
+  if ([txn sampleRate] < 1.0) {
+    [self appendMember:TLTxnSampleRateMemberName number:@([txn sampleRate]) first:&first];
+  }
+  if (!first) {
+    TLAppendChar(_buffer, ',');
+  }
+  [_buffer appendData:TLTxnLogsMemberName];
+  TLAppendChar(_buffer, '[');
+  BOOL firstLog = YES;
+  for (TLTransactionLog *txnLog in [txn logs]) {
+    if (!firstLog) {
+      TLAppendChar(_buffer, ',');
+    }
+    TLAppendChar(_buffer, '{');
+    [_buffer appendData:TLTxnLogTimestampMemberName];
+    [self appendTimestamp:[txnLog timestamp]];
+    BOOL firstMember = NO;
+    [self appendMember:TLTxnLogUsecaseEventMemberName number:[txnLog usecaseEvent] first:&firstMember];
+    [self appendMember:TLTxnLogInCtxErrCodeMemberName number:[txnLog inContextErrCode] first:&firstMember];
+    [self appendMember:TLTxnLogInCtxErrDescMemberName string:[txnLog inContextLocalizedErrDesc] first:&firstMember];
+    TLAppendChar(_buffer, '}');
+    firstLog = NO;
+  }
+  TLAppendBytes(_buffer, "]}", 2);
+  _transactionCount++;
+  [self drainBufferToStream];
+}
+
+- (void)discardLastTransaction {
+  NSAssert(!_outputStream, @"Discarding is not supported when writing to a stream.");
+  NSAssert(_transactionCount > 0, @"No transaction to discard.");
+  [_buffer setLength:_lengthBeforeLastTransaction];
+  _transactionCount--;
+}
+
+- (void)writeRollups:(NSArray *)rollups {
+  NSAssert(!_rollupsWritten, @"Rollups can only be written once.");
+  // the transactions array is closed here, and the rollups follow it
+  TLAppendChar(_buffer, ']');
+  TLAppendChar(_buffer, ',');
+  [_buffer appendData:TLTxnRollupsMemberName];
+  TLAppendChar(_buffer, '[');
+  BOOL firstRollup = YES;
+  for (TLTransactionRollup *rollup in rollups) {
+    if (!firstRollup) {
+      TLAppendChar(_buffer, ',');
+    }
+    TLAppendChar(_buffer, '{');
+    BOOL first = YES;
+    [self appendMember:TLTxnRollupUsecaseMemberName number:[rollup usecase] first:&first];
+    TLAppendChar(_buffer, ',');
+    [_buffer appendData:TLTxnRollupWindowStartMemberName];
+    [self appendTimestamp:[rollup windowStart]];
+    [self appendMember:TLTxnRollupWindowDurationMemberName number:@([rollup windowDuration]) first:&first];
+    [self appendMember:TLTxnRollupNumTxnsMemberName number:@([rollup numTransactions]) first:&first];
+    [self appendMember:TLTxnRollupNumEventsMemberName number:@([rollup numEvents]) first:&first];
+    [self appendMember:TLTxnRollupEventCountsMemberName countPairsOf:[rollup eventCounts]];
+    [self appendMember:TLTxnRollupErrCodeCountsMemberName countPairsOf:[rollup errCodeCounts]];
+    [self appendMember:TLTxnRollupDurationHistogramMemberName countPairsOf:[rollup durationHistogram]];
+    TLAppendChar(_buffer, '}');
+    firstRollup = NO;
+  }
+  TLAppendChar(_buffer, ']');
+  _rollupsWritten = YES;
+  [self drainBufferToStream];
+}
+
+- (NSData *)finish {
+  if (_rollupsWritten) {
+    TLAppendChar(_buffer, '}');
+  } else {
+    TLAppendBytes(_buffer, "]}", 2);
+  }
+  [self drainBufferToStream];
+  return _outputStream ? nil : _buffer;
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)length {
+  return _numBytesStreamed + [_buffer length] + (_rollupsWritten ? 1 : 2);
+}
+
+@end
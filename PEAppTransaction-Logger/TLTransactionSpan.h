@@ -0,0 +1,84 @@
+//
+//  TLTransactionSpan.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "TLTypedefs.h"
+
+@class TLTransaction;
+
+/**
+ * Collects the events of a transaction in memory, and logs them all at once
+ * (see TLTransaction's logTransactionLogs:error:) when committed.  Each event
+ * keeps the time it was collected at.  Use a span to instrument a multi-step
+ * flow at the cost of a single write; events not yet committed are lost if the
+ * process dies.
+ */
+@interface TLTransactionSpan : NSObject
+
+#pragma mark - Initializers
+
+/**
+ * Initializes a new (empty) instance.
+ * @param txn The transaction whose events the span collects.
+ * @return The initialized instance.
+ */
+- (id)initWithTransaction:(TLTransaction *)txn;
+
+#pragma mark - Event Collection
+
+/**
+ * Collects a new transaction log item with the given use case event.
+ * @param usecaseEvent The use case event to associate with the transaction log item.
+ */
+- (void)logWithUsecaseEvent:(NSNumber *)usecaseEvent;
+
+/**
+ * Collects a new transaction log item with the given use case event.
+ * @param usecaseEvent The use case event to associate with the transaction log item.
+ * @param inContextErrCode When logging an error, the error code.
+ * @param inContextLocalizedErrDesc When logging an error, the localized error
+ * description.
+ */
+- (void)logWithUsecaseEvent:(NSNumber *)usecaseEvent
+           inContextErrCode:(NSNumber *)inContextErrCode
+    inContextErrDescription:(NSString *)inContextLocalizedErrDesc;
+
+#pragma mark - Committing
+
+/**
+ * Logs the collected events to the span's transaction, and empties the span
+ * (so it can go on collecting).
+ * @param errorBlk Error block used in case of failed local database interaction.
+ */
+- (void)commitWithError:(TLDaoErrorBlk)errorBlk;
+
+#pragma mark - Properties
+
+/** The transaction whose events this span collects. */
+@property (nonatomic, readonly) TLTransaction *transaction;
+
+/** The number of collected events not yet committed. */
+@property (nonatomic, readonly) NSUInteger pendingCount;
+
+@end
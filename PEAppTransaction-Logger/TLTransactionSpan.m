@@ -0,0 +1,85 @@
+//
+//  TLTransactionSpan.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTransactionSpan.h"
+#import "TLTransaction.h"
+#import "TLTransactionLog.h"
+
+@implementation TLTransactionSpan {
+  NSMutableArray *_txnLogs;
+}
+
+#pragma mark - Initializers
+
+- (id)initWithTransaction:(TLTransaction *)txn {
+  self = [super init];
+  if (self) {
+    _transaction = txn;
+    _txnLogs = [NSMutableArray array];
+  }
+  return self;
+}
+
+#pragma mark - Event Collection
+
+- (void)logWithUsecaseEvent:(NSNumber *)usecaseEvent {
+  [self logWithUsecaseEvent:usecaseEvent
+           inContextErrCode:nil
+    inContextErrDescription:nil];
+}
+
+- (void)logWithUsecaseEvent:(NSNumber *)usecaseEvent
+           inContextErrCode:(NSNumber *)inContextErrCode
+    inContextErrDescription:(NSString *)inContextLocalizedErrDesc {
+  TLTransactionLog *txnLog =
+    [[TLTransactionLog alloc] initWithUsecaseEvent:usecaseEvent
+                                  inContextErrCode:inContextErrCode
+                           inContextErrDescription:inContextLocalizedErrDesc];
+  @synchronized(self) {
+    [_txnLogs addObject:txnLog];
+  }
+}
+
+#pragma mark - Committing
+
+- (void)commitWithError:(TLDaoErrorBlk)errorBlk {
+  NSArray *txnLogs;
+  @synchronized(self) {
+    txnLogs = _txnLogs;
+    _txnLogs = [NSMutableArray array];
+  }
+  if ([txnLogs count] > 0) {
+    [_transaction logTransactionLogs:txnLogs error:errorBlk];
+  }
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)pendingCount {
+  @synchronized(self) {
+    return [_txnLogs count];
+  }
+}
+
+@end
@@ -36,3 +36,111 @@ typedef void (^TLDaoErrorBlk)(NSError *, int, NSString *);
  *  @param NSNumber The ID number.
  */
 typedef void (^TLIDAssigner)(id, NSNumber *);
+
+/**
+ * Block type invoked once a transaction manager's local store is ready (see
+ * TLTransactionManager's asynchronous initializer).
+ */
+typedef void (^TLStoreReadyBlk)(void);
+
+/**
+ * The wire formats in which a transaction set can be flushed to the remote
+ * store.
+ */
+typedef NS_ENUM(NSInteger, TLTransactionSetFormat) {
+  /** The 'apptxnset' JSON format (media type suffix: +json). */
+  TLTransactionSetFormatJSON,
+  /** The compact 'apptxnset' MessagePack format (media type suffix: +msgpack). */
+  TLTransactionSetFormatMessagePack
+};
+
+/** The outcome of an attempt to flush the local store to the remote store. */
+typedef NS_ENUM(NSInteger, TLFlushOutcome) {
+  /** There was nothing in the local store to flush. */
+  TLFlushOutcomeNothingToFlush,
+  /** All of the batches of the flush were acknowledged. */
+  TLFlushOutcomeFlushed,
+  /**
+   * The flush was not attempted (e.g., another flush was in progress, or no
+   * authentication token or remote-store URI is set).
+   */
+  TLFlushOutcomeSkipped,
+  /** The remote store responded with a 'server unavailable' (503) response. */
+  TLFlushOutcomeRemoteStoreBusy,
+  /**
+   * A batch was not acknowledged for any other reason (connection failure,
+   * other error response, authentication required, etc.).
+   */
+  TLFlushOutcomeFailed
+};
+
+/**
+ * The steps a flush batch goes through on its way to the remote store.  Each
+ * step (other than TLFlushBatchStepPosted) is committed to the local store
+ * before the next step begins.
+ */
+typedef NS_ENUM(NSInteger, TLFlushBatchStep) {
+  /** The batch's rows have been leased to it, under a new idempotency key. */
+  TLFlushBatchStepLeased,
+  /** The batch has been marked as sent; its POST is about to be issued. */
+  TLFlushBatchStepSent,
+  /** The remote store acknowledged the batch; nothing is yet recorded locally. */
+  TLFlushBatchStepPosted,
+  /** The acknowledgement has been recorded; the rows are not yet deleted. */
+  TLFlushBatchStepAcknowledged
+};
+
+/**
+ * Block type invoked as a flush batch reaches each step.
+ * @param TLFlushBatchStep The step just reached.
+ * @param NSString         The batch's idempotency key.
+ * @return NO to abandon the flush at this step.
+ */
+typedef BOOL (^TLFlushBatchStepBlk)(TLFlushBatchStep, NSString *);
+
+/**
+ * Tunings of the local SQLite database (see TLTransactionManager's
+ * databaseProfile).
+ */
+typedef NS_ENUM(NSInteger, TLDatabaseProfile) {
+  /**
+   * SQLite's defaults: a rollback journal, synchronous=FULL and the default
+   * page cache, with reads and writes sharing a single connection.
+   */
+  TLDatabaseProfileDefault,
+  /**
+   * A write-ahead log (WAL), synchronous=NORMAL, a sized page cache and
+   * memory-mapped I/O, with reads (flush snapshots, fetches) on a separate
+   * read-only connection so that they never block writes.
+   */
+  TLDatabaseProfilePerformance
+};
+
+/**
+ * Settings of SQLite's 'synchronous' pragma; i.e., how hard SQLite works to
+ * make each commit durable across power loss.
+ */
+typedef NS_ENUM(NSInteger, TLDatabaseSynchronousMode) {
+  /** No syncing; commits can be lost (or the data file corrupted) on power loss. */
+  TLDatabaseSynchronousModeOff = 0,
+  /**
+   * Syncs at critical moments only; with a WAL, the most recent commits can be
+   * lost on power loss, but the data file stays consistent.
+   */
+  TLDatabaseSynchronousModeNormal = 1,
+  /** Syncs every commit. */
+  TLDatabaseSynchronousModeFull = 2
+};
+
+/**
+ * Whether the transactions matched by a TLTransactionFilter must have (or must
+ * not have) a log of an error.
+ */
+typedef NS_ENUM(NSInteger, TLTransactionErrorFilter) {
+  /** Matches transactions with or without errors. */
+  TLTransactionErrorFilterAny,
+  /** Matches transactions with at least one log of an error. */
+  TLTransactionErrorFilterWithErrors,
+  /** Matches transactions without any log of an error. */
+  TLTransactionErrorFilterWithoutErrors
+};
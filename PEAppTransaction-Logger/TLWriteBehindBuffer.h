@@ -0,0 +1,151 @@
+//
+//  TLWriteBehindBuffer.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import <FMDB/FMDatabaseQueue.h>
+#import "TLTypedefs.h"
+
+@class TLTransaction;
+@class TLTransactionLog;
+@class TLMetrics;
+
+/**
+ * A bounded, in-memory buffer of pending transaction and transaction log
+ * writes.  While enabled, recording a transaction or log simply appends to the
+ * buffer and returns; a background committer drains the buffer into the local
+ * SQLite database using a single database transaction per batch.
+ *
+ * A batch is committed when commitThreshold entries are pending, or
+ * commitInterval seconds after the first entry of a batch was appended,
+ * whichever comes first.  maxPendingEvents bounds the number of entries that
+ * can be lost if the process dies: when that many entries are pending, the
+ * appending thread commits the buffer itself before returning.
+ */
+@interface TLWriteBehindBuffer : NSObject
+
+#pragma mark - Initializers
+
+/**
+ * Initializes a new (disabled) instance.
+ * @param databaseQueue  Queue of the database the buffer is drained into.
+ * @param committerQueue Serial queue on which background commits are run.
+ * @return The initialized instance.
+ */
+- (id)initWithDatabaseQueue:(FMDatabaseQueue *)databaseQueue
+             committerQueue:(dispatch_queue_t)committerQueue;
+
+#pragma mark - Recording
+
+/**
+ * Buffers the insertion of the given (newly created) transaction.
+ * @param txn      The transaction to persist.
+ * @param errorBlk Error block invoked if the eventual insert fails.
+ */
+- (void)appendTransaction:(TLTransaction *)txn
+                    error:(TLDaoErrorBlk)errorBlk;
+
+/**
+ * Buffers the insertion of the given transaction log.
+ * @param txnLog   The transaction log to persist.
+ * @param txn      The parent transaction of txnLog.
+ * @param errorBlk Error block invoked if the eventual insert fails.
+ */
+- (void)appendLog:(TLTransactionLog *)txnLog
+   forTransaction:(TLTransaction *)txn
+            error:(TLDaoErrorBlk)errorBlk;
+
+/**
+ * Buffers the insertion of the given transaction logs, all at once.
+ * @param txnLogs  The transaction logs (TLTransactionLog instances) to persist.
+ * @param txn      The parent transaction of txnLogs.
+ * @param errorBlk Error block invoked if an eventual insert fails.
+ */
+- (void)appendLogs:(NSArray *)txnLogs
+    forTransaction:(TLTransaction *)txn
+             error:(TLDaoErrorBlk)errorBlk;
+
+#pragma mark - Committing
+
+/**
+ * Synchronously commits all pending entries to the local database.
+ */
+- (void)sync;
+
+/**
+ * Releases the hold (see held) and synchronously commits the entries buffered
+ * while it was in place, as one operation: writes that find the buffer
+ * disabled once the hold is released are only made after those entries are
+ * committed, so that no write overtakes them.
+ */
+- (void)releaseHoldAndCommit;
+
+#pragma mark - Properties
+
+/**
+ * Whether or not writes are buffered.  Defaults to NO.  Disabling the buffer
+ * commits any pending entries.  Reads YES while the buffer is held.
+ */
+@property (nonatomic, getter=isEnabled) BOOL enabled;
+
+/**
+ * Whether commits are held back (e.g., while the local database is still
+ * being set up).  While held, writes are buffered even if the buffer is not
+ * enabled, and nothing is committed, neither in the background nor by sync;
+ * maxPendingEvents does not apply.  Once the hold is released, the pending
+ * entries are committed by the next sync; see also releaseHoldAndCommit.
+ * Defaults to NO.
+ */
+@property (nonatomic, getter=isHeld) BOOL held;
+
+/** Number of pending entries that triggers a background commit.  Defaults to 50. */
+@property (nonatomic) NSUInteger commitThreshold;
+
+/**
+ * Maximum number of seconds an entry stays pending before a background commit
+ * is triggered.  Defaults to 5.
+ */
+@property (nonatomic) NSTimeInterval commitInterval;
+
+/**
+ * Upper bound on the number of pending entries (and so on the number of
+ * entries that can be lost on a crash).  Defaults to 500.
+ */
+@property (nonatomic) NSUInteger maxPendingEvents;
+
+/**
+ * Whether or not pending entries are committed when the application enters
+ * the background.  Defaults to YES.
+ */
+@property (nonatomic) BOOL commitsOnAppBackground;
+
+/** The number of entries currently pending. */
+@property (nonatomic, readonly) NSUInteger pendingCount;
+
+/**
+ * The metrics into which commits are recorded (database queue wait times, and
+ * events written or failed).  May be nil.
+ */
+@property (nonatomic) TLMetrics *metrics;
+
+@end
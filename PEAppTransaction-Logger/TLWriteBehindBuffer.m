@@ -0,0 +1,272 @@
+//
+//  TLWriteBehindBuffer.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLWriteBehindBuffer.h"
+#import <UIKit/UIKit.h>
+#import <FMDB/FMDatabase.h>
+#import <pthread.h>
+#import "TLTransaction.h"
+#import "TLTransactionLog.h"
+#import "TLDBUtils.h"
+#import "TLMetrics.h"
+
+/** A single pending write; a nil transactionLog denotes a transaction insert. */
+@interface TLWriteBehindEntry : NSObject
+@property (nonatomic) TLTransaction *transaction;
+@property (nonatomic) TLTransactionLog *transactionLog;
+@property (nonatomic, copy) TLDaoErrorBlk errorBlk;
+@end
+
+@implementation TLWriteBehindEntry
+@end
+
+@implementation TLWriteBehindBuffer {
+  FMDatabaseQueue *_databaseQueue;
+  dispatch_queue_t _committerQueue;
+  NSMutableArray *_pending;
+  pthread_mutex_t _pendingLock;
+  pthread_mutex_t _commitLock;
+  BOOL _timedCommitScheduled;
+  BOOL _thresholdCommitScheduled;
+  // (both accessors of each are implemented below, so neither is synthesized)
+  BOOL _enabled;
+  BOOL _held;
+}
+
+#pragma mark - Initializers
+
+- (id)initWithDatabaseQueue:(FMDatabaseQueue *)databaseQueue
+             committerQueue:(dispatch_queue_t)committerQueue {
+  self = [super init];
+  if (self) {
+    _databaseQueue = databaseQueue;
+    _committerQueue = committerQueue;
+    _pending = [NSMutableArray array];
+    pthread_mutex_init(&_pendingLock, NULL);
+    pthread_mutex_init(&_commitLock, NULL);
+    _enabled = NO;
+    _commitThreshold = 50;
+    _commitInterval = 5.0;
+    _maxPendingEvents = 500;
+    _commitsOnAppBackground = YES;
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(applicationDidEnterBackground:)
+                                                 name:UIApplicationDidEnterBackgroundNotification
+                                               object:nil];
+  }
+  return self;
+}
+
+#pragma mark - Setters
+
+- (void)setEnabled:(BOOL)enabled {
+  _enabled = enabled;
+  if (!enabled) {
+    [self sync];
+  }
+}
+
+- (void)setHeld:(BOOL)held {
+  pthread_mutex_lock(&_pendingLock);
+  _held = held;
+  pthread_mutex_unlock(&_pendingLock);
+}
+
+#pragma mark - Getters
+
+- (BOOL)isEnabled {
+  return _enabled || [self isHeld];
+}
+
+- (BOOL)isHeld {
+  pthread_mutex_lock(&_pendingLock);
+  BOOL held = _held;
+  pthread_mutex_unlock(&_pendingLock);
+  return held;
+}
+
+#pragma mark - Recording
+
+- (void)appendTransaction:(TLTransaction *)txn
+                    error:(TLDaoErrorBlk)errorBlk {
+  [self appendLog:nil forTransaction:txn error:errorBlk];
+}
+
+- (void)appendLog:(TLTransactionLog *)txnLog
+   forTransaction:(TLTransaction *)txn
+            error:(TLDaoErrorBlk)errorBlk {
+  TLWriteBehindEntry *entry = [[TLWriteBehindEntry alloc] init];
+  [entry setTransaction:txn];
+  [entry setTransactionLog:txnLog];
+  [entry setErrorBlk:errorBlk];
+  [self appendEntries:@[entry]];
+}
+
+- (void)appendLogs:(NSArray *)txnLogs
+    forTransaction:(TLTransaction *)txn
+             error:(TLDaoErrorBlk)errorBlk {
+  NSMutableArray *entries = [NSMutableArray arrayWithCapacity:[txnLogs count]];
+  for (TLTransactionLog *txnLog in txnLogs) {
+    TLWriteBehindEntry *entry = [[TLWriteBehindEntry alloc] init];
+    [entry setTransaction:txn];
+    [entry setTransactionLog:txnLog];
+    [entry setErrorBlk:errorBlk];
+    [entries addObject:entry];
+  }
+  [self appendEntries:entries];
+}
+
+- (void)appendEntries:(NSArray *)entries {
+  BOOL scheduleTimedCommit = NO;
+  BOOL scheduleThresholdCommit = NO;
+  pthread_mutex_lock(&_pendingLock);
+  [_pending addObjectsFromArray:entries];
+  if (_held) {
+    // committed once the hold is released
+    pthread_mutex_unlock(&_pendingLock);
+    return;
+  }
+  NSUInteger count = [_pending count];
+  if (!_enabled) {
+    // appended as the hold was being released; nothing else will commit it
+    pthread_mutex_unlock(&_pendingLock);
+    [self sync];
+    return;
+  }
+  if (count >= _commitThreshold && !_thresholdCommitScheduled) {
+    _thresholdCommitScheduled = scheduleThresholdCommit = YES;
+  } else if (!_timedCommitScheduled) {
+    _timedCommitScheduled = scheduleTimedCommit = YES;
+  }
+  pthread_mutex_unlock(&_pendingLock);
+  if (count >= _maxPendingEvents) {
+    // The committer has fallen behind; commit on the caller's thread so that
+    // no more than maxPendingEvents entries are ever at risk.
+    [self sync];
+  } else if (scheduleThresholdCommit) {
+    dispatch_async(_committerQueue, ^{ [self sync]; });
+  } else if (scheduleTimedCommit) {
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_commitInterval * NSEC_PER_SEC)),
+                   _committerQueue,
+                   ^{ [self sync]; });
+  }
+}
+
+#pragma mark - Committing
+
+- (void)sync {
+  // The commit lock keeps batches committing in the order they were drained.
+  pthread_mutex_lock(&_commitLock);
+  NSArray *entries;
+  pthread_mutex_lock(&_pendingLock);
+  if (_held) {
+    pthread_mutex_unlock(&_pendingLock);
+    pthread_mutex_unlock(&_commitLock);
+    return;
+  }
+  entries = _pending;
+  _pending = [NSMutableArray arrayWithCapacity:_commitThreshold];
+  _timedCommitScheduled = NO;
+  _thresholdCommitScheduled = NO;
+  pthread_mutex_unlock(&_pendingLock);
+  if ([entries count] > 0) {
+    [self commitEntries:entries];
+  }
+  pthread_mutex_unlock(&_commitLock);
+}
+
+- (void)releaseHoldAndCommit {
+  // The pending lock is kept until the held entries are committed, so that a
+  // writer checking isEnabled (or appending) in the meantime waits, and only
+  // then finds the hold released.
+  pthread_mutex_lock(&_commitLock);
+  pthread_mutex_lock(&_pendingLock);
+  NSArray *entries = _pending;
+  _pending = [NSMutableArray arrayWithCapacity:_commitThreshold];
+  _timedCommitScheduled = NO;
+  _thresholdCommitScheduled = NO;
+  if ([entries count] > 0) {
+    [self commitEntries:entries];
+  }
+  _held = NO;
+  pthread_mutex_unlock(&_pendingLock);
+  pthread_mutex_unlock(&_commitLock);
+}
+
+- (void)commitEntries:(NSArray *)entries {
+  TLMetrics *metrics = _metrics;
+  uint64_t enqueueTime = TLLatencyClockNow();
+  [_databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+    [[metrics databaseQueueWaitLatency] recordDurationSince:enqueueTime];
+    NSUInteger numLogged = 0;
+    NSUInteger numFailed = 0;
+    // The existence of each parent transaction only needs to be verified once
+    // per batch.
+    NSMutableSet *verifiedTxns = [NSMutableSet set];
+    for (TLWriteBehindEntry *entry in entries) {
+      TLTransaction *txn = [entry transaction];
+      if (![verifiedTxns containsObject:txn]) {
+        [TLDBUtils insertTransactionIfAbsent:txn db:db error:[entry errorBlk]];
+        [verifiedTxns addObject:txn];
+      }
+      if ([entry transactionLog]) {
+        if ([TLDBUtils insertTransactionLog:[entry transactionLog]
+                             forTransaction:txn
+                                         db:db
+                                      error:[entry errorBlk]]) {
+          numLogged++;
+        } else {
+          numFailed++;
+        }
+      }
+    }
+    [metrics addEventsLogged:numLogged];
+    [metrics addEventsFailed:numFailed];
+  }];
+}
+
+- (NSUInteger)pendingCount {
+  pthread_mutex_lock(&_pendingLock);
+  NSUInteger count = [_pending count];
+  pthread_mutex_unlock(&_pendingLock);
+  return count;
+}
+
+#pragma mark - Notifications
+
+- (void)applicationDidEnterBackground:(NSNotification *)notification {
+  if (_commitsOnAppBackground) {
+    [self sync];
+  }
+}
+
+#pragma mark - NSObject overrides
+
+- (void)dealloc {
+  [[NSNotificationCenter defaultCenter] removeObserver:self];
+  pthread_mutex_destroy(&_pendingLock);
+  pthread_mutex_destroy(&_commitLock);
+}
+
+@end
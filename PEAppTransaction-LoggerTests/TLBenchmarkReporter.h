@@ -0,0 +1,42 @@
+//
+//  TLBenchmarkReporter.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Reports benchmark results in machine-readable form: each result is logged
+ * as a single line, "TL-BENCHMARK-RESULT " followed by a JSON object (see
+ * run-benchmarks-xcodebuild.sh, which gathers them into a JSON array).  If the
+ * TL_BENCHMARK_RESULTS_PATH environment variable is set, the results so far are
+ * also written to that path, as a JSON array, after each result.
+ */
+@interface TLBenchmarkReporter : NSObject
+
++ (void)reportBenchmark:(NSString *)benchmark
+                 metric:(NSString *)metric
+                  value:(double)value
+                   unit:(NSString *)unit
+             parameters:(NSDictionary *)parameters;
+
+@end
@@ -0,0 +1,188 @@
+//
+//  TLEventStoreConformanceTests.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTransaction.h"
+#import "TLTransactionLog.h"
+#import "TLSegmentEventStore.h"
+#import "TLTestTxnMgrFactory.h"
+#import <zlib.h>
+#import <libkern/OSByteOrder.h>
+#import <Kiwi/Kiwi.h>
+
+SPEC_BEGIN(TLEventStoreConformanceSpec)
+
+TLDaoErrorBlk(^newErrLoggerMaker)(void) = ^{
+  return [TLTestTxnMgrFactory newErrLogger];
+};
+
+TLTransaction *(^newTxn)(void) = ^{
+  return [[TLTransaction alloc] initWithUsecase:@(17)
+                                        localId:nil
+                                           guid:[TLTransaction guidForUsecase:@(17)]
+                            userAgentDeviceMake:@"iPhone5,2"
+                              userAgentDeviceOS:@"iPhone OS"
+                       userAgentDeviceOSVersion:@"7.0.2"
+                                  databaseQueue:nil];
+};
+
+NSArray *(^newTxnLogs)(NSUInteger) = ^(NSUInteger numLogs) {
+  NSMutableArray *txnLogs = [NSMutableArray array];
+  for (NSUInteger i = 0; i < numLogs; i++) {
+    [txnLogs addObject:[[TLTransactionLog alloc] initWithUsecaseEvent:@(i)
+                                                     inContextErrCode:nil
+                                              inContextErrDescription:nil]];
+  }
+  return txnLogs;
+};
+
+NSUInteger (^backlogOf)(id<TLEventStore>) = ^(id<TLEventStore> store) {
+  NSUInteger numLogs = 0;
+  NSDate *oldestLogTimestamp = nil;
+  [store backlogNumLogs:&numLogs oldestLogTimestamp:&oldestLogTimestamp error:newErrLoggerMaker()];
+  return numLogs;
+};
+
+NSString * const segmentDirectoryPath =
+  [NSTemporaryDirectory() stringByAppendingPathComponent:@"tl-event-store-segments"];
+
+// Opens the store under test; 'fresh' empties it first, otherwise the store is
+// reopened as it would be after a restart.
+id<TLEventStore> (^newSegmentStore)(BOOL) = ^id<TLEventStore>(BOOL fresh) {
+  if (fresh) {
+    [[NSFileManager defaultManager] removeItemAtPath:segmentDirectoryPath error:nil];
+  }
+  return [[TLSegmentEventStore alloc] initWithDirectoryPath:segmentDirectoryPath];
+};
+
+void (^eventStoreExpectations)(id<TLEventStore> (^)(BOOL)) = ^(id<TLEventStore> (^storeMaker)(BOOL)) {
+  __block id<TLEventStore> store;
+
+  beforeEach(^{
+      store = storeMaker(YES);
+    });
+
+  it(@"Leases appended logs as a batch, and removes them once acknowledged", ^{
+      TLTransaction *txn1 = newTxn();
+      TLTransaction *txn2 = newTxn();
+      [[theValue([store appendLogs:newTxnLogs(2) forTransaction:txn1 error:newErrLoggerMaker()]) should] beYes];
+      [[theValue([store appendLogs:newTxnLogs(1) forTransaction:txn2 error:newErrLoggerMaker()]) should] beYes];
+      [[theValue(backlogOf(store)) should] equal:theValue(3)];
+      TLEventStoreBatch *batch = [store leaseNextBatchWithError:newErrLoggerMaker()];
+      [[[batch idempotencyKey] shouldNot] beNil];
+      [[[batch transactions] should] haveCountOf:2];
+      [[theValue([batch numLogs]) should] equal:theValue(3)];
+      [[[[batch transactions][0] guid] should] equal:[txn1 guid]];
+      [[[[batch transactions][0] logs] should] haveCountOf:2];
+      [[[[[batch transactions][0] logs][1] usecaseEvent] should] equal:@(1)];
+      [[[store leaseNextBatchWithError:newErrLoggerMaker()] should] beNil];
+      [store acknowledgeBatch:batch error:newErrLoggerMaker()];
+      [[theValue(backlogOf(store)) should] equal:theValue(0)];
+      [[[store leaseNextBatchWithError:newErrLoggerMaker()] should] beNil];
+    });
+
+  it(@"Leases a released batch again, under the same idempotency key", ^{
+      [store appendLogs:newTxnLogs(2) forTransaction:newTxn() error:newErrLoggerMaker()];
+      TLEventStoreBatch *batch = [store leaseNextBatchWithError:newErrLoggerMaker()];
+      [store releaseBatch:batch];
+      TLEventStoreBatch *releasedBatch = [store leaseNextBatchWithError:newErrLoggerMaker()];
+      [[[releasedBatch idempotencyKey] should] equal:[batch idempotencyKey]];
+      [[theValue([releasedBatch numLogs]) should] equal:theValue(2)];
+    });
+
+  it(@"Leases an unacknowledged batch again, under the same idempotency key, after a restart", ^{
+      [store appendLogs:newTxnLogs(2) forTransaction:newTxn() error:newErrLoggerMaker()];
+      TLEventStoreBatch *batch = [store leaseNextBatchWithError:newErrLoggerMaker()];
+      id<TLEventStore> restartedStore = storeMaker(NO);
+      TLEventStoreBatch *leftOverBatch = [restartedStore leaseNextBatchWithError:newErrLoggerMaker()];
+      [[[leftOverBatch idempotencyKey] should] equal:[batch idempotencyKey]];
+      [[theValue([leftOverBatch numLogs]) should] equal:theValue(2)];
+      [restartedStore acknowledgeBatch:leftOverBatch error:newErrLoggerMaker()];
+      [[theValue(backlogOf(restartedStore)) should] equal:theValue(0)];
+    });
+
+  it(@"Leaves logs appended after a lease to a later batch", ^{
+      TLTransaction *txn = newTxn();
+      [store appendLogs:newTxnLogs(1) forTransaction:txn error:newErrLoggerMaker()];
+      TLEventStoreBatch *batch = [store leaseNextBatchWithError:newErrLoggerMaker()];
+      [store appendLogs:newTxnLogs(2) forTransaction:txn error:newErrLoggerMaker()];
+      [store acknowledgeBatch:batch error:newErrLoggerMaker()];
+      [[theValue(backlogOf(store)) should] equal:theValue(2)];
+      TLEventStoreBatch *laterBatch = [store leaseNextBatchWithError:newErrLoggerMaker()];
+      [[[laterBatch idempotencyKey] shouldNot] equal:[batch idempotencyKey]];
+      [[[[laterBatch transactions][0] guid] should] equal:[txn guid]];
+      [[theValue([laterBatch numLogs]) should] equal:theValue(2)];
+    });
+};
+
+describe(@"TLSegmentEventStore", ^{
+    eventStoreExpectations(newSegmentStore);
+
+    it(@"Rotates to a new segment when the active one fills up", ^{
+        TLSegmentEventStore *store = (TLSegmentEventStore *)newSegmentStore(YES);
+        [store setSegmentSize:256];
+        TLTransaction *txn = newTxn();
+        for (NSUInteger i = 0; i < 20; i++) {
+          [store appendLogs:newTxnLogs(1) forTransaction:txn error:newErrLoggerMaker()];
+        }
+        NSUInteger numBatches = 0;
+        NSUInteger numLogs = 0;
+        TLEventStoreBatch *batch;
+        while ((batch = [store leaseNextBatchWithError:newErrLoggerMaker()])) {
+          numBatches++;
+          numLogs += [batch numLogs];
+          [[[[batch transactions][0] guid] should] equal:[txn guid]];
+          [store acknowledgeBatch:batch error:newErrLoggerMaker()];
+        }
+        [[theValue(numBatches) should] beGreaterThan:theValue(1)];
+        [[theValue(numLogs) should] equal:theValue(20)];
+      });
+
+    it(@"Writes little-endian frames, and keeps strings of any length whole", ^{
+        TLSegmentEventStore *store = (TLSegmentEventStore *)newSegmentStore(YES);
+        // 2 bytes of UTF-8 per character, well past what a 16-bit length holds
+        NSString *errDesc = [@"" stringByPaddingToLength:40000 withString:@"é" startingAtIndex:0];
+        TLTransactionLog *txnLog = [[TLTransactionLog alloc] initWithUsecaseEvent:@(0)
+                                                                 inContextErrCode:@(-1)
+                                                          inContextErrDescription:errDesc];
+        [store appendLogs:@[txnLog] forTransaction:newTxn() error:newErrLoggerMaker()];
+        TLEventStoreBatch *batch = [store leaseNextBatchWithError:newErrLoggerMaker()];
+        TLTransactionLog *readTxnLog = [[[batch transactions][0] logs] firstObject];
+        [[[readTxnLog inContextLocalizedErrDesc] should] equal:errDesc];
+
+        // the (now sealed) segment starts with the transaction's frame
+        NSString *segmentFileName =
+          [[[[NSFileManager defaultManager] contentsOfDirectoryAtPath:segmentDirectoryPath error:nil]
+             pathsMatchingExtensions:@[@"tlseg"]] firstObject];
+        NSData *segment =
+          [NSData dataWithContentsOfFile:[segmentDirectoryPath stringByAppendingPathComponent:segmentFileName]];
+        const uint8_t *bytes = [segment bytes];
+        uint32_t payloadLength = OSReadLittleInt32(bytes, 0);
+        [[theValue(payloadLength) should] beLessThan:theValue([segment length])];
+        [[theValue(OSReadLittleInt32(bytes, 4)) should] equal:theValue((uint32_t)crc32(0L, bytes + 8, payloadLength))];
+        [[theValue(bytes[8]) should] equal:theValue(1)];
+        [store acknowledgeBatch:batch error:newErrLoggerMaker()];
+      });
+  });
+
+SPEC_END
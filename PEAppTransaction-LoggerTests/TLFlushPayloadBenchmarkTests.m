@@ -0,0 +1,103 @@
+//
+//  TLFlushPayloadBenchmarkTests.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTransactionSetWriter.h"
+#import "TLCompressionUtils.h"
+#import "TLBenchmarkReporter.h"
+#import <zlib.h>
+#import <time.h>
+#import <Kiwi/Kiwi.h>
+
+SPEC_BEGIN(TLFlushPayloadBenchmarkSpec)
+
+// Builds a synthetic transaction set resembling real-world usage: a handful of
+// use cases, 2-8 logs per transaction, logs a few seconds apart and an
+// occasional in-context error.
+NSArray *(^syntheticTxnSet)(NSUInteger) = ^NSArray *(NSUInteger numTxns) {
+  NSMutableArray *txns = [NSMutableArray arrayWithCapacity:numTxns];
+  NSDate *now = [NSDate date];
+  srandom(42);
+  for (NSUInteger i = 0; i < numTxns; i++) {
+    NSNumber *usecase = @(random() % 12);
+    TLTransaction *txn =
+      [[TLTransaction alloc] initWithUsecase:usecase
+                                     localId:@(i + 1)
+                                        guid:[NSString stringWithFormat:@"TXN%@-%@", usecase, [[NSUUID UUID] UUIDString]]
+                         userAgentDeviceMake:@"iPhone7,2"
+                           userAgentDeviceOS:@"iPhone OS"
+                    userAgentDeviceOSVersion:@"8.1.2"
+                               databaseQueue:nil];
+    NSUInteger numLogs = 2 + (random() % 7);
+    NSMutableArray *logs = [NSMutableArray arrayWithCapacity:numLogs];
+    for (NSUInteger j = 0; j < numLogs; j++) {
+      BOOL isErr = (random() % 20) == 0;
+      TLTransactionLog *txnLog =
+        [[TLTransactionLog alloc] initWithUsecaseEvent:@(j)
+                                      inContextErrCode:isErr ? @(-1009) : (id)[NSNull null]
+                               inContextErrDescription:isErr ? @"The Internet connection appears to be offline." : nil];
+      [txnLog setTimestamp:[now dateByAddingTimeInterval:(i * 30) + (j * (random() % 5))]];
+      [logs addObject:txnLog];
+    }
+    [txn setLogs:logs];
+    [txns addObject:txn];
+  }
+  return txns;
+};
+
+describe(@"Flush payload compression", ^{
+
+    it(@"Reports compression ratio and CPU time for realistic transaction sets", ^{
+        for (NSNumber *numTxns in @[@(10), @(100), @(1000), @(5000)]) {
+          NSArray *txns = syntheticTxnSet([numTxns unsignedIntegerValue]);
+          TLTransactionSetWriter *writer = [[TLTransactionSetWriter alloc] init];
+          clock_t encodeStart = clock();
+          for (TLTransaction *txn in txns) {
+            [writer writeTransaction:txn];
+          }
+          NSData *body = [writer finish];
+          clock_t compressStart = clock();
+          NSData *compressed = [TLCompressionUtils gzipData:body level:Z_DEFAULT_COMPRESSION];
+          clock_t compressEnd = clock();
+          [compressed shouldNotBeNil];
+          [TLBenchmarkReporter reportBenchmark:@"flushPayloadCompression"
+                                        metric:@"ratio"
+                                         value:(double)[body length] / [compressed length]
+                                          unit:@"x"
+                                    parameters:@{@"txns" : numTxns}];
+          [TLBenchmarkReporter reportBenchmark:@"flushPayloadEncoding"
+                                        metric:@"cpuTime"
+                                         value:(double)(compressStart - encodeStart) * 1000.0 / CLOCKS_PER_SEC
+                                          unit:@"ms"
+                                    parameters:@{@"txns" : numTxns, @"bytes" : @([body length])}];
+          [TLBenchmarkReporter reportBenchmark:@"flushPayloadCompression"
+                                        metric:@"cpuTime"
+                                         value:(double)(compressEnd - compressStart) * 1000.0 / CLOCKS_PER_SEC
+                                          unit:@"ms"
+                                    parameters:@{@"txns" : numTxns}];
+          [[theValue([compressed length]) should] beLessThan:theValue([body length])];
+        }
+      });
+  });
+
+SPEC_END
@@ -0,0 +1,152 @@
+//
+//  TLFlushSchedulerTests.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "TLFlushScheduler.h"
+#import <Kiwi/Kiwi.h>
+
+/** A clock that only moves when told to. */
+@interface TLManualClock : NSObject <TLClock>
+@property (nonatomic) NSDate *now;
+@end
+
+@implementation TLManualClock
+@end
+
+SPEC_BEGIN(TLFlushSchedulerSpec)
+
+describe(@"TLFlushScheduler", ^{
+    __block TLManualClock *clock;
+    __block dispatch_queue_t workQueue;
+    __block NSUInteger numLogs;
+    __block NSDate *oldestLogTimestamp;
+    __block NSUInteger numFlushes;
+    __block TLFlushOutcome nextOutcome;
+    __block NSDate *nextRetryAfter;
+    __block TLFlushScheduler *scheduler;
+
+    // waits for the flush (if any) on the work queue, and its completion
+    void (^drain)(void) = ^{
+      dispatch_sync(workQueue, ^{});
+      [scheduler isFlushing];
+    };
+
+    beforeEach(^{
+        clock = [[TLManualClock alloc] init];
+        [clock setNow:[NSDate dateWithTimeIntervalSince1970:1423000000]];
+        workQueue = dispatch_queue_create("TLFlushSchedulerSpec.work", DISPATCH_QUEUE_SERIAL);
+        numLogs = 0;
+        oldestLogTimestamp = nil;
+        numFlushes = 0;
+        nextOutcome = TLFlushOutcomeFlushed;
+        nextRetryAfter = nil;
+        scheduler = [[TLFlushScheduler alloc] initWithWorkQueue:workQueue
+                                                          clock:clock
+                                                     backlogBlk:^(NSUInteger *n, NSDate **oldest) {
+                                                       *n = numLogs;
+                                                       *oldest = oldestLogTimestamp;
+                                                     }
+                                                       flushBlk:^TLFlushOutcome(NSDate **retryAfter) {
+                                                         numFlushes++;
+                                                         *retryAfter = nextRetryAfter;
+                                                         return nextOutcome;
+                                                       }];
+        [scheduler setBacklogThreshold:10];
+        [scheduler setMaxBacklogAge:300];
+        [scheduler setJitter:0.0];
+      });
+
+    it(@"Flushes once the backlog is large or old enough", ^{
+        numLogs = 9;
+        oldestLogTimestamp = [[clock now] dateByAddingTimeInterval:-299];
+        [scheduler evaluate];
+        drain();
+        [[theValue(numFlushes) should] equal:theValue(0)];
+        numLogs = 10;
+        [scheduler evaluate];
+        drain();
+        [[theValue(numFlushes) should] equal:theValue(1)];
+        numLogs = 1;
+        oldestLogTimestamp = [[clock now] dateByAddingTimeInterval:-300];
+        [scheduler evaluate];
+        drain();
+        [[theValue(numFlushes) should] equal:theValue(2)];
+      });
+
+    it(@"Backs off exponentially on failures, honoring Retry-After", ^{
+        numLogs = 10;
+        nextOutcome = TLFlushOutcomeFailed;
+        [scheduler evaluate];
+        drain();
+        [[theValue([scheduler consecutiveFailureCount]) should] equal:theValue(1)];
+        [[[scheduler backoffUntil] should] equal:[[clock now] dateByAddingTimeInterval:5]];
+
+        // still backing off
+        [clock setNow:[[clock now] dateByAddingTimeInterval:4]];
+        [scheduler evaluate];
+        drain();
+        [[theValue(numFlushes) should] equal:theValue(1)];
+
+        [clock setNow:[[clock now] dateByAddingTimeInterval:1]];
+        [scheduler evaluate];
+        drain();
+        [[theValue(numFlushes) should] equal:theValue(2)];
+        [[[scheduler backoffUntil] should] equal:[[clock now] dateByAddingTimeInterval:10]];
+
+        // a 503's Retry-After wins over a shorter backoff
+        [clock setNow:[scheduler backoffUntil]];
+        nextOutcome = TLFlushOutcomeRemoteStoreBusy;
+        nextRetryAfter = [[clock now] dateByAddingTimeInterval:120];
+        [scheduler evaluate];
+        drain();
+        [[theValue(numFlushes) should] equal:theValue(3)];
+        [[[scheduler backoffUntil] should] equal:nextRetryAfter];
+
+        // success resets the backoff
+        [clock setNow:[scheduler backoffUntil]];
+        nextOutcome = TLFlushOutcomeFlushed;
+        [scheduler evaluate];
+        drain();
+        [[theValue([scheduler consecutiveFailureCount]) should] equal:theValue(0)];
+        [[scheduler backoffUntil] shouldBeNil];
+      });
+
+    it(@"Coalesces flush requests made while a flush is running", ^{
+        dispatch_semaphore_t flushGate = dispatch_semaphore_create(0);
+        dispatch_async(workQueue, ^{
+          dispatch_semaphore_wait(flushGate, DISPATCH_TIME_FOREVER);
+        });
+        [scheduler requestFlush];
+        [[expectFutureValue(theValue([scheduler isFlushing])) shouldEventually] beYes];
+        [scheduler requestFlush];
+        [scheduler requestFlush];
+        [scheduler requestFlush];
+        [scheduler isFlushing]; // (the requests are processed)
+        dispatch_semaphore_signal(flushGate);
+        [[expectFutureValue(theValue(numFlushes)) shouldEventually] equal:theValue(2)];
+        drain();
+        drain();
+        [[theValue(numFlushes) should] equal:theValue(2)];
+      });
+  });
+
+SPEC_END
@@ -0,0 +1,310 @@
+//
+//  TLHotPathBenchmarkTests.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTransactionManager.h"
+#import "TLTransactionSpan.h"
+#import "TLSegmentEventStore.h"
+#import "TLTransactionSetWriter.h"
+#import "TLTransactionSetMsgPackWriter.h"
+#import "TLDDLUtils.h"
+#import "TLBenchmarkReporter.h"
+#import "TLTestTxnMgrFactory.h"
+#import <FMDB/FMDatabaseQueue.h>
+#import <FMDB/FMDatabase.h>
+#import <PEWire-Control/PEHttpResponseSimulator.h>
+#import <Kiwi/Kiwi.h>
+
+SPEC_BEGIN(TLHotPathBenchmarkSpec)
+
+// The benchmarks' sizes can be raised (e.g., on CI) through the environment:
+// TL_BENCHMARK_MAX_THREADS (default: 4) and TL_BENCHMARK_MAX_ROWS (default:
+// 100000; 1000000 adds the 1M-row load benchmark).
+NSUInteger (^benchmarkSetting)(NSString *, NSUInteger) = ^NSUInteger(NSString *name, NSUInteger defaultValue) {
+  NSString *value = [[[NSProcessInfo processInfo] environment] objectForKey:name];
+  return value ? (NSUInteger)[value integerValue] : defaultValue;
+};
+
+NSUInteger const numLogsPerTxn = 5;
+
+TLDaoErrorBlk(^newErrLoggerMaker)(void) = ^{
+  return [TLTestTxnMgrFactory newErrLogger];
+};
+
+TLTransactionManager *(^newTxnMgr)(NSString *) = ^TLTransactionManager *(NSString *dataFileName) {
+  return [TLTestTxnMgrFactory txnMgrWithDataFilePath:[TLTestTxnMgrFactory emptyTemporaryDataFilePath:dataFileName]];
+};
+
+// Bulk-loads numLogs logs (numLogsPerTxn per transaction) straight into the
+// given manager's data file.
+void (^bulkLoad)(NSString *, NSUInteger) = ^(NSString *dataFileName, NSUInteger numLogs) {
+  NSString *dataFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:dataFileName];
+  FMDatabaseQueue *dbQueue = [FMDatabaseQueue databaseQueueWithPath:dataFilePath];
+  [dbQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+    [db setShouldCacheStatements:YES];
+    long long userAgentId = [db longForQuery:[NSString stringWithFormat:@"SELECT MIN(%@) FROM %@",
+                                              COL_USERAGENT_ID, TBL_USER_AGENT]];
+    NSString *insertTxn = [NSString stringWithFormat:@"INSERT INTO %@(%@, %@, %@) VALUES (?, ?, ?)",
+                           TBL_TXN, COL_TXN_GUID, COL_TXN_USECASE, COL_TXN_USER_AGENT_ID];
+    NSString *insertLog = [NSString stringWithFormat:@"INSERT INTO %@(%@, %@, %@) VALUES (?, ?, ?)",
+                           TBL_TXN_LOG, COL_TXNLOG_PARENT_TXN_ID, COL_TXNLOG_TIMESTAMP, COL_TXNLOG_USECASE_EVENT];
+    NSDate *now = [NSDate date];
+    for (NSUInteger i = 0; i < numLogs / numLogsPerTxn; i++) {
+      [db executeUpdate:insertTxn, [TLTransaction newGuidBytes], @(17), @(userAgentId)];
+      long long txnId = [db lastInsertRowId];
+      for (NSUInteger j = 0; j < numLogsPerTxn; j++) {
+        [db executeUpdate:insertLog, @(txnId), now, @(j)];
+      }
+    }
+  }];
+  [dbQueue close];
+};
+
+// Builds numTxns in-memory transactions of numLogsPerTxn logs each.
+NSArray *(^inMemoryTxns)(NSUInteger) = ^NSArray *(NSUInteger numTxns) {
+  NSMutableArray *txns = [NSMutableArray arrayWithCapacity:numTxns];
+  NSDate *now = [NSDate date];
+  for (NSUInteger i = 0; i < numTxns; i++) {
+    TLTransaction *txn =
+      [[TLTransaction alloc] initWithUsecase:@(i % 12)
+                                     localId:@(i + 1)
+                                        guid:[TLTransaction guidForUsecase:@(i % 12)]
+                         userAgentDeviceMake:@"iPhone7,2"
+                           userAgentDeviceOS:@"iPhone OS"
+                    userAgentDeviceOSVersion:@"8.1.2"
+                               databaseQueue:nil];
+    NSMutableArray *logs = [NSMutableArray arrayWithCapacity:numLogsPerTxn];
+    for (NSUInteger j = 0; j < numLogsPerTxn; j++) {
+      TLTransactionLog *txnLog = [[TLTransactionLog alloc] initWithUsecaseEvent:@(j)
+                                                               inContextErrCode:nil
+                                                        inContextErrDescription:nil];
+      [txnLog setTimestamp:[now dateByAddingTimeInterval:j]];
+      [logs addObject:txnLog];
+    }
+    [txn setLogs:logs];
+    [txns addObject:txn];
+  }
+  return txns;
+};
+
+describe(@"Sustained logging throughput", ^{
+
+    it(@"Is reported for 1 to N logging threads", ^{
+        NSUInteger const numEventsPerThread = 1000;
+        NSUInteger maxThreads = benchmarkSetting(@"TL_BENCHMARK_MAX_THREADS", 4);
+        for (NSNumber *writeBehind in @[@NO, @YES]) {
+          for (NSUInteger numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+            TLTransactionManager *txnMgr = newTxnMgr(@"tl-benchmark-throughput.data");
+            [[txnMgr writeBehindBuffer] setEnabled:[writeBehind boolValue]];
+            NSDate *start = [NSDate date];
+            dispatch_apply(numThreads, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t t) {
+              TLTransaction *txn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+              for (NSUInteger i = 0; i < numEventsPerThread; i++) {
+                [txn logWithUsecaseEvent:@(i % 10) error:newErrLoggerMaker()];
+              }
+            });
+            [txnMgr sync];
+            NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+            [TLBenchmarkReporter reportBenchmark:@"logWithUsecaseEvent"
+                                          metric:@"throughput"
+                                           value:(numThreads * numEventsPerThread) / elapsed
+                                            unit:@"events/s"
+                                      parameters:@{@"threads" : @(numThreads),
+                                                   @"writeBehind" : writeBehind}];
+            [[theValue([[txnMgr metricsSnapshot] numEventsLogged]) should]
+              equal:theValue(numThreads * numEventsPerThread)];
+          }
+        }
+      });
+  });
+
+describe(@"Bulk logging cost", ^{
+
+    it(@"Is reported per event, one call per event versus one call per batch", ^{
+        NSUInteger const numEvents = 1000;
+        TLTransactionManager *txnMgr = newTxnMgr(@"tl-benchmark-bulk.data");
+        TLTransaction *txn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+        NSDate *start = [NSDate date];
+        for (NSUInteger i = 0; i < numEvents; i++) {
+          [txn logWithUsecaseEvent:@(i % 10) error:newErrLoggerMaker()];
+        }
+        NSTimeInterval singleElapsed = [[NSDate date] timeIntervalSinceDate:start];
+        start = [NSDate date];
+        [txn spanWithBlock:^(TLTransactionSpan *span) {
+          for (NSUInteger i = 0; i < numEvents; i++) {
+            [span logWithUsecaseEvent:@(i % 10)];
+          }
+        } error:newErrLoggerMaker()];
+        NSTimeInterval bulkElapsed = [[NSDate date] timeIntervalSinceDate:start];
+        [TLBenchmarkReporter reportBenchmark:@"logWithUsecaseEvent"
+                                      metric:@"costPerEvent"
+                                       value:(singleElapsed / numEvents) * 1e6
+                                        unit:@"us"
+                                  parameters:@{@"events" : @(numEvents)}];
+        [TLBenchmarkReporter reportBenchmark:@"logTransactionLogs"
+                                      metric:@"costPerEvent"
+                                       value:(bulkElapsed / numEvents) * 1e6
+                                        unit:@"us"
+                                  parameters:@{@"events" : @(numEvents)}];
+        [[theValue([[txnMgr metricsSnapshot] numEventsLogged]) should] equal:theValue(2 * numEvents)];
+      });
+  });
+
+describe(@"Event store append throughput", ^{
+
+    it(@"Is reported for the segment store", ^{
+        NSUInteger const numEvents = 10000;
+        NSString *segmentDirectoryPath =
+          [NSTemporaryDirectory() stringByAppendingPathComponent:@"tl-benchmark-segments"];
+        [[NSFileManager defaultManager] removeItemAtPath:segmentDirectoryPath error:nil];
+        id<TLEventStore> store = [[TLSegmentEventStore alloc] initWithDirectoryPath:segmentDirectoryPath];
+        TLTransaction *txn = [[TLTransaction alloc] initWithUsecase:@(17)
+                                                            localId:nil
+                                                               guid:[TLTransaction guidForUsecase:@(17)]
+                                                userAgentDeviceMake:@"iPhone5,2"
+                                                  userAgentDeviceOS:@"iPhone OS"
+                                           userAgentDeviceOSVersion:@"7.0.2"
+                                                      databaseQueue:nil];
+        NSDate *start = [NSDate date];
+        for (NSUInteger i = 0; i < numEvents; i++) {
+          TLTransactionLog *txnLog = [[TLTransactionLog alloc] initWithUsecaseEvent:@(i % 10)
+                                                                   inContextErrCode:nil
+                                                            inContextErrDescription:nil];
+          [store appendLogs:@[txnLog] forTransaction:txn error:newErrLoggerMaker()];
+        }
+        NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+        [TLBenchmarkReporter reportBenchmark:@"appendLogs"
+                                      metric:@"throughput"
+                                       value:numEvents / elapsed
+                                        unit:@"events/s"
+                                  parameters:@{@"store" : @"segment"}];
+        NSUInteger numLogs = 0;
+        NSDate *oldestLogTimestamp = nil;
+        [store backlogNumLogs:&numLogs oldestLogTimestamp:&oldestLogTimestamp error:newErrLoggerMaker()];
+        [[theValue(numLogs) should] equal:theValue(numEvents)];
+      });
+  });
+
+describe(@"Local store load time", ^{
+
+    it(@"Is reported for allTransactionsWithError: at 10k, 100k and 1M rows", ^{
+        NSUInteger maxRows = benchmarkSetting(@"TL_BENCHMARK_MAX_ROWS", 100000);
+        for (NSNumber *numRows in @[@(10000), @(100000), @(1000000)]) {
+          if ([numRows unsignedIntegerValue] > maxRows) {
+            break;
+          }
+          TLTransactionManager *txnMgr = newTxnMgr(@"tl-benchmark-load.data");
+          bulkLoad(@"tl-benchmark-load.data", [numRows unsignedIntegerValue]);
+          NSDate *start = [NSDate date];
+          NSArray *txns = [txnMgr allTransactionsWithError:newErrLoggerMaker()];
+          NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+          [TLBenchmarkReporter reportBenchmark:@"allTransactionsWithError"
+                                        metric:@"loadTime"
+                                         value:elapsed * 1000.0
+                                          unit:@"ms"
+                                    parameters:@{@"rows" : numRows}];
+          [[theValue([txns count]) should] equal:theValue([numRows unsignedIntegerValue] / numLogsPerTxn)];
+        }
+      });
+  });
+
+describe(@"Serializer throughput", ^{
+
+    it(@"Is reported for the JSON and MessagePack writers", ^{
+        NSArray *txns = inMemoryTxns(5000);
+        NSDictionary *writerClasses = @{@"json" : [TLTransactionSetWriter class],
+                                        @"msgpack" : [TLTransactionSetMsgPackWriter class]};
+        for (NSString *format in writerClasses) {
+          id<TLTransactionSetEncoder> writer = [[writerClasses[format] alloc] init];
+          NSDate *start = [NSDate date];
+          for (TLTransaction *txn in txns) {
+            [writer writeTransaction:txn];
+          }
+          NSData *body = [writer finish];
+          NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+          [TLBenchmarkReporter reportBenchmark:@"transactionSetWriter"
+                                        metric:@"throughput"
+                                         value:[txns count] / elapsed
+                                          unit:@"txns/s"
+                                    parameters:@{@"format" : format,
+                                                 @"bytesPerTxn" : @([body length] / [txns count])}];
+        }
+      });
+  });
+
+describe(@"Flush throughput", ^{
+
+    it(@"Is reported against a stand-in remote store", ^{
+        [PEHttpResponseSimulator
+          simulateResponseFromXml:[NSString stringWithContentsOfFile:[[NSBundle bundleForClass:[self class]]
+                                                                      pathForResource:@"http-response.201"
+                                                                               ofType:@"xml"
+                                                                          inDirectory:@"http-mock-responses"]
+                                                            encoding:NSUTF8StringEncoding
+                                                               error:nil]
+                   requestLatency:0
+                  responseLatency:0];
+        NSUInteger const numRows = 10000;
+        TLTransactionManager *txnMgr = newTxnMgr(@"tl-benchmark-flush.data");
+        bulkLoad(@"tl-benchmark-flush.data", numRows);
+        NSDate *start = [NSDate date];
+        [txnMgr synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {}];
+        NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+        [TLBenchmarkReporter reportBenchmark:@"synchronousFlushTxnsToRemoteStore"
+                                      metric:@"throughput"
+                                       value:(numRows / numLogsPerTxn) / elapsed
+                                        unit:@"txns/s"
+                                  parameters:@{@"rows" : @(numRows),
+                                               @"maxTransactionsPerFlushBatch" : @([txnMgr maxTransactionsPerFlushBatch]),
+                                               @"maxConcurrentFlushRequests" : @([txnMgr maxConcurrentFlushRequests])}];
+        TLLatencyHistogramSnapshot *cleanupLatency = [[txnMgr metricsSnapshot] cleanupLatency];
+        [TLBenchmarkReporter reportBenchmark:@"flushBatchCleanup"
+                                      metric:@"meanTime"
+                                       value:[cleanupLatency meanDuration] * 1000.0
+                                        unit:@"ms"
+                                  parameters:@{@"txnsPerBatch" : @([txnMgr maxTransactionsPerFlushBatch]),
+                                               @"batches" : @([cleanupLatency count])}];
+        [[[txnMgr allTransactionsWithError:newErrLoggerMaker()] should] beEmpty];
+      });
+  });
+
+describe(@"Deletion time", ^{
+
+    it(@"Is reported for deleteTransactionsInTxn: of 5000 transactions", ^{
+        NSUInteger const numRows = 5000 * numLogsPerTxn;
+        TLTransactionManager *txnMgr = newTxnMgr(@"tl-benchmark-delete.data");
+        bulkLoad(@"tl-benchmark-delete.data", numRows);
+        NSArray *txns = [txnMgr allTransactionsWithError:newErrLoggerMaker()];
+        NSDate *start = [NSDate date];
+        [txnMgr deleteTransactionsInTxn:txns error:newErrLoggerMaker()];
+        NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+        [TLBenchmarkReporter reportBenchmark:@"deleteTransactionsInTxn"
+                                      metric:@"time"
+                                       value:elapsed * 1000.0
+                                        unit:@"ms"
+                                  parameters:@{@"txns" : @([txns count])}];
+        [[[txnMgr allTransactionsWithError:newErrLoggerMaker()] should] beEmpty];
+      });
+  });
+
+SPEC_END
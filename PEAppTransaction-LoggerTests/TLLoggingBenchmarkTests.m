@@ -0,0 +1,160 @@
+//
+//  TLLoggingBenchmarkTests.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTransactionManager.h"
+#import "TLDBUtils.h"
+#import "TLDDLUtils.h"
+#import "TLBenchmarkReporter.h"
+#import "TLTestTxnMgrFactory.h"
+#import <FMDB/FMDatabaseQueue.h>
+#import <FMDB/FMDatabase.h>
+#import <FMDB/FMDatabaseAdditions.h>
+#import <Kiwi/Kiwi.h>
+
+SPEC_BEGIN(TLLoggingBenchmarkSpec)
+
+NSUInteger const numEventsPerRun = 2000;
+
+TLDaoErrorBlk(^newErrLoggerMaker)(void) = ^{
+  return [TLTestTxnMgrFactory newErrLogger];
+};
+
+TLTransactionManager *(^newTxnMgr)(NSString *) = ^TLTransactionManager *(NSString *dataFileName) {
+  return [TLTestTxnMgrFactory txnMgrWithDataFilePath:[TLTestTxnMgrFactory emptyTemporaryDataFilePath:dataFileName]];
+};
+
+// Returns the average number of microseconds spent by the caller per logged event.
+double (^microsPerEvent)(TLTransactionManager *) = ^double(TLTransactionManager *txnMgr) {
+  TLTransaction *txn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+  NSDate *start = [NSDate date];
+  for (NSUInteger i = 0; i < numEventsPerRun; i++) {
+    [txn logWithUsecaseEvent:@(i % 10) error:newErrLoggerMaker()];
+  }
+  return ([[NSDate date] timeIntervalSinceDate:start] * 1000000.0) / numEventsPerRun;
+};
+
+describe(@"Per-event logging cost", ^{
+
+    it(@"Is reported with and without the write-behind buffer", ^{
+        TLTransactionManager *directTxnMgr = newTxnMgr(@"tl-benchmark-direct.data");
+        double directCost = microsPerEvent(directTxnMgr);
+
+        TLTransactionManager *bufferedTxnMgr = newTxnMgr(@"tl-benchmark-write-behind.data");
+        [[bufferedTxnMgr writeBehindBuffer] setEnabled:YES];
+        double bufferedCost = microsPerEvent(bufferedTxnMgr);
+        [bufferedTxnMgr sync];
+
+        [TLBenchmarkReporter reportBenchmark:@"logWithUsecaseEvent" metric:@"callerCost" value:directCost
+                                        unit:@"us/event" parameters:@{@"writeBehind" : @NO}];
+        [TLBenchmarkReporter reportBenchmark:@"logWithUsecaseEvent" metric:@"callerCost" value:bufferedCost
+                                        unit:@"us/event" parameters:@{@"writeBehind" : @YES}];
+        NSArray *allTxns = [bufferedTxnMgr allTransactionsWithError:newErrLoggerMaker()];
+        [[allTxns should] haveCountOf:1];
+        [[[allTxns[0] logs] should] haveCountOf:numEventsPerRun];
+      });
+  });
+
+describe(@"Local insert throughput", ^{
+
+    // Returns the number of transaction log inserts per second achieved by the
+    // given insert block against a fresh data file.
+    double (^insertsPerSecond)(NSString *, BOOL, void(^)(TLTransactionLog *, TLTransaction *, FMDatabase *)) =
+      ^double(NSString *dataFileName, BOOL cachesStatements,
+              void(^insertLog)(TLTransactionLog *, TLTransaction *, FMDatabase *)) {
+      NSString *dataFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:dataFileName];
+      [[NSFileManager defaultManager] removeItemAtPath:dataFilePath error:nil];
+      FMDatabaseQueue *dbQueue = [FMDatabaseQueue databaseQueueWithPath:dataFilePath];
+      TLTransaction *txn = [[TLTransaction alloc] initWithUsecase:@(17)
+                                                          localId:nil
+                                                             guid:@"TXN17-benchmark"
+                                              userAgentDeviceMake:@"iPhone5,2"
+                                                userAgentDeviceOS:@"iPhone OS"
+                                         userAgentDeviceOSVersion:@"7.0.2"
+                                                    databaseQueue:dbQueue];
+      [dbQueue inDatabase:^(FMDatabase *db) {
+        [db setShouldCacheStatements:cachesStatements];
+        [TLDBUtils doUpdate:[TLDDLUtils transactionDDL] db:db error:newErrLoggerMaker()];
+        [TLDBUtils doUpdate:[TLDDLUtils transactionLogDDL] db:db error:newErrLoggerMaker()];
+        [TLDBUtils doUpdate:[TLDDLUtils userAgentDDL] db:db error:newErrLoggerMaker()];
+        [TLDBUtils doUpdate:[TLDDLUtils transactionUserAgentIdColumnDDL] db:db error:newErrLoggerMaker()];
+        [TLDBUtils insertTransaction:txn db:db error:newErrLoggerMaker()];
+      }];
+      __block NSTimeInterval elapsed = 0;
+      [dbQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+        NSDate *start = [NSDate date];
+        for (NSUInteger i = 0; i < numEventsPerRun; i++) {
+          TLTransactionLog *txnLog = [[TLTransactionLog alloc] initWithUsecaseEvent:@(i % 10)
+                                                                   inContextErrCode:nil
+                                                            inContextErrDescription:nil];
+          insertLog(txnLog, txn, db);
+        }
+        elapsed = [[NSDate date] timeIntervalSinceDate:start];
+      }];
+      [dbQueue inDatabase:^(FMDatabase *db) {
+        [[theValue((NSUInteger)[db longForQuery:[NSString stringWithFormat:@"SELECT COUNT(*) FROM %@", TBL_TXN_LOG]])
+          should] equal:theValue(numEventsPerRun)];
+      }];
+      [dbQueue close];
+      return numEventsPerRun / elapsed;
+    };
+
+    it(@"Is reported with and without precomputed SQL and cached statements", ^{
+        // the insert as it was issued before SQL was precomputed and statements
+        // were cached
+        double formattedRate =
+          insertsPerSecond(@"tl-benchmark-insert-formatted.data", NO,
+                           ^(TLTransactionLog *txnLog, TLTransaction *txn, FMDatabase *db) {
+            NSString *stmt = [NSString stringWithFormat:@"INSERT INTO %@(%@, %@, %@, %@, %@) \
+                              VALUES(?, ?, ?, ?, ?)",
+                              TBL_TXN_LOG,
+                              COL_TXNLOG_PARENT_TXN_ID,
+                              COL_TXNLOG_TIMESTAMP,
+                              COL_TXNLOG_USECASE_EVENT,
+                              COL_TXNLOG_IN_CTX_ERR_CODE,
+                              COL_TXNLOG_IN_CTX_ERR_DESC];
+            NSArray *args = @[[txn localId],
+                              [txnLog timestamp],
+                              [txnLog usecaseEvent],
+                              [txnLog inContextErrCode] ? [txnLog inContextErrCode] : [NSNull null],
+                              [txnLog inContextLocalizedErrDesc] ? [txnLog inContextLocalizedErrDesc] : [NSNull null]];
+            [TLDBUtils doInsert:stmt
+                      argsArray:args
+                         entity:nil
+                     idAssigner:nil
+                             db:db
+                          error:newErrLoggerMaker()];
+          });
+        double cachedRate =
+          insertsPerSecond(@"tl-benchmark-insert-cached.data", YES,
+                           ^(TLTransactionLog *txnLog, TLTransaction *txn, FMDatabase *db) {
+            [TLDBUtils insertTransactionLog:txnLog forTransaction:txn db:db error:newErrLoggerMaker()];
+          });
+        [TLBenchmarkReporter reportBenchmark:@"insertTransactionLog" metric:@"throughput" value:formattedRate
+                                        unit:@"inserts/s" parameters:@{@"cachedStatements" : @NO}];
+        [TLBenchmarkReporter reportBenchmark:@"insertTransactionLog" metric:@"throughput" value:cachedRate
+                                        unit:@"inserts/s" parameters:@{@"cachedStatements" : @YES}];
+      });
+  });
+
+SPEC_END
@@ -0,0 +1,57 @@
+//
+//  TLTestTxnMgrFactory.h
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <Foundation/Foundation.h>
+#import "TLTransactionManager.h"
+
+/**
+ * Creates the transaction managers used by the specs and benchmarks: each
+ * identifies itself as the same user agent, and is set up to flush to
+ * http://example.com/txn-store with an authentication token.
+ */
+@interface TLTestTxnMgrFactory : NSObject
+
+/** @return An error block that logs the error. */
++ (TLDaoErrorBlk)newErrLogger;
+
+/**
+ * @return The path of the given data file in the temporary directory, with
+ * any file left at that path by an earlier run removed.
+ */
++ (NSString *)emptyTemporaryDataFilePath:(NSString *)dataFileName;
+
+/**
+ * @return A new transaction manager on the given data file, initialized
+ * synchronously.
+ */
++ (TLTransactionManager *)txnMgrWithDataFilePath:(NSString *)dataFilePath;
+
+/**
+ * @return A new transaction manager on the given data file, whose local store
+ * is opened in the background.
+ */
++ (TLTransactionManager *)txnMgrWithDataFilePath:(NSString *)dataFilePath
+                                        readyBlk:(TLStoreReadyBlk)readyBlk;
+
+@end
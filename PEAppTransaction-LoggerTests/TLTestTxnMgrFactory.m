@@ -0,0 +1,92 @@
+//
+//  TLTestTxnMgrFactory.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTestTxnMgrFactory.h"
+#import <PEHateoas-Client/HCCharset.h>
+
+@implementation TLTestTxnMgrFactory
+
++ (TLDaoErrorBlk)newErrLogger {
+  return ^(NSError *err, int code, NSString *msg) {
+    NSLog(@"Error code: [%d], error msg: [%@], error: [%@]", code, msg, err);
+  };
+}
+
++ (NSString *)emptyTemporaryDataFilePath:(NSString *)dataFileName {
+  NSString *dataFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:dataFileName];
+  [[NSFileManager defaultManager] removeItemAtPath:dataFilePath error:nil];
+  return dataFilePath;
+}
+
++ (TLTransactionManager *)txnMgrWithDataFilePath:(NSString *)dataFilePath {
+  return [self txnMgrWithDataFilePath:dataFilePath asynchronous:NO readyBlk:nil];
+}
+
++ (TLTransactionManager *)txnMgrWithDataFilePath:(NSString *)dataFilePath
+                                        readyBlk:(TLStoreReadyBlk)readyBlk {
+  return [self txnMgrWithDataFilePath:dataFilePath asynchronous:YES readyBlk:readyBlk];
+}
+
++ (TLTransactionManager *)txnMgrWithDataFilePath:(NSString *)dataFilePath
+                                    asynchronous:(BOOL)asynchronous
+                                        readyBlk:(TLStoreReadyBlk)readyBlk {
+  HCRelationExecutor *relExecutor =
+    [[HCRelationExecutor alloc]
+      initWithDefaultAcceptCharset:[HCCharset UTF8]
+             defaultAcceptLanguage:@"en-US"
+         defaultContentTypeCharset:[HCCharset UTF8]
+          allowInvalidCertificates:NO];
+  TLTransactionManager *txnMgr;
+  if (asynchronous) {
+    txnMgr = [[TLTransactionManager alloc] initWithDataFilePath:dataFilePath
+                                            userAgentDeviceMake:@"iPhone5,2"
+                                              userAgentDeviceOS:@"iPhone OS"
+                                       userAgentDeviceOSVersion:@"7.0.2"
+                                               relationExecutor:relExecutor
+                                                     authScheme:@"token-scheme"
+                                             authTokenParamName:@"auth-token"
+                                             contentTypeCharset:[HCCharset UTF8]
+                                             apptxnResMtVersion:@"0.0.1"
+                                       apptxnMediaSubtypePrefix:@"vnd.name.paulevans."
+                                                       readyBlk:readyBlk
+                                                          error:[self newErrLogger]];
+  } else {
+    txnMgr = [[TLTransactionManager alloc] initWithDataFilePath:dataFilePath
+                                            userAgentDeviceMake:@"iPhone5,2"
+                                              userAgentDeviceOS:@"iPhone OS"
+                                       userAgentDeviceOSVersion:@"7.0.2"
+                                               relationExecutor:relExecutor
+                                                     authScheme:@"token-scheme"
+                                             authTokenParamName:@"auth-token"
+                                             contentTypeCharset:[HCCharset UTF8]
+                                             apptxnResMtVersion:@"0.0.1"
+                                       apptxnMediaSubtypePrefix:@"vnd.name.paulevans."
+                                                          error:[self newErrLogger]];
+  }
+  [txnMgr setAuthToken:@"auth-token-val"];
+  [txnMgr setTxnStoreResourceUri:[NSURL URLWithString:@"http://example.com/txn-store"]];
+  return txnMgr;
+}
+
+@end
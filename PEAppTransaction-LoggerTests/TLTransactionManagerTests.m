@@ -22,13 +22,17 @@
 // THE SOFTWARE.
 
 #import "TLTransactionManager.h"
+#import "TLTransactionSpan.h"
+#import "TLTransactionSetSerializer.h"
 #import <UIKit/UIKit.h>
 #import <PEWire-Control/PEHttpResponseSimulator.h>
+#import <OHHTTPStubs/OHHTTPStubs.h>
 #import <PEObjc-Commons/PEUtils.h>
 #import <PEHateoas-Client/HCCharset.h>
 #import <PEHateoas-Client/HCUtils.h>
 #import "TLNotificationNamesAndUserInfoKeys.h"
 #import "TLToggler.h"
+#import "TLTestTxnMgrFactory.h"
 #import "TLLogging.h"
 #import <CocoaLumberjack/DDTTYLogger.h>
 #import <CocoaLumberjack/DDASLLogger.h>
@@ -42,9 +46,7 @@ __block NSDate *flushRetryAfter;
 __block NSError *flushError;
 
 TLDaoErrorBlk(^newErrLoggerMaker)(void) = ^{
-  return (^(NSError *err, int code, NSString *msg) {
-    NSLog(@"Error code: [%d], error msg: [%@], error: [%@]", code, msg, err);
-  });
+  return [TLTestTxnMgrFactory newErrLogger];
 };
 
 NSString *(^contentsOfMockResponse)(NSString *) =
@@ -61,36 +63,29 @@ NSString *(^contentsOfMockResponse)(NSString *) =
                                       error:&err];
 };
 
+TLTransactionManager *(^newTxnMgrOpening)(BOOL, TLStoreReadyBlk) = ^(BOOL asynchronous, TLStoreReadyBlk readyBlk) {
+  NSBundle *testBundle = [NSBundle bundleForClass:[self class]];
+  NSURL *sqlLiteDataFileUrl =
+    [testBundle URLForResource:@"sqlite-datafile-for-testing"
+                 withExtension:@"data"];
+  if (asynchronous) {
+    return [TLTestTxnMgrFactory txnMgrWithDataFilePath:[sqlLiteDataFileUrl absoluteString]
+                                              readyBlk:readyBlk];
+  }
+  return [TLTestTxnMgrFactory txnMgrWithDataFilePath:[sqlLiteDataFileUrl absoluteString]];
+};
+
+TLTransactionManager *(^newTxnMgr)(void) = ^{
+  return newTxnMgrOpening(NO, nil);
+};
+
 describe(@"TLTransactionManager", ^{
   
     beforeAll(^{
         [[DDTTYLogger sharedInstance] setColorsEnabled:YES];
         [DDLog addLogger:[DDASLLogger sharedInstance]];
         [DDLog addLogger:[DDTTYLogger sharedInstance]];
-        NSBundle *testBundle = [NSBundle bundleForClass:[self class]];
-        NSURL *sqlLiteDataFileUrl =
-          [testBundle URLForResource:@"sqlite-datafile-for-testing"
-                       withExtension:@"data"];
-        HCRelationExecutor *relExecutor =
-          [[HCRelationExecutor alloc]
-            initWithDefaultAcceptCharset:[HCCharset UTF8]
-                   defaultAcceptLanguage:@"en-US"
-               defaultContentTypeCharset:[HCCharset UTF8]
-                allowInvalidCertificates:NO];
-        txnMgr = [[TLTransactionManager alloc]
-                   initWithDataFilePath:[sqlLiteDataFileUrl absoluteString]
-                    userAgentDeviceMake:@"iPhone5,2"
-                      userAgentDeviceOS:@"iPhone OS"
-               userAgentDeviceOSVersion:@"7.0.2"
-                       relationExecutor:relExecutor
-                             authScheme:@"token-scheme"
-                     authTokenParamName:@"auth-token"
-                     contentTypeCharset:[HCCharset UTF8]
-                     apptxnResMtVersion:@"0.0.1"
-               apptxnMediaSubtypePrefix:@"vnd.name.paulevans."
-                                  error:newErrLoggerMaker()];
-        [txnMgr setAuthToken:@"auth-token-val"];
-        [txnMgr setTxnStoreResourceUri:[NSURL URLWithString:@"http://example.com/txn-store"]];
+        txnMgr = newTxnMgr();
       });
 
     beforeEach(^{
@@ -168,12 +163,479 @@ describe(@"TLTransactionManager", ^{
             NSDate *expectedRetryAfter = [HCUtils rfc7231DateFromString:@"Fri, 04 Nov 2014 23:59:59 GMT"];
             flushExpectations(@"http-response.503", 0, NO, expectedRetryAfter, nil);
           });
+
+        it(@"Flushes and deletes the local store one batch at a time", ^{
+            [PEHttpResponseSimulator
+              simulateResponseFromXml:contentsOfMockResponse(@"http-response.201")
+                       requestLatency:0
+                      responseLatency:0];
+            for (NSInteger i = 0; i < 3; i++) {
+              TLTransaction *txn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+              [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+            }
+            TLToggler *flushedToggler =
+              [[TLToggler alloc] initWithNotificationName:TLTransactionSetFlushedSuccessfullyNotification];
+            [[NSNotificationCenter defaultCenter] addObserver:flushedToggler
+                                                     selector:@selector(toggleValue:)
+                                                         name:TLTransactionSetFlushedSuccessfullyNotification
+                                                       object:nil];
+            [txnMgr setMaxTransactionsPerFlushBatch:2];
+            [txnMgr synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {}];
+            [txnMgr setMaxTransactionsPerFlushBatch:500];
+            [[expectFutureValue(theValue([flushedToggler observedCount]))
+              shouldEventuallyBeforeTimingOutAfter(5)] equal:theValue(2)];
+            [[[txnMgr allTransactionsWithError:newErrLoggerMaker()] should] beEmpty];
+          });
+
+        it(@"Does not block logging while the flush request is in flight", ^{
+            [PEHttpResponseSimulator
+              simulateResponseFromXml:contentsOfMockResponse(@"http-response.201")
+                       requestLatency:2
+                      responseLatency:0];
+            TLTransaction *txn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+            [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+            TLToggler *flushedToggler =
+              [[TLToggler alloc] initWithNotificationName:TLTransactionSetFlushedSuccessfullyNotification];
+            [[NSNotificationCenter defaultCenter] addObserver:flushedToggler
+                                                     selector:@selector(toggleValue:)
+                                                         name:TLTransactionSetFlushedSuccessfullyNotification
+                                                       object:nil];
+            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+              [txnMgr synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {}];
+            });
+            [NSThread sleepForTimeInterval:0.5];
+            NSDate *beforeLog = [NSDate date];
+            [txn logWithUsecaseEvent:@(1) error:newErrLoggerMaker()];
+            [[theValue([[NSDate date] timeIntervalSinceDate:beforeLog]) should] beLessThan:theValue(0.5)];
+            [[expectFutureValue(theValue([flushedToggler observedCount]))
+              shouldEventuallyBeforeTimingOutAfter(5)] equal:theValue(1)];
+
+            // the log recorded mid-flush was not part of the flushed snapshot
+            NSArray *allTxns = [txnMgr allTransactionsWithError:newErrLoggerMaker()];
+            [[allTxns should] haveCountOf:1];
+            [[[allTxns[0] logs] should] haveCountOf:1];
+            [[[[allTxns[0] logs][0] usecaseEvent] should] equal:@(1)];
+          });
+      });
+
+    context(@"Crash-safe flush batches.", ^{
+        afterEach(^{
+            [txnMgr setFlushBatchStepBlk:nil];
+            [OHHTTPStubs onStubActivation:nil];
+          });
+
+        it(@"Re-sends an interrupted batch under the same idempotency key", ^{
+            [PEHttpResponseSimulator
+              simulateResponseFromXml:contentsOfMockResponse(@"http-response.201")
+                       requestLatency:0
+                      responseLatency:0];
+            NSMutableArray *postedKeys = [NSMutableArray array];
+            [OHHTTPStubs onStubActivation:^(NSURLRequest *request, id<OHHTTPStubsDescriptor> stub) {
+              @synchronized(postedKeys) {
+                [postedKeys addObject:[request valueForHTTPHeaderField:@"Idempotency-Key"]];
+              }
+            }];
+            // the step at which the app is "killed", and the number of POSTs
+            // (before and after the restart) it should then take to flush the
+            // batch
+            NSDictionary *numPostsByCrashStep = @{@(TLFlushBatchStepLeased) : @(1),
+                                                  @(TLFlushBatchStepSent) : @(1),
+                                                  @(TLFlushBatchStepPosted) : @(2),
+                                                  @(TLFlushBatchStepAcknowledged) : @(1)};
+            for (NSNumber *crashStep in numPostsByCrashStep) {
+              [txnMgr deleteAllTransactionsInTxnWithError:newErrLoggerMaker()];
+              @synchronized(postedKeys) {
+                [postedKeys removeAllObjects];
+              }
+              TLTransaction *txn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+              [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+              __block NSString *leasedKey = nil;
+              [txnMgr setFlushBatchStepBlk:^BOOL(TLFlushBatchStep step, NSString *idempotencyKey) {
+                leasedKey = idempotencyKey;
+                return step != [crashStep integerValue];
+              }];
+              [txnMgr synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {}];
+              [txnMgr setFlushBatchStepBlk:nil];
+              [leasedKey shouldNotBeNil];
+              [[[txnMgr allTransactionsWithError:newErrLoggerMaker()] should] haveCountOf:1];
+
+              // "restart" the app; its first flush picks up the batch
+              TLTransactionManager *restartedTxnMgr = newTxnMgr();
+              [restartedTxnMgr synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {}];
+              [[[restartedTxnMgr allTransactionsWithError:newErrLoggerMaker()] should] beEmpty];
+              @synchronized(postedKeys) {
+                [[postedKeys should] haveCountOf:[numPostsByCrashStep[crashStep] integerValue]];
+                for (NSString *postedKey in postedKeys) {
+                  [[postedKey should] equal:leasedKey];
+                }
+              }
+            }
+          });
+
+        it(@"Uploads the logs appended to a transaction while its batch is in flight", ^{
+            [PEHttpResponseSimulator
+              simulateResponseFromXml:contentsOfMockResponse(@"http-response.201")
+                       requestLatency:0
+                      responseLatency:0];
+            __block NSUInteger numLogsPosted = 0;
+            [OHHTTPStubs onStubActivation:^(NSURLRequest *request, id<OHHTTPStubsDescriptor> stub) {
+              NSString *body = [[NSString alloc] initWithData:[request HTTPBody] encoding:NSUTF8StringEncoding];
+              @synchronized(txnMgr) {
+                numLogsPosted += [[body componentsSeparatedByString:TLTxnLogUsecaseEventKey] count] - 1;
+              }
+            }];
+            [txnMgr setDatabaseProfile:TLDatabaseProfilePerformance];
+            [txnMgr setMaxTransactionsPerFlushBatch:1];
+            NSMutableArray *txns = [NSMutableArray array];
+            for (NSInteger i = 0; i < 4; i++) {
+              TLTransaction *txn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+              [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+              [txns addObject:txn];
+            }
+            // each batch's transaction logs again as soon as the batch is sent,
+            // while later batches are being read and leased
+            [txnMgr setFlushBatchStepBlk:^BOOL(TLFlushBatchStep step, NSString *idempotencyKey) {
+              if (step == TLFlushBatchStepSent) {
+                @synchronized(txns) {
+                  if ([txns count] > 0) {
+                    [txns[0] logWithUsecaseEvent:@(1) error:newErrLoggerMaker()];
+                    [txns removeObjectAtIndex:0];
+                  }
+                }
+              }
+              return YES;
+            }];
+            [txnMgr synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {}];
+            [txnMgr setFlushBatchStepBlk:nil];
+            [txnMgr synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {}];
+            [txnMgr setMaxTransactionsPerFlushBatch:500];
+            [txnMgr setDatabaseProfile:TLDatabaseProfileDefault];
+            [[[txnMgr allTransactionsWithError:newErrLoggerMaker()] should] beEmpty];
+            @synchronized(txnMgr) {
+              [[theValue(numLogsPosted) should] equal:theValue(8)];
+            }
+          });
+      });
+
+    context(@"Metrics.", ^{
+        it(@"Counts and times the logging and flush paths", ^{
+            [PEHttpResponseSimulator
+              simulateResponseFromXml:contentsOfMockResponse(@"http-response.201")
+                       requestLatency:0
+                      responseLatency:0];
+            TLMetricsSnapshot *before = [txnMgr metricsSnapshot];
+            TLTransaction *txn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+            [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+            [txn logWithUsecaseEvent:@(1) error:newErrLoggerMaker()];
+            TLMetricsSnapshot *logged = [txnMgr metricsSnapshot];
+            [[theValue([logged numEventsLogged] - [before numEventsLogged]) should] equal:theValue(2)];
+            [[theValue([[logged eventLoggingLatency] count] - [[before eventLoggingLatency] count]) should] equal:theValue(2)];
+            [[theValue([[logged transactionCreationLatency] count] - [[before transactionCreationLatency] count]) should] equal:theValue(1)];
+            [[theValue([logged numBacklogEvents]) should] equal:theValue(2)];
+            [[theValue([logged dataFileBytes]) should] beGreaterThan:theValue(0)];
+
+            [txnMgr synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {}];
+            TLMetricsSnapshot *flushed = [txnMgr metricsSnapshot];
+            [[theValue([flushed numEventsFlushed] - [logged numEventsFlushed]) should] equal:theValue(2)];
+            [[theValue([[flushed httpRoundTripLatency] count] - [[logged httpRoundTripLatency] count]) should] equal:theValue(1)];
+            [[theValue([[flushed httpRoundTripLatency] maxDuration]) should] beGreaterThan:theValue(0)];
+            [[theValue([flushed numBacklogEvents]) should] equal:theValue(0)];
+          });
+      });
+
+    context(@"Database profile.", ^{
+        it(@"Logs, fetches and flushes under the performance profile", ^{
+            [PEHttpResponseSimulator
+              simulateResponseFromXml:contentsOfMockResponse(@"http-response.201")
+                       requestLatency:0
+                      responseLatency:0];
+            [txnMgr setDatabaseProfile:TLDatabaseProfilePerformance];
+            [[theValue([txnMgr databaseSynchronousMode]) should] equal:theValue(TLDatabaseSynchronousModeNormal)];
+            TLTransaction *txn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+            [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+            // the read connection sees what was committed on the write connection
+            NSArray *txns = [txnMgr allTransactionsWithError:newErrLoggerMaker()];
+            [[txns should] haveCountOf:1];
+            [[[txns[0] logs] should] haveCountOf:1];
+            [txnMgr synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {}];
+            [[[txnMgr allTransactionsWithError:newErrLoggerMaker()] should] beEmpty];
+            [txnMgr setDatabaseProfile:TLDatabaseProfileDefault];
+            [[theValue([txnMgr databaseSynchronousMode]) should] equal:theValue(TLDatabaseSynchronousModeFull)];
+          });
+      });
+
+    context(@"Bulk logging.", ^{
+        it(@"Logs many events, of many transactions, in one call", ^{
+            NSDate *start = [NSDate dateWithTimeIntervalSince1970:1423203785];
+            TLTransaction *txn1 = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+            TLTransaction *txn2 = [txnMgr transactionWithUsecase:@(18) error:newErrLoggerMaker()];
+            NSMutableArray *txnLogs = [NSMutableArray array];
+            for (NSInteger i = 0; i < 3; i++) {
+              [txnLogs addObject:[[TLTransactionLog alloc] initWithUsecaseEvent:@(i)
+                                                               inContextErrCode:nil
+                                                        inContextErrDescription:nil
+                                                                      timestamp:[start dateByAddingTimeInterval:i]]];
+            }
+            [txnMgr logTransactionLogs:@[txnLogs, [txnLogs subarrayWithRange:NSMakeRange(0, 1)]]
+                       forTransactions:@[txn1, txn2]
+                                 error:newErrLoggerMaker()];
+            [txn2 spanWithBlock:^(TLTransactionSpan *span) {
+              [span logWithUsecaseEvent:@(1)];
+              [span logWithUsecaseEvent:@(2)];
+              [[theValue([span pendingCount]) should] equal:theValue(2)];
+            } error:newErrLoggerMaker()];
+            NSArray *allTxns = [txnMgr allTransactionsWithError:newErrLoggerMaker()];
+            [[allTxns should] haveCountOf:2];
+            [[[allTxns[0] logs] should] haveCountOf:3];
+            [[[[allTxns[0] logs][2] timestamp] should] equal:[start dateByAddingTimeInterval:2]];
+            [[[allTxns[1] logs] should] haveCountOf:3];
+          });
+      });
+
+    context(@"Enumeration and aggregates.", ^{
+        it(@"Filters, pages through and counts transactions in the database", ^{
+            for (NSNumber *usecase in @[@(17), @(17), @(18)]) {
+              TLTransaction *txn = [txnMgr transactionWithUsecase:usecase error:newErrLoggerMaker()];
+              [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+            }
+            TLTransaction *errTxn = [txnMgr transactionWithUsecase:@(18) error:newErrLoggerMaker()];
+            [errTxn logWithUsecaseEvent:@(1)
+                       inContextErrCode:@(-1009)
+                inContextErrDescription:@"The Internet connection appears to be offline."
+                                  error:newErrLoggerMaker()];
+            TLTransactionCursor *cursor = [txnMgr transactionCursorWithFilter:nil chunkSize:3 error:newErrLoggerMaker()];
+            [[[cursor nextChunk] should] haveCountOf:3];
+            [[[[cursor nextTransaction] localId] should] equal:[errTxn localId]];
+            [[cursor nextTransaction] shouldBeNil];
+
+            TLTransactionFilter *filter = [[TLTransactionFilter alloc] init];
+            [filter setUsecases:@[@(18)]];
+            [filter setErrorFilter:TLTransactionErrorFilterWithoutErrors];
+            __block NSUInteger numEnumerated = 0;
+            [txnMgr enumerateTransactionsWithFilter:filter
+                                              error:newErrLoggerMaker()
+                                         usingBlock:^(TLTransaction *txn, BOOL *stop) {
+                                           [[[txn usecase] should] equal:@(18)];
+                                           numEnumerated++;
+                                         }];
+            [[theValue(numEnumerated) should] equal:theValue(1)];
+            [filter setUsecases:nil];
+            [filter setErrorFilter:TLTransactionErrorFilterWithErrors];
+            [[theValue([txnMgr numTransactionsWithFilter:filter error:newErrLoggerMaker()]) should] equal:theValue(1)];
+            [filter setErrorFilter:TLTransactionErrorFilterAny];
+            [filter setFromDate:[NSDate dateWithTimeIntervalSinceNow:3600]];
+            [[theValue([txnMgr numTransactionsWithFilter:filter error:newErrLoggerMaker()]) should] equal:theValue(0)];
+            [[[txnMgr numTransactionsByUsecaseWithFilter:nil error:newErrLoggerMaker()] should]
+              equal:@{@(17) : @(2), @(18) : @(2)}];
+            [[[txnMgr oldestPendingLogTimestampWithError:newErrLoggerMaker()] should] beNonNil];
+          });
+      });
+
+    context(@"Storage quota.", ^{
+        it(@"Evicts the oldest transactions first, keeping those with errors", ^{
+            TLTransaction *errTxn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+            [errTxn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+            [errTxn logWithUsecaseEvent:@(1)
+                       inContextErrCode:@(-1009)
+                inContextErrDescription:@"The Internet connection appears to be offline."
+                                  error:newErrLoggerMaker()];
+            for (NSInteger i = 0; i < 2; i++) {
+              TLTransaction *txn = [txnMgr transactionWithUsecase:@(18) error:newErrLoggerMaker()];
+              [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+              [txn logWithUsecaseEvent:@(1) error:newErrLoggerMaker()];
+            }
+            NSUInteger evictedTxnsBefore = [txnMgr evictedTransactionCount];
+            NSUInteger evictedLogsBefore = [txnMgr evictedTransactionLogCount];
+            [txnMgr setMaxStoredTransactionLogs:4];
+            [txnMgr setEvictionBatchSize:1];
+            [txnMgr enforceStorageQuota];
+            // 6 logs exceeds the quota of 4; eviction continues down to 3.6
+            [[expectFutureValue(theValue([txnMgr evictedTransactionCount] - evictedTxnsBefore))
+              shouldEventuallyBeforeTimingOutAfter(5)] equal:theValue(2)];
+            [txnMgr setMaxStoredTransactionLogs:10000];
+            [txnMgr setEvictionBatchSize:100];
+            [[theValue([txnMgr evictedTransactionLogCount] - evictedLogsBefore) should] equal:theValue(4)];
+            NSArray *allTxns = [txnMgr allTransactionsWithError:newErrLoggerMaker()];
+            [[allTxns should] haveCountOf:1];
+            [[[allTxns[0] guid] should] equal:[errTxn guid]];
+          });
+      });
+
+    context(@"Logging policy.", ^{
+        afterEach(^{
+            [txnMgr setLoggingPolicy:nil];
+          });
+
+        it(@"Drops unsampled transactions unless they log an error", ^{
+            TLLoggingPolicy *policy = [[TLLoggingPolicy alloc] init];
+            [policy setSampleRate:0.0 forUsecase:@(30)];
+            [txnMgr setLoggingPolicy:policy];
+            TLTransaction *txn = [txnMgr transactionWithUsecase:@(30) error:newErrLoggerMaker()];
+            [[theValue([txn isRecorded]) should] beNo];
+            [[txn guid] shouldBeNil];
+            [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+            [[[txnMgr allTransactionsWithError:newErrLoggerMaker()] should] beEmpty];
+            [txn logWithUsecaseEvent:@(1)
+                    inContextErrCode:@(-1001)
+             inContextErrDescription:@"The request timed out."
+                               error:newErrLoggerMaker()];
+            NSArray *allTxns = [txnMgr allTransactionsWithError:newErrLoggerMaker()];
+            [[allTxns should] haveCountOf:1];
+            [[[allTxns[0] guid] should] startWithString:@"TXN30-"];
+            [[theValue([allTxns[0] sampleRate]) should] equal:theValue(1.0)];
+            [[[allTxns[0] logs] should] haveCountOf:1];
+          });
+
+        it(@"Rate-limits and records the sample rate", ^{
+            TLLoggingPolicy *policy = [[TLLoggingPolicy alloc] init];
+            [policy setSampleRate:0.5 forUsecase:@(31)];
+            [policy setRateLimitOfTransactions:2 perInterval:3600 forUsecase:@(31)];
+            [txnMgr setLoggingPolicy:policy];
+            NSUInteger numRecorded = 0;
+            for (NSInteger i = 0; i < 100; i++) {
+              TLTransaction *txn = [txnMgr transactionWithUsecase:@(31) error:newErrLoggerMaker()];
+              [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+              numRecorded += [txn isRecorded] ? 1 : 0;
+            }
+            [[theValue(numRecorded) should] equal:theValue(2)];
+            NSArray *allTxns = [txnMgr allTransactionsWithError:newErrLoggerMaker()];
+            [[allTxns should] haveCountOf:2];
+            [[theValue([allTxns[0] sampleRate]) should] equal:theValue(0.5)];
+          });
+
+        it(@"Scales the sample rate by the admission rate of a rate limit", ^{
+            TLLoggingPolicy *policy = [[TLLoggingPolicy alloc] init];
+            [policy setRateLimitOfTransactions:1 perInterval:0.05 forUsecase:@(31)];
+            [[theValue([policy admitTransactionWithUsecase:@(31)]) should] equal:theValue(1.0)];
+            for (NSInteger i = 0; i < 9; i++) {
+              [[theValue([policy admitTransactionWithUsecase:@(31)]) should] equal:theValue(0.0)];
+            }
+            [NSThread sleepForTimeInterval:0.06];
+            double sampleRate = [policy admitTransactionWithUsecase:@(31)];
+            [[theValue(sampleRate) should] beGreaterThan:theValue(0.0)];
+            [[theValue(sampleRate) should] beLessThan:theValue(1.0)];
+          });
+
+        it(@"Counts rolled-up transactions instead of recording them", ^{
+            TLLoggingPolicy *policy = [[TLLoggingPolicy alloc] init];
+            [policy setRollsUp:YES forUsecase:@(32)];
+            [txnMgr setLoggingPolicy:policy];
+            TLTransaction *txn = [txnMgr transactionWithUsecase:@(32) error:newErrLoggerMaker()];
+            [[theValue([txn isRecorded]) should] beNo];
+            [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+            [txn logWithUsecaseEvent:@(1)
+                    inContextErrCode:@(-1001)
+             inContextErrDescription:@"The request timed out."
+                               error:newErrLoggerMaker()];
+            [[[txnMgr allTransactionsWithError:newErrLoggerMaker()] should] beEmpty];
+            NSArray *rollups = [[txnMgr rollupAggregator] drainRollups];
+            [[rollups should] haveCountOf:1];
+            TLTransactionRollup *rollup = rollups[0];
+            [[[rollup usecase] should] equal:@(32)];
+            [[theValue([rollup numTransactions]) should] equal:theValue(1)];
+            [[theValue([rollup numEvents]) should] equal:theValue(2)];
+            [[[rollup eventCounts] should] equal:@{@(0) : @(1), @(1) : @(1)}];
+            [[[rollup errCodeCounts] should] equal:@{@(-1001) : @(1)}];
+            [[[[rollup durationHistogram] allValues] should] equal:@[@(1)]];
+          });
+
+        it(@"Stores its rollups when the app enters the background", ^{
+            [PEHttpResponseSimulator
+              simulateResponseFromXml:contentsOfMockResponse(@"http-response.201")
+                       requestLatency:0
+                      responseLatency:0];
+            __block NSUInteger numPosts = 0;
+            [OHHTTPStubs onStubActivation:^(NSURLRequest *request, id<OHHTTPStubsDescriptor> stub) {
+              @synchronized(txnMgr) {
+                numPosts++;
+              }
+            }];
+            TLLoggingPolicy *policy = [[TLLoggingPolicy alloc] init];
+            [policy setRollsUp:YES forUsecase:@(32)];
+            [txnMgr setLoggingPolicy:policy];
+            [[txnMgr rollupAggregator] setWindowDuration:1];
+            TLTransaction *txn = [txnMgr transactionWithUsecase:@(32) error:newErrLoggerMaker()];
+            [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+            [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationDidEnterBackgroundNotification
+                                                                object:nil];
+            [[txnMgr rollupAggregator] setWindowDuration:300];
+            [[[[txnMgr rollupAggregator] drainRollups] should] beEmpty];
+
+            // the app is then killed; once its window has closed, the rollup
+            // is sent by the restarted app's first flush
+            [NSThread sleepForTimeInterval:1.1];
+            TLTransactionManager *restartedTxnMgr = newTxnMgr();
+            [restartedTxnMgr synchronousFlushTxnsToRemoteStoreWithRemoteStoreBusyBlock:^(NSDate *retryAfter, NSHTTPURLResponse *resp) {}];
+            [OHHTTPStubs onStubActivation:nil];
+            @synchronized(txnMgr) {
+              [[theValue(numPosts) should] equal:theValue(1)];
+            }
+          });
+      });
+
+    context(@"Asynchronous initialization.", ^{
+        it(@"Holds transactions created before the store is ready, then commits them", ^{
+            __block BOOL readyBlkInvoked = NO;
+            TLTransactionManager *asyncTxnMgr = newTxnMgrOpening(YES, ^{
+                readyBlkInvoked = YES;
+              });
+            TLTransaction *txn = [asyncTxnMgr transactionWithUsecase:@(33) error:newErrLoggerMaker()];
+            [txn logWithUsecaseEvent:@(0) error:newErrLoggerMaker()];
+            [asyncTxnMgr waitUntilReady];
+            [[theValue([asyncTxnMgr isReady]) should] beYes];
+            [[expectFutureValue(theValue(readyBlkInvoked)) shouldEventually] beYes];
+            [[theValue([[asyncTxnMgr writeBehindBuffer] isEnabled]) should] beNo];
+            NSArray *allTxns = [asyncTxnMgr allTransactionsWithError:newErrLoggerMaker()];
+            [[allTxns should] haveCountOf:1];
+            [[[allTxns[0] guid] should] equal:[txn guid]];
+            [[[allTxns[0] logs] should] haveCountOf:1];
+          });
+
+        it(@"Stores the logs made while the store opens in the order they were made", ^{
+            // (the write-behind buffer is disabled, so once the hold is
+            // released, logs are written straight to the store)
+            TLTransactionManager *asyncTxnMgr = newTxnMgrOpening(YES, nil);
+            TLTransaction *txn = [asyncTxnMgr transactionWithUsecase:@(33) error:newErrLoggerMaker()];
+            NSInteger numLogs = 0;
+            NSInteger numLogsOnceReady = 0;
+            while (numLogsOnceReady < 20) {
+              if ([asyncTxnMgr isReady]) {
+                numLogsOnceReady++;
+              }
+              [txn logWithUsecaseEvent:@(numLogs++) error:newErrLoggerMaker()];
+            }
+            NSArray *txnLogs = [[asyncTxnMgr allTransactionsWithError:newErrLoggerMaker()][0] logs];
+            [[txnLogs should] haveCountOf:numLogs];
+            for (NSInteger i = 0; i < numLogs; i++) {
+              [[[txnLogs[i] usecaseEvent] should] equal:@(i)];
+            }
+          });
+      });
+
+    context(@"Transaction GUIDs.", ^{
+        it(@"Are stored as 16 bytes, and rendered as TXN<use case>-<UUID>", ^{
+          NSString *guid = @"TXN17-586AB00B-F16E-4AE6-8A91-0210264925C7";
+          NSData *guidBytes = [TLTransaction guidBytesOfGuid:guid];
+          [[theValue([guidBytes length]) should] equal:theValue(16)];
+          [[[TLTransaction guidForUsecase:@(17) guidBytes:guidBytes] should] equal:guid];
+          [[TLTransaction guidBytesOfGuid:@"TXN17-benchmark"] shouldBeNil];
+          TLTransaction *txn = [[TLTransaction alloc] initWithUsecase:@(17)
+                                                              localId:nil
+                                                                 guid:nil
+                                                  userAgentDeviceMake:nil
+                                                    userAgentDeviceOS:nil
+                                             userAgentDeviceOSVersion:nil
+                                                        databaseQueue:nil];
+          [txn setGuidBytes:guidBytes];
+          [[[txn guid] should] equal:guid];
+        });
       });
 
     context(@"Happy path creating a transaction with some logs.", ^{
         it(@"Is working as expected", ^{
           [txnMgr shouldNotBeNil];
           TLTransaction *txn = [txnMgr transactionWithUsecase:@(17) error:newErrLoggerMaker()];
+          NSString *createdGuid = [txn guid];
           NSNumber *evtZero = [NSNumber numberWithInt:0];
           NSNumber *evtOne = [NSNumber numberWithInt:1];
           [txn logWithUsecaseEvent:@([evtZero integerValue]) error:newErrLoggerMaker()];
@@ -185,6 +647,8 @@ describe(@"TLTransactionManager", ^{
           [[[txn usecase] should] equal:[NSNumber numberWithInt:17]];
           [[txn guid] shouldNotBeNil];
           [[[txn guid] should] startWithString:@"TXN17-"];
+          [[[txn guid] should] equal:createdGuid];
+          [[theValue([[txn guidBytes] length]) should] equal:theValue(16)];
           [[[txn userAgentDeviceMake] should] equal:@"iPhone5,2"];
           [[[txn userAgentDeviceOS] should] equal:@"iPhone OS"];
           [[[txn userAgentDeviceOSVersion] should] equal:@"7.0.2"];
@@ -245,6 +709,9 @@ describe(@"TLTransactionManager", ^{
           [[allTxns should] haveCountOf:2];
           [[[allTxns[0] logs] should] haveCountOf:3];
           [[[allTxns[1] logs] should] haveCountOf:4];
+          // both transactions reference the one stored user agent
+          [[allTxns[0] userAgentLocalId] shouldNotBeNil];
+          [[[allTxns[0] userAgentLocalId] should] equal:[allTxns[1] userAgentLocalId]];
           
           // another go at deleting a subset
           [txnMgr deleteTransactionsInTxn:@[allTxns[1]] error:newErrLoggerMaker()];
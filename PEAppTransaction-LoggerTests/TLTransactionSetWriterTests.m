@@ -0,0 +1,172 @@
+//
+//  TLTransactionSetWriterTests.m
+//
+// Copyright (c) 2014-2015 PEAppTransaction-Logger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "TLTransactionSetWriter.h"
+#import "TLTransactionSetMsgPackWriter.h"
+#import "TLTransactionSetSerializer.h"
+#import "TLKnownMediaTypes.h"
+#import <PEHateoas-Client/HCCharset.h>
+#import <Kiwi/Kiwi.h>
+
+SPEC_BEGIN(TLTransactionSetWriterSpec)
+
+describe(@"TLTransactionSetWriter", ^{
+
+    __block TLTransactionSetSerializer *serializer;
+    __block NSArray *txns;
+
+    beforeAll(^{
+        serializer =
+          [[TLTransactionSetSerializer alloc] initWithMediaType:[TLKnownMediaTypes txnSetMediaTypeWithVersion:@"0.0.1"
+                                                                                            mediaSubTypePrefix:@"vnd.name.paulevans."]
+                                                        charset:[HCCharset UTF8]
+                                serializersForEmbeddedResources:@{}
+                                    actionsForEmbeddedResources:@{}];
+        TLTransaction *txn1 = [[TLTransaction alloc] initWithUsecase:@(17)
+                                                             localId:@(1)
+                                                                guid:@"TXN17-586AB00B-F16E-4AE6-8A91-0210264925C7"
+                                                 userAgentDeviceMake:@"iPhone7,2"
+                                                   userAgentDeviceOS:@"iPhone OS"
+                                            userAgentDeviceOSVersion:@"8.1.2"
+                                                       databaseQueue:nil];
+        TLTransactionLog *log1 = [[TLTransactionLog alloc] initWithUsecaseEvent:@(0)
+                                                               inContextErrCode:(id)[NSNull null]
+                                                        inContextErrDescription:nil];
+        TLTransactionLog *log2 = [[TLTransactionLog alloc] initWithUsecaseEvent:@(1)
+                                                               inContextErrCode:@(-1009)
+                                                        inContextErrDescription:@"The \"Internet\" connection\nappears to be offline / é"];
+        [log2 setTimestamp:[NSDate dateWithTimeIntervalSinceNow:3]];
+        [txn1 setLogs:@[log1, log2]];
+        TLTransaction *txn2 = [[TLTransaction alloc] initWithUsecase:@(18)
+                                                             localId:@(2)
+                                                                guid:@"TXN18-0D7C3DE6-3C41-4C09-9C5A-0F8A5E7E1F10"
+                                                 userAgentDeviceMake:@"iPhone7,2"
+                                                   userAgentDeviceOS:@"iPhone OS"
+                                            userAgentDeviceOSVersion:@"8.1.2"
+                                                       databaseQueue:nil];
+        [txn2 setLogs:@[]];
+        txns = @[txn1, txn2];
+      });
+
+    it(@"Encodes a transaction set semantically equivalent to the dictionary-based serializer's", ^{
+        TLTransactionSetWriter *writer = [[TLTransactionSetWriter alloc] init];
+        for (TLTransaction *txn in txns) {
+          [writer writeTransaction:txn];
+        }
+        NSData *encoded = [writer finish];
+        [[theValue([encoded length]) should] equal:theValue([writer length])];
+        NSDictionary *decoded = [NSJSONSerialization JSONObjectWithData:encoded options:0 error:nil];
+        [[decoded should] equal:[serializer dictionaryWithResourceModel:txns]];
+        [[[serializer dictionaryWithResourceModel:encoded] should] equal:decoded];
+      });
+
+    it(@"Encodes a transaction with the expected member names and escaping", ^{
+        TLTransactionSetWriter *writer = [[TLTransactionSetWriter alloc] init];
+        [writer writeTransaction:txns[1]];
+        NSString *encoded = [[NSString alloc] initWithData:[writer finish] encoding:NSUTF8StringEncoding];
+        [[encoded should] equal:@"{\"apptxns\":[{\"apptxn\\/id\":\"TXN18-0D7C3DE6-3C41-4C09-9C5A-0F8A5E7E1F10\",\
+\"apptxn\\/usecase\":18,\
+\"apptxn\\/user-agent-device-make\":\"iPhone7,2\",\
+\"apptxn\\/user-agent-device-os\":\"iPhone OS\",\
+\"apptxn\\/user-agent-device-os-version\":\"8.1.2\",\
+\"apptxn\\/logs\":[]}]}"];
+      });
+
+    it(@"Can discard the last transaction written", ^{
+        TLTransactionSetWriter *writer = [[TLTransactionSetWriter alloc] init];
+        [writer writeTransaction:txns[0]];
+        [writer writeTransaction:txns[1]];
+        [writer discardLastTransaction];
+        NSDictionary *decoded = [NSJSONSerialization JSONObjectWithData:[writer finish] options:0 error:nil];
+        [[decoded should] equal:[serializer dictionaryWithResourceModel:@[txns[0]]]];
+      });
+
+    it(@"Encodes rollups after the transactions", ^{
+        TLTransactionRollup *rollup =
+          [[TLTransactionRollup alloc] initWithUsecase:@(19)
+                                           windowStart:[NSDate dateWithTimeIntervalSince1970:1420070400]
+                                        windowDuration:300];
+        [rollup addTransaction];
+        [rollup addEventWithUsecaseEvent:@(0) inContextErrCode:nil sincePreviousEvent:-1];
+        [rollup addEventWithUsecaseEvent:@(1) inContextErrCode:@(-1009) sincePreviousEvent:0.1];
+        TLTransactionSetWriter *writer = [[TLTransactionSetWriter alloc] init];
+        [writer writeTransaction:txns[1]];
+        [writer writeRollups:@[rollup]];
+        NSData *encoded = [writer finish];
+        [[theValue([encoded length]) should] equal:theValue([writer length])];
+        NSDictionary *decoded = [NSJSONSerialization JSONObjectWithData:encoded options:0 error:nil];
+        [[decoded[TLTxnsKey] should] haveCountOf:1];
+        [[decoded[TLTxnRollupsKey] should] equal:@[@{TLTxnRollupUsecaseKey : @(19),
+                                                      TLTxnRollupWindowStartKey : @"Thu, 01 Jan 2015 00:00:00 GMT",
+                                                      TLTxnRollupWindowDurationKey : @(300),
+                                                      TLTxnRollupNumTxnsKey : @(1),
+                                                      TLTxnRollupNumEventsKey : @(2),
+                                                      TLTxnRollupEventCountsKey : @[@[@(0), @(1)], @[@(1), @(1)]],
+                                                      TLTxnRollupErrCodeCountsKey : @[@[@(-1009), @(1)]],
+                                                      TLTxnRollupDurationHistogramKey : @[@[@(128), @(1)]]}]];
+        TLTransactionSetMsgPackWriter *msgPackWriter = [[TLTransactionSetMsgPackWriter alloc] init];
+        [msgPackWriter writeRollups:@[rollup]];
+        NSData *packed = [msgPackWriter finish];
+        [[theValue([packed length]) should] equal:theValue([msgPackWriter length])];
+        [[theValue(((const uint8_t *)[packed bytes])[0]) should] equal:theValue(0x93)]; // [userAgents, txns, rollups]
+      });
+
+    it(@"Encodes a much smaller MessagePack transaction set", ^{
+        TLTransactionSetMsgPackWriter *msgPackWriter = [[TLTransactionSetMsgPackWriter alloc] init];
+        TLTransactionSetWriter *jsonWriter = [[TLTransactionSetWriter alloc] init];
+        for (TLTransaction *txn in txns) {
+          [msgPackWriter writeTransaction:txn];
+          [jsonWriter writeTransaction:txn];
+        }
+        NSData *encoded = [msgPackWriter finish];
+        [[theValue([encoded length]) should] equal:theValue([msgPackWriter length])];
+        [[theValue([encoded length] * 2) should] beLessThan:theValue([[jsonWriter finish] length])];
+        const uint8_t *bytes = [encoded bytes];
+        [[theValue(bytes[0]) should] equal:theValue(0x92)]; // [userAgents, txns]
+        [[theValue(bytes[1]) should] equal:theValue(0x91)]; // 1 (shared) user agent
+        [[theValue(bytes[2]) should] equal:theValue(0x93)]; // make, os, os-version
+        [[theValue(bytes[3]) should] equal:theValue(0xa9)]; // "iPhone7,2"
+        NSUInteger txnsOffset = 3 + (1 + 9) + (1 + 9) + (1 + 5);
+        [[theValue(bytes[txnsOffset]) should] equal:theValue(0x92)]; // 2 txns
+      });
+
+    it(@"Drops a user agent introduced by a discarded MessagePack transaction", ^{
+        TLTransactionSetMsgPackWriter *msgPackWriter = [[TLTransactionSetMsgPackWriter alloc] init];
+        [msgPackWriter writeTransaction:txns[0]];
+        NSUInteger length = [msgPackWriter length];
+        TLTransaction *otherDeviceTxn = [[TLTransaction alloc] initWithUsecase:@(18)
+                                                                       localId:@(3)
+                                                                          guid:@"TXN18-3F2504E0-4F89-11D3-9A0C-0305E82C3301"
+                                                           userAgentDeviceMake:@"iPad4,1"
+                                                             userAgentDeviceOS:@"iPhone OS"
+                                                      userAgentDeviceOSVersion:@"8.1.2"
+                                                                 databaseQueue:nil];
+        [msgPackWriter writeTransaction:otherDeviceTxn];
+        [msgPackWriter discardLastTransaction];
+        [[theValue([msgPackWriter length]) should] equal:theValue(length)];
+        [[theValue([[msgPackWriter finish] length]) should] equal:theValue(length)];
+      });
+  });
+
+SPEC_END
@@ -0,0 +1,16 @@
+#!/bin/bash
+
+# Runs the test target and gathers the results reported by the benchmark specs
+# (one "TL-BENCHMARK-RESULT <json>" log line each) into a JSON array.
+#
+# Usage: ./run-benchmarks-xcodebuild.sh [results-file]
+#   (default results file: benchmark-results.json)
+
+readonly RESULTS_FILE="${1:-benchmark-results.json}"
+
+./run-tests-xcodebuild.sh 2>&1 \
+  | tee /dev/stderr \
+  | sed -n 's/.*TL-BENCHMARK-RESULT //p' \
+  | awk 'BEGIN { print "[" } NR > 1 { print "," } { print } END { print "]" }' \
+  > "${RESULTS_FILE}"
+test ${PIPESTATUS[0]} -eq 0